@@ -262,6 +262,21 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to point to the given SyncedMemory, which
+   *        must be large enough for the current shape -- used by Net to place
+   *        several activations with disjoint lifetimes in one buffer.
+   *
+   * Capacity is reset to the current count, so that a later Reshape to a
+   * larger shape moves this Blob back to memory of its own.
+   */
+  void ShareDataMemory(const shared_ptr<SyncedMemory>& data);
+  /**
+   * @brief Drop the data of this Blob, keeping its shape. The memory is freed
+   *        once no other Blob shares it; the data reads as zeros until it is
+   *        written again.
+   */
+  void ReleaseData();
 
   bool ShapeEquals(const BlobProto& other);
 
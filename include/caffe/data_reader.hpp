@@ -1,6 +1,8 @@
 #ifndef CAFFE_DATA_READER_HPP_
 #define CAFFE_DATA_READER_HPP_
 
+#include <stdint.h>
+
 #include <map>
 #include <string>
 #include <vector>
@@ -9,6 +11,7 @@
 #include "caffe/internal_thread.hpp"
 #include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
+#include "caffe/util/mapped_datum.hpp"
 
 namespace caffe {
 
@@ -19,16 +22,29 @@ namespace caffe {
  * databases are read sequentially, and that each solver accesses a different
  * subset of the database. Data is distributed to solvers in a round-robin
  * way to keep parallel training deterministic.
+ *
+ * When the database cursor keeps its values mapped (LMDB), the data bytes of
+ * the datums refer to the map instead of being copied, which is valid as
+ * long as the reader lives.
+ *
+ * With DataParameter.reader_threads > 1, the keys are split into as many
+ * contiguous ranges, each read by its own thread and cursor, and the items
+ * are taken from the readers in turn. With a key_index, the keys are instead
+ * read in a random permutation drawn every epoch, the readers taking turns
+ * through it; and with a shuffle_buffer, each reader outputs its datums in
+ * a random order. Each reader logs its throughput and
+ * how much of its time it spent in the database versus waiting for the data
+ * layers, which tells whether reading or transforming is the bottleneck.
  */
 class DataReader {
  public:
   explicit DataReader(const LayerParameter& param);
   ~DataReader();
 
-  inline BlockingQueue<Datum*>& free() const {
+  inline BlockingQueue<MappedDatum*>& free() const {
     return queue_pair_->free_;
   }
-  inline BlockingQueue<Datum*>& full() const {
+  inline BlockingQueue<MappedDatum*>& full() const {
     return queue_pair_->full_;
   }
 
@@ -39,12 +55,53 @@ class DataReader {
     explicit QueuePair(int size);
     ~QueuePair();
 
-    BlockingQueue<Datum*> free_;
-    BlockingQueue<Datum*> full_;
+    BlockingQueue<MappedDatum*> free_;
+    BlockingQueue<MappedDatum*> full_;
 
   DISABLE_COPY_AND_ASSIGN(QueuePair);
   };
 
+  // Reads the keys from begin up to end, or the end of the database if end
+  // is empty, over and over. If keys is given, reads instead the items id,
+  // id + num_readers, ... of the sequence of the epochs' permutations of
+  // keys, each drawn from keys_seed and the epoch.
+  class Reader : public InternalThread {
+   public:
+    Reader(int id, int num_readers, const DataParameter& param,
+        shared_ptr<db::Cursor> cursor, const string& begin, const string& end,
+        shared_ptr<const vector<string> > keys, unsigned int keys_seed);
+    virtual ~Reader();
+
+    // Read datums are swapped out of full_ and then pushed back to free_.
+    BlockingQueue<MappedDatum*> free_;
+    BlockingQueue<MappedDatum*> full_;
+
+   protected:
+    void InternalThreadEntry();
+    // Move the cursor to the first item to read, or the next one.
+    void Rewind();
+    void Next();
+    // Draw the permutation of the keys for the epoch of index_.
+    void Permute();
+    void SeekKey();
+
+    const int id_;
+    const int num_readers_;
+    const int shuffle_buffer_;
+    shared_ptr<db::Cursor> cursor_;
+    const string begin_;
+    const string end_;
+    shared_ptr<const vector<string> > keys_;
+    const unsigned int keys_seed_;
+    vector<int> permutation_;
+    // The position in the sequence of permutations, and the epoch of
+    // permutation_.
+    int64_t index_;
+    int64_t epoch_;
+
+  DISABLE_COPY_AND_ASSIGN(Reader);
+  };
+
   // A single body is created per source
   class Body : public InternalThread {
    public:
@@ -53,10 +110,14 @@ class DataReader {
 
    protected:
     void InternalThreadEntry();
-    void read_one(db::Cursor* cursor, QueuePair* qp);
+    void read_one(QueuePair* qp);
 
     const LayerParameter param_;
     BlockingQueue<shared_ptr<QueuePair> > new_queue_pairs_;
+    // Owned by the body thread; the readers are destroyed before the DB.
+    shared_ptr<db::DB> db_;
+    vector<shared_ptr<Reader> > readers_;
+    int next_reader_;
 
     friend class DataReader;
 
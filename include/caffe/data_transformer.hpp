@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/mapped_datum.hpp"
 
 namespace caffe {
 
@@ -37,6 +38,16 @@ class DataTransformer {
    */
   void Transform(const Datum& datum, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Applies the transformation to a MappedDatum, reading its data
+   * bytes where they are.
+   * @param datum
+   *    MappedDatum containing the data to be transformed.
+   * @param transformed_blob
+   *    This is destination blob, as for a Datum.
+   */
+  void Transform(const MappedDatum& datum, Blob<Dtype>* transformed_blob);
+
   /**
    * @brief Applies the transformation defined in the data layer's
    * transform_param block to a vector of Datum.
@@ -98,6 +109,13 @@ class DataTransformer {
    *    Datum containing the data to be transformed.
    */
   vector<int> InferBlobShape(const Datum& datum);
+  /**
+   * @brief Infers the shape of transformed_blob will have when
+   *    the transformation is applied to the data.
+   * @param datum
+   *    MappedDatum containing the data to be transformed.
+   */
+  vector<int> InferBlobShape(const MappedDatum& datum);
   /**
    * @brief Infers the shape of transformed_blob will have when
    *    the transformation is applied to the data.
@@ -139,6 +157,11 @@ class DataTransformer {
   virtual int Rand(int n);
 
   void Transform(const Datum& datum, Dtype* transformed_data);
+  // Transform a Datum that is not encoded, whose data bytes are given apart.
+  void Transform(const Datum& datum, const char* data, size_t data_size,
+      Blob<Dtype>* transformed_blob);
+  void Transform(const Datum& datum, const char* data, size_t data_size,
+      Dtype* transformed_data);
   // Tranformation parameters
   TransformationParameter param_;
 
@@ -282,6 +282,25 @@ class Layer {
    */
   virtual inline bool AutoTopBlobs() const { return false; }
 
+  /**
+   * @brief Return whether the top blobs share data with bottom[0] rather
+   *        than owning memory of their own.
+   *
+   * Layers that call Blob::ShareData from Forward, like Split and Flatten,
+   * report it here so that Net can plan memory before the first Forward.
+   */
+  virtual inline bool TopsShareBottomData() const { return false; }
+
+  /**
+   * @brief Return whether Forward can be run again before Backward, giving
+   *        the same tops and leaving the layer's state unchanged.
+   *
+   * Net only recomputes activations (NetParameter.checkpoint_param) through
+   * such layers. Layers that draw random numbers or update running state in
+   * Forward return false.
+   */
+  virtual inline bool AllowRecompute() const { return true; }
+
   /**
    * @brief Return whether to allow force_backward for a given bottom blob
    *        index.
@@ -316,6 +335,19 @@ class Layer {
     param_propagate_down_[param_id] = value;
   }
 
+  /**
+   * @brief Returns the rows (indices along the first axis) of the diff of
+   *        the parameter param_id that Backward_cpu accumulated into since
+   *        the last ClearParamDiffRows, or NULL if it may write any of them.
+   *
+   * When a layer tracks them, Net and the solvers clear, update and apply
+   *  only these rows of the parameter in CPU mode.
+   */
+  virtual inline const vector<int>* param_diff_rows(int param_id) const {
+    return NULL;
+  }
+  /// @brief Forgets the tracked rows, once Net has cleared their diff.
+  virtual void ClearParamDiffRows() {}
 
  protected:
   /** The protobuf that stores the layer parameters */
@@ -0,0 +1,73 @@
+#ifndef CAFFE_AUTOTUNED_CONV_LAYER_HPP_
+#define CAFFE_AUTOTUNED_CONV_LAYER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer that times the CPU engines that apply to its
+ *        shapes and runs the fastest one (engine: AUTOTUNE).
+ *
+ * On the first Reshape for a given input shape, which Net::Init triggers,
+ * each candidate engine (CAFFE, THREADED, DIRECT, WINOGRAD and FFT, where
+ * they apply) runs the forward pass, and in the TRAIN phase the backward
+ * pass, on scratch data with its own copy of the weights, and the fastest
+ * one is kept. It then shares this layer's parameters. The choice is
+ * recorded in the TuningCache, keyed by the shapes and thread count, so that
+ * layers of the same shape, and later processes if the cache has a file,
+ * skip the search. GPU mode uses the ConvolutionLayer implementation.
+ */
+template <typename Dtype>
+class AutotunedConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit AutotunedConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param),
+        selected_engine_(ConvolutionParameter_Engine_CAFFE),
+        tuned_threads_(0) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void set_fused_relu(bool fused_relu, Dtype negative_slope);
+
+  /// @brief The engine run for the current shapes.
+  ConvolutionParameter_Engine selected_engine() const {
+    return selected_engine_;
+  }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief The TuningCache key for the current shapes.
+  string TuningKey(const vector<int>& bottom_shape) const;
+  /// @brief The engines worth timing for the current shapes.
+  vector<ConvolutionParameter_Engine> Candidates() const;
+  /// @brief Time the candidates on a bottom of the given shape and return
+  ///        the fastest.
+  ConvolutionParameter_Engine Tune(const vector<int>& bottom_shape);
+  /// @brief A convolution layer of this layer's parameters but engine.
+  shared_ptr<Layer<Dtype> > CreateEngineLayer(
+      ConvolutionParameter_Engine engine) const;
+
+  ConvolutionParameter_Engine selected_engine_;
+  /// The layer run on CPU; NULL when CAFFE is selected.
+  shared_ptr<Layer<Dtype> > selected_;
+  /// The key selected_engine_ was picked for, and the bottom shape and
+  /// global thread count it was built from.
+  string tuned_key_;
+  vector<int> tuned_shape_;
+  int tuned_threads_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_AUTOTUNED_CONV_LAYER_HPP_
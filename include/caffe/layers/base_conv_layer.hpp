@@ -18,12 +18,22 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), fused_relu_(false), relu_negative_slope_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  /**
+   * @brief Apply a ReLU with the given negative slope to the output of the
+   *        CPU forward pass as it is written, together with the bias, which
+   *        the layer must have. For inference only: Backward ignores it.
+   */
+  virtual void set_fused_relu(bool fused_relu, Dtype negative_slope) {
+    fused_relu_ = fused_relu;
+    relu_negative_slope_ = negative_slope;
+  }
+
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
@@ -34,12 +44,28 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   // we just called weight_cpu_gemm with the same input.
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
+  // Also applies the fused ReLU, if any.
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // Variants of the above that take the column buffer to use, so that several
+  // images can be processed at once. col_buff must hold col_buffer_count()
+  // elements and is left unused by 1x1 convolutions.
+  void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
+      Dtype* output, Dtype* col_buff, bool skip_im2col);
+  void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
+      Dtype* output, Dtype* col_buff);
+  void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
+      weights, Dtype* col_buff);
+  inline int col_buffer_count() const { return col_buffer_.count(); }
+  /// @brief An output value after the fused ReLU, for engines that add the
+  ///        bias themselves.
+  inline Dtype fused_relu(Dtype x) const {
+    return fused_relu_ && x < 0 ? x * relu_negative_slope_ : x;
+  }
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -92,6 +118,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  bool fused_relu_;
+  Dtype relu_negative_slope_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -67,16 +67,49 @@ class BasePrefetchingDataLayer :
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
-  // Prefetches batches (asynchronously if to GPU memory)
-  static const int PREFETCH_COUNT = 3;
+  /// @brief The number of batches loaded ahead (asynchronously if to GPU
+  ///        memory), set by DataParameter.prefetch and max_prefetch for
+  ///        layers with a data_param and PREFETCH_COUNT otherwise.
+  inline int prefetch_count() const { return prefetch_.size() - held_count_; }
+  /// @brief The time Forward spent waiting for a batch to be loaded, in ms.
+  inline double prefetch_wait_time() const { return prefetch_wait_time_; }
+  /// @brief The number of Forward calls that had to wait for a batch.
+  inline int prefetch_waits() const { return prefetch_waits_; }
 
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
 
-  Batch<Dtype> prefetch_[PREFETCH_COUNT];
+  // Take the next loaded batch, timing the wait for it.
+  Batch<Dtype>* NextBatch();
+  // Give a consumed batch back to be loaded again, adding a batch if the
+  // consumer had to wait, or dropping it if memory runs low, when adaptive.
+  void RecycleBatch(Batch<Dtype>* batch);
+  // Add a batch of the shape of like to be loaded.
+  void AddBatch(const Batch<Dtype>& like);
+  // The memory available to the system, in bytes.
+  virtual size_t available_memory() const;
+
+  // The batches loaded ahead by layers without a data_param.
+  static const int PREFETCH_COUNT = 3;
+  // The number of recycled batches the reading of available_memory() holds
+  // for, when adaptive.
+  static const int MEMORY_CHECK_INTERVAL = 16;
+
+  vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  // In CPU mode the tops share the memory of the batch last output instead
+  // of copying it, and the batch is held back from loading until the next
+  // Forward. One batch more is allocated for it, so that as many are loaded
+  // ahead.
+  Batch<Dtype>* held_;
+  int held_count_;
+  bool waited_;
+  size_t available_memory_;
+  int batches_since_memory_check_;
+  double prefetch_wait_time_;
+  int prefetch_waits_;
 
   Blob<Dtype> transformed_data_;
 };
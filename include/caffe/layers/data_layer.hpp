@@ -11,6 +11,7 @@
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -30,8 +31,16 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
 
  protected:
   virtual void load_batch(Batch<Dtype>* batch);
+  // Transform the items stream, stream + num_streams, ... of the batch into
+  // top_data and top_label.
+  void TransformStream(const Batch<Dtype>& batch,
+      const vector<MappedDatum*>& datums, Dtype* top_data, Dtype* top_label,
+      int stream);
 
   DataReader reader_;
+  // One transformer per transform thread, the first being data_transformer_.
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  shared_ptr<ThreadPool> transform_pool_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,59 @@
+#ifndef CAFFE_DIRECT_CONV_LAYER_HPP_
+#define CAFFE_DIRECT_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/blob_change_tracker.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer computing the forward pass on CPU by direct
+ *        convolution instead of im2col + GEMM (engine: DIRECT).
+ *
+ * The filters are repacked so that kBlock output channels are contiguous, and
+ * one output row of kBlock channels is accumulated at a time, each input
+ * value being multiplied by a kBlock-wide vector of weights. The inner loop
+ * vectorizes and the accumulators stay in cache, while no kernel_h * kernel_w
+ * times larger column buffer is ever built; this helps most for the 3x3,
+ * stride 1 layers where im2col traffic dominates.
+ *
+ * Only 2D, non-dilated convolution runs directly; other shapes, the backward
+ * pass and GPU mode use the ConvolutionLayer implementation.
+ */
+template <typename Dtype>
+class DirectConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit DirectConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief The number of output channels computed together.
+  static const int kBlock = 8;
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief Repack the filters to [group][out block][in][kh][kw][kBlock] if
+  ///        the weights changed since they were last packed.
+  void PackWeights();
+  /// @brief Compute one image, from input to output in NCHW.
+  void ForwardImage(const Dtype* input, Dtype* output);
+
+  bool use_direct_;
+  int out_blocks_;  // output channel blocks per group
+  Blob<Dtype> packed_weights_;
+  BlobChangeTracker<Dtype> weight_tracker_;
+  Blob<Dtype> row_buffer_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_DIRECT_CONV_LAYER_HPP_
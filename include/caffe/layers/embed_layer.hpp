@@ -14,6 +14,9 @@ namespace caffe {
  *        Equivalent to an InnerProductLayer with one-hot vectors as input, but
  *        for efficiency the input is the "hot" index of each column itself.
  *
+ * With sparse_update, Backward_cpu tracks the rows of the weight it
+ * accumulates gradients into, and the solvers update only those.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -30,6 +33,11 @@ class EmbedLayer : public Layer<Dtype> {
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
+  virtual inline const vector<int>* param_diff_rows(int param_id) const {
+    return (sparse_update_ && param_id == 0) ? &diff_rows_ : NULL;
+  }
+  virtual void ClearParamDiffRows();
+
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -45,6 +53,10 @@ class EmbedLayer : public Layer<Dtype> {
   int N_;
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
+  bool sparse_update_;
+  /// The rows of the weight diff written by Backward_cpu, each marked once.
+  vector<int> diff_rows_;
+  vector<bool> row_in_diff_;
 };
 
 }  // namespace caffe
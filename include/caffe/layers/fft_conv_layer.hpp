@@ -0,0 +1,46 @@
+#ifndef CAFFE_FFT_CONV_LAYER_HPP_
+#define CAFFE_FFT_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/fft.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer computing 2D convolutions on CPU by FFT
+ *        (engine: FFT), see FFTConvolver.
+ *
+ * The work per output no longer grows with the kernel area, which pays off
+ * for kernels of about 7x7 and up. With engine FFT the FFT is always used;
+ * with engine DEFAULT, which picks this layer for large kernels, it is used
+ * only when FFTConvolver::relative_cost estimates it to be faster than
+ * im2col + GEMM for the current shapes. N-D convolutions and GPU mode use
+ * the ConvolutionLayer implementation.
+ */
+template <typename Dtype>
+class FFTConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit FFTConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  bool use_fft_;
+  FFTConvolver<Dtype> fft_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FFT_CONV_LAYER_HPP_
@@ -0,0 +1,43 @@
+#ifndef CAFFE_FFT_DECONV_LAYER_HPP_
+#define CAFFE_FFT_DECONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/deconv_layer.hpp"
+#include "caffe/util/fft.hpp"
+
+namespace caffe {
+
+/**
+ * @brief DeconvolutionLayer computing 2D deconvolutions on CPU by FFT
+ *        (engine: FFT), with the forward and backward passes of
+ *        FFTConvolutionLayer swapped.
+ *
+ * Engine selection is as for FFTConvolutionLayer. N-D deconvolutions and GPU
+ * mode use the DeconvolutionLayer implementation.
+ */
+template <typename Dtype>
+class FFTDeconvolutionLayer : public DeconvolutionLayer<Dtype> {
+ public:
+  explicit FFTDeconvolutionLayer(const LayerParameter& param)
+      : DeconvolutionLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  bool use_fft_;
+  FFTConvolver<Dtype> fft_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_FFT_DECONV_LAYER_HPP_
@@ -7,23 +7,45 @@
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 
 #include "caffe/layers/base_data_layer.hpp"
 
 namespace caffe {
 
+/**
+ * @brief A window of consecutive rows of the datasets of an HDF5 file, and
+ *        the order in which to output them.
+ */
+template <typename Dtype>
+class HDF5Chunk {
+ public:
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+  vector<unsigned int> permutation_;
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * By default each file is loaded whole. With HDF5DataParameter.chunk_size,
+ * the files are instead streamed by an internal thread, which reads windows
+ * of chunk_size rows as hyperslabs ahead of Forward, so memory stays bounded
+ * by two windows whatever the size of the files. Shuffling then shuffles the
+ * order of the windows of each file and the rows within each window.
+ *
+ * HDF5 access, from the streaming thread as from HDF5 snapshots or other
+ * layers, is serialized by the global HDF5Lock.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
  public:
   explicit HDF5DataLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), stream_file_id_(-1), chunk_(NULL) {}
   virtual ~HDF5DataLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -47,6 +69,12 @@ class HDF5DataLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
   virtual void LoadHDF5FileData(const char* filename);
+  // Stream the next batch into the tops, from chunks read by the thread.
+  void ForwardStream(const vector<Blob<Dtype>*>& top, bool gpu);
+  virtual void InternalThreadEntry();
+  // Read the next window of rows, moving on to the next file at the end of
+  // the current one.
+  void LoadChunk(HDF5Chunk<Dtype>* chunk);
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
@@ -55,6 +83,18 @@ class HDF5DataLayer : public Layer<Dtype> {
   std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
   std::vector<unsigned int> data_permutation_;
   std::vector<unsigned int> file_permutation_;
+
+  // Streaming: the windows of the current file, owned by the thread.
+  hid_t stream_file_id_;
+  hsize_t stream_rows_;
+  std::vector<unsigned int> window_permutation_;
+  unsigned int current_window_;
+  // The chunks read ahead, and the one being output.
+  vector<shared_ptr<HDF5Chunk<Dtype> > > chunks_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_free_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_full_;
+  HDF5Chunk<Dtype>* chunk_;
+  unsigned int chunk_row_;
 };
 
 }  // namespace caffe
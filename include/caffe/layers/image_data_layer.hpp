@@ -39,6 +39,9 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
 
   vector<std::pair<std::string, int> > lines_;
   int lines_id_;
+  // The size JPEGs are decoded to at least, if scaled_decode.
+  int decode_height_;
+  int decode_width_;
 };
 
 
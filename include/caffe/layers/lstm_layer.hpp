@@ -19,7 +19,8 @@ template <typename Dtype> class RecurrentLayer;
 /**
  * @brief Processes sequential inputs using a "Long Short-Term Memory" (LSTM)
  *        [1] style recurrent neural network (RNN). Implemented by unrolling
- *        the LSTM computation through time.
+ *        the LSTM computation through time, or on CPU with the FUSED engine
+ *        by kernels computing the gates of all units of a timestep at once.
  *
  * The specific architecture used in this implementation is as described in
  * "Learning to Execute" [2], reproduced below:
@@ -58,6 +59,23 @@ class LSTMLayer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief The activated gates (i, f, o, g) of each timestep, f including
+  ///        cont, and their gradient w.r.t. the gate inputs.
+  Blob<Dtype> gates_;
+  /// @brief The cell state of each timestep.
+  Blob<Dtype> cell_;
+  /// @brief The hidden state input to each timestep, cont * h_{t-1}.
+  Blob<Dtype> h_conted_;
+  /// @brief W_xc_static * x_static, and the gradient summed over time.
+  Blob<Dtype> static_gates_;
+  /// @brief The gradients w.r.t. h_{t-1} and c_{t-1} carried back in time.
+  Blob<Dtype> state_diff_;
+  Blob<Dtype> bias_multiplier_;
 };
 
 /**
@@ -0,0 +1,85 @@
+#ifndef CAFFE_PACKED_DATA_LAYER_HPP_
+#define CAFFE_PACKED_DATA_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/packed_tensor.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Provides data to the Net from a memory-mapped packed tensor file
+ *        (see caffe/util/packed_tensor.hpp).
+ *
+ * Each top is the tensor of the file with the same name, and a batch holds
+ * the items of batch_size records. Without shuffling, the items of a batch
+ * are contiguous in the file: when the file stores Dtype values and the top
+ * is not transformed, the top points into the map instead of being copied
+ * into. Otherwise the items are converted into the top one record at a time.
+ * The transform_param, if any, applies to the first top, whose items must
+ * have 3 axes (channels, height, width).
+ *
+ * The pages of the next batch are read ahead, and those of a batch the tops
+ * pointed to are released when the next one is output, which also drops
+ * whatever in-place layers wrote there.
+ */
+template <typename Dtype>
+class PackedDataLayer : public Layer<Dtype> {
+ public:
+  explicit PackedDataLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual ~PackedDataLayer() {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  // Data layers should be shared by multiple solvers in parallel
+  virtual inline bool ShareInParallel() const { return true; }
+  // Data layers have no bottoms, so reshaping is trivial.
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {}
+
+  virtual inline const char* type() const { return "PackedData"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int MinTopBlobs() const { return 1; }
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
+  // Choose the records of the next batch and read them ahead.
+  void NextBatch();
+
+  PackedTensorFile file_;
+  // The tensor of each top.
+  vector<int> tensors_;
+  shared_ptr<DataTransformer<Dtype> > transformer_;
+  // The records of the next batch, in an order drawn every epoch if shuffling.
+  vector<uint64_t> order_;
+  uint64_t position_;
+  vector<uint64_t> batch_;
+  // Whether the records of the next batch follow each other.
+  bool contiguous_;
+  // Whether each top can point into the map, as it stores Dtype values that
+  // are not transformed.
+  vector<bool> can_map_;
+  // The first record of the batch the tops point to, if they do.
+  bool mapped_;
+  uint64_t mapped_record_;
+  // The memory of each top, either its own or pointing into the map.
+  vector<shared_ptr<SyncedMemory> > own_data_;
+  vector<shared_ptr<SyncedMemory> > mapped_data_;
+  // An item of the first top before and after the transformation.
+  Blob<Dtype> item_;
+  Blob<Dtype> transformed_item_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_PACKED_DATA_LAYER_HPP_
@@ -12,6 +12,11 @@ namespace caffe {
 /**
  * @brief Pools the input image by taking the max, average, etc. within regions.
  *
+ * On the CPU the (n, c) planes are split across ThreadPool::Global(), and
+ * the windows that need no clipping take unrolled kernels, specialized for
+ * 2x2 and 3x3 windows of stride 2. Max pooling in the TEST phase does not
+ * write the max_idx_ mask, which Backward recomputes if it is called anyway.
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -44,15 +49,31 @@ class PoolingLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  // The number of tasks to split the planes of a batch into on the CPU.
+  int NumTasks() const;
+  // Pool a plane, writing the mask to mask or top_mask unless both are NULL.
+  void ForwardPlane(const Dtype* bottom_data, Dtype* top_data, int* mask,
+      Dtype* top_mask);
+  void ForwardPlanes(const Dtype* bottom_data, Dtype* top_data, int* mask,
+      Dtype* top_mask, int num_tasks, int task, int slot);
+  void BackwardPlane(const Dtype* top_diff, const int* mask,
+      const Dtype* top_mask, Dtype* bottom_diff);
+  void BackwardPlanes(const Dtype* top_diff, const int* mask,
+      const Dtype* top_mask, Dtype* bottom_diff, int num_tasks, int task,
+      int slot);
+
   int kernel_h_, kernel_w_;
   int stride_h_, stride_w_;
   int pad_h_, pad_w_;
+  int num_;
   int channels_;
   int height_, width_;
   int pooled_height_, pooled_width_;
   bool global_pooling_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  // The output of pooling again in Backward_cpu to recompute max_idx_.
+  Blob<Dtype> scratch_top_;
 };
 
 }  // namespace caffe
@@ -21,6 +21,12 @@ template <typename Dtype> class RecurrentLayer;
  *        unrolled network.  This Layer type cannot be instantiated -- instead,
  *        you should use one of its implementations which defines the recurrent
  *        architecture, such as RNNLayer or LSTMLayer.
+ *
+ * Unless expose_hidden is set, the hidden state at the last timestep is
+ * carried over as the initial state of the next Forward, so that a sequence
+ * may be streamed a few timesteps (or a single one) at a time. The state of
+ * each of the N streams may then be reset, saved and restored on its own,
+ * e.g. to switch a stream to another sequence between calls.
  */
 template <typename Dtype>
 class RecurrentLayer : public Layer<Dtype> {
@@ -33,6 +39,20 @@ class RecurrentLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Reset();
 
+  /**
+   * @brief Zeroes the hidden state that stream n carries over to the next
+   *        Forward, which then starts a new sequence for it as a sequence
+   *        continuation indicator of 0 would.
+   */
+  void ResetStream(int n);
+  /**
+   * @brief Copies the hidden state that stream n carries over to the next
+   *        Forward into state, the recurrent Blob&s one after the other.
+   */
+  void GetStreamState(int n, Blob<Dtype>* state) const;
+  /// @brief Restores the hidden state of stream n from GetStreamState.
+  void SetStreamState(int n, const Blob<Dtype>& state);
+
   virtual inline const char* type() const { return "Recurrent"; }
   virtual inline int MinBottomBlobs() const {
     int min_bottoms = 2;
@@ -58,6 +78,8 @@ class RecurrentLayer : public Layer<Dtype> {
     // Can't propagate to sequence continuation indicators.
     return bottom_index != 1;
   }
+  // Forward carries the hidden state over to the next call.
+  virtual inline bool AllowRecompute() const { return false; }
 
  protected:
   /**
@@ -66,6 +88,18 @@ class RecurrentLayer : public Layer<Dtype> {
    */
   virtual void FillUnrolledNet(NetParameter* net_param) const = 0;
 
+  /**
+   * @brief Computes the recurrence with fused CPU kernels instead of the
+   *        unrolled net, whose parameters and recurrent input/output Blob&s
+   *        they use, for the FUSED engine.  Subclasses should define this --
+   *        see RNNLayer and LSTMLayer for examples.
+   */
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) = 0;
+  virtual void FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) = 0;
+
   /**
    * @brief Fills names with the names of the 0th timestep recurrent input
    *        Blob&s.  Subclasses should define this -- see RNNLayer and LSTMLayer
@@ -147,9 +181,15 @@ class RecurrentLayer : public Layer<Dtype> {
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+  /// @brief The number of values of the hidden state of each stream.
+  int StreamStateCount() const;
+
   /// @brief A Net to implement the Recurrent functionality.
   shared_ptr<Net<Dtype> > unrolled_net_;
 
+  /// @brief Whether the CPU passes use FusedForward_cpu/FusedBackward_cpu.
+  bool fused_;
+
   /// @brief The number of independent streams to process simultaneously.
   int N_;
 
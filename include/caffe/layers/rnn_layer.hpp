@@ -18,7 +18,8 @@ template <typename Dtype> class RecurrentLayer;
 
 /**
  * @brief Processes time-varying inputs using a simple recurrent neural network
- *        (RNN). Implemented as a network unrolling the RNN computation in time.
+ *        (RNN). Implemented as a network unrolling the RNN computation in time,
+ *        or on CPU with the FUSED engine by a GEMM and a tanh per timestep.
  *
  * Given time-varying inputs @f$ x_t @f$, computes hidden state @f$
  *     h_t := \tanh[ W_{hh} h_{t_1} + W_{xh} x_t + b_h ]
@@ -40,6 +41,23 @@ class RNNLayer : public RecurrentLayer<Dtype> {
   virtual void RecurrentOutputBlobNames(vector<string>* names) const;
   virtual void RecurrentInputShapes(vector<BlobShape>* shapes) const;
   virtual void OutputBlobNames(vector<string>* names) const;
+  virtual void FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief The hidden state of each timestep, and the gradient w.r.t. its
+  ///        input to the tanh.
+  Blob<Dtype> hidden_;
+  /// @brief The hidden state input to each timestep, cont * h_{t-1}.
+  Blob<Dtype> h_conted_;
+  /// @brief W_xh_static * x_static, and the gradient summed over time.
+  Blob<Dtype> static_hidden_;
+  /// @brief The gradient w.r.t. the input to the output tanh.
+  Blob<Dtype> output_diff_;
+  /// @brief The gradient w.r.t. h_{t-1} carried back in time.
+  Blob<Dtype> h_diff_;
+  Blob<Dtype> bias_multiplier_;
 };
 
 }  // namespace caffe
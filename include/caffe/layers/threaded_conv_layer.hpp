@@ -0,0 +1,52 @@
+#ifndef CAFFE_THREADED_CONV_LAYER_HPP_
+#define CAFFE_THREADED_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer that splits the images of a batch across the
+ *        threads of ThreadPool::Global() on CPU (engine: THREADED).
+ *
+ * Each thread has a column buffer of its own and, in Backward, accumulates
+ * the weight gradient of its images in a buffer of its own; the buffers are
+ * summed into the weight diff once all images are done. This scales with the
+ * batch even when the per-image GEMMs are too small for a multithreaded BLAS,
+ * which should then be limited to one thread. Falls back to ConvolutionLayer
+ * in GPU mode.
+ */
+template <typename Dtype>
+class ThreadedConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit ThreadedConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  // Per-image work run on the pool; slot picks the thread's buffers.
+  void ForwardImage(const Dtype* bottom_data, const Dtype* weight,
+      Dtype* top_data, int n, int slot);
+  void BackwardImage(const Dtype* top_diff, const Dtype* bottom_data,
+      const Dtype* weight, Dtype* bottom_diff, bool propagate_down, int n,
+      int slot);
+  /// @brief Make one column buffer per pool thread.
+  void PrepareColBuffers(int num_threads);
+
+  vector<shared_ptr<Blob<Dtype> > > col_buffers_;
+  vector<shared_ptr<Blob<Dtype> > > weight_diff_buffers_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_THREADED_CONV_LAYER_HPP_
@@ -0,0 +1,79 @@
+#ifndef CAFFE_WINOGRAD_CONV_LAYER_HPP_
+#define CAFFE_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/blob_change_tracker.hpp"
+
+namespace caffe {
+
+/**
+ * @brief ConvolutionLayer computing 3x3, stride 1 convolutions on CPU with
+ *        the Winograd minimal filtering algorithm F(m x m, 3 x 3)
+ *        (engine: WINOGRAD).
+ *
+ * The input is cut into overlapping (m + 2) x (m + 2) tiles, each producing an
+ * m x m output tile (m = winograd_tile, 2 or 4). Inputs and filters are
+ * transformed so that each tile needs (m + 2)^2 multiplications per channel
+ * pair instead of 9 m^2, i.e. 2.25x (m = 2) to 4x (m = 4) fewer, and the
+ * channel reduction becomes one GEMM per transformed position. The backward
+ * passes use the transposed transforms. The transformed filters are cached
+ * and recomputed when the weights change. F(4 x 4) saves more work but
+ * rounds more than F(2 x 2).
+ *
+ * Other kernel shapes, strides and dilations, and GPU mode, use the
+ * ConvolutionLayer implementation.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief Recompute the transformed filters if the weights changed.
+  void TransformWeights();
+  /// @brief Transform the input tiles of one image and group into V.
+  void TransformInput(const Dtype* input, Dtype* v);
+  /// @brief Transform an output gradient of one image and group into dM.
+  void TransformOutputDiff(const Dtype* top_diff, Dtype* m);
+  /// @brief Inverse transform M into one image and group of the output.
+  void TransformOutput(const Dtype* m, const Dtype* bias, Dtype* output);
+  /// @brief Inverse transform dV and add it to the input gradient.
+  void TransformInputDiff(const Dtype* v, Dtype* bottom_diff);
+
+  bool use_winograd_;
+  int tile_;          // m, the output tile size
+  int alpha_;         // m + 2, the input tile size
+  int tiles_h_, tiles_w_, num_tiles_;
+  int in_per_group_, out_per_group_;
+  // The transform matrices B^T, B, A^T, A, G and G^T, row-major.
+  vector<Dtype> bt_, b_, at_, a_, g_, gt_;
+  /// Transformed filters, [group][alpha^2][out_per_group][in_per_group].
+  Blob<Dtype> transformed_weights_;
+  /// Tells when the weights changed since transformed_weights_ was computed.
+  BlobChangeTracker<Dtype> weight_tracker_;
+  /// Per-image scratch: [alpha^2][channels][num_tiles] for V and M.
+  Blob<Dtype> v_buffer_;
+  Blob<Dtype> m_buffer_;
+  /// Weight gradient in the transformed domain, like transformed_weights_.
+  Blob<Dtype> transformed_weight_diff_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_WINOGRAD_CONV_LAYER_HPP_
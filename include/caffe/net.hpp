@@ -11,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blob_change_tracker.hpp"
 
 namespace caffe {
 
@@ -191,6 +192,13 @@ class Net {
     return param_names_index_;
   }
   inline const vector<int>& param_owners() const { return param_owners_; }
+  /**
+   * @brief Returns the rows of the diff of the learnable parameter param_id
+   *        that Backward accumulated into since ClearParamDiffs, when the
+   *        only layer using the parameter tracks them in CPU mode (see
+   *        Layer::param_diff_rows); otherwise NULL, for all of them.
+   */
+  const vector<int>* param_diff_rows(int param_id) const;
   inline const vector<string>& param_display_names() const {
     return param_display_names_;
   }
@@ -216,6 +224,25 @@ class Net {
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
+  /// @brief Whether activations are recomputed during Backward instead of
+  ///        being kept from Forward (see NetParameter.checkpoint_param).
+  inline bool checkpointing() const { return !segment_begin_.empty(); }
+  /**
+   * @brief The bytes of activation data the net holds at its peak, without
+   *        (full_bytes) and with (peak_bytes) recomputation.
+   */
+  void CheckpointMemory(size_t* full_bytes, size_t* peak_bytes) const;
+  /// @brief The time in milliseconds spent recomputing activations so far.
+  inline double recompute_time() const { return recompute_time_; }
+  /**
+   * @brief The layer ids of each Convolution -> BatchNorm [-> Scale]
+   *        [-> ReLU] chain run as one convolution in CPU mode (see
+   *        NetParameter.fuse_convolution).
+   */
+  inline const vector<vector<int> >& fused_convolutions() const {
+    return fusion_layers_;
+  }
+
   // Helpers for Init.
   /**
    * @brief Remove layers that the user specified should be excluded given the current
@@ -241,6 +268,27 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Place top blobs with disjoint lifetimes in shared buffers, logging
+  ///        the plan at INFO level if log_plan and at VLOG(1) otherwise.
+  void OptimizeMemory(bool log_plan);
+  /// @brief Split the net into segments and choose the blobs each segment
+  ///        drops after Forward.
+  void PlanCheckpoints(const CheckpointParameter& param);
+  /// @brief Drop the recomputable activations of a segment.
+  void ReleaseSegment(const int segment);
+  /// @brief Rerun the layers of a segment whose activations were dropped.
+  void RecomputeSegment(const int segment);
+  /**
+   * @brief Find the convolution chains to fuse, record their layer ids and
+   *        make each chain compute in place on its last top.
+   */
+  void PlanConvolutionFusion(NetParameter* param);
+  /// @brief Create the convolution layers the chains are run with.
+  void SetUpConvolutionFusion();
+  /// @brief Refold the parameters of a chain into its fused layer if they
+  ///        changed.
+  void FoldConvolution(const int fusion);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -295,6 +343,9 @@ class Net {
    * and learnable_params_[learnable_param_ids_[i]] gives its owner.
    */
   vector<int> learnable_param_ids_;
+  /// the (layer, param) index of each of learnable_params_, or (-1, -1) if
+  /// several layers share it
+  vector<pair<int, int> > learnable_param_layer_indices_;
   /// the learning rate multipliers for learnable_params_
   vector<float> params_lr_;
   vector<bool> has_params_lr_;
@@ -305,6 +356,26 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// Whether top blobs are planned into shared buffers (optimize_memory).
+  bool optimize_memory_;
+  /// The buffers holding the planned top blobs.
+  vector<shared_ptr<SyncedMemory> > activation_buffers_;
+  /// Activation recomputation: the first layer of each segment, the segment
+  /// of each layer, and per segment the blobs dropped after Forward, the
+  /// layers rerun to restore them and whether they are currently dropped.
+  vector<int> segment_begin_;
+  vector<int> layer_segment_;
+  vector<vector<int> > segment_released_blobs_;
+  vector<vector<int> > segment_recompute_layers_;
+  vector<bool> segment_released_;
+  double recompute_time_;
+  /// Convolution fusion: the layer ids of each chain, the convolution layer
+  /// running it with the folded parameters, what tells when the parameters
+  /// of the chain changed, and for each layer the chain it starts or -1.
+  vector<vector<int> > fusion_layers_;
+  vector<shared_ptr<Layer<Dtype> > > fused_layers_;
+  vector<shared_ptr<BlobChangeTracker<Dtype> > > fusion_trackers_;
+  vector<int> layer_fusion_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
   DISABLE_COPY_AND_ASSIGN(Net);
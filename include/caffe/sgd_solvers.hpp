@@ -2,6 +2,7 @@
 #define CAFFE_SGD_SOLVERS_HPP_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "caffe/solver.hpp"
@@ -31,6 +32,10 @@ class SGDSolver : public Solver<Dtype> {
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
   virtual void ClipGradients();
+  // The [offset, offset + count) ranges of learnable param param_id to update
+  // in CPU mode: the rows its layer wrote (see Net::param_diff_rows), or all
+  // of it.
+  void UpdateRanges(int param_id, vector<pair<int, int> >* ranges);
   virtual void SnapshotSolverState(const string& model_filename);
   virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
   virtual void SnapshotSolverStateToHDF5(const string& model_filename);
@@ -0,0 +1,54 @@
+#ifndef CAFFE_UTIL_BLOB_CHANGE_TRACKER_HPP_
+#define CAFFE_UTIL_BLOB_CHANGE_TRACKER_HPP_
+
+#include <boost/weak_ptr.hpp>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Tells whether the data of some blobs may have changed since it was
+ *        last seen, so that what is derived from it, such as transformed or
+ *        folded weights, is only recomputed after a change.
+ *
+ * It remembers the SyncedMemory and version of each blob, and a copy of its
+ * values. Taking a pointer from mutable_cpu_data(), mutable_gpu_data() or
+ * set_cpu_data(), as the solver's Update and loading trained weights do,
+ * counts as a change without comparing. Otherwise the values are compared
+ * with the copy, as a pointer obtained earlier, e.g. a numpy view from
+ * pycaffe, may have been written without bumping the version.
+ */
+template <typename Dtype>
+class BlobChangeTracker {
+ public:
+  BlobChangeTracker() : seen_(false) {}
+
+  /// @brief Return whether the data of the blobs may differ from that seen
+  ///        by the previous call, and remember it; the first call returns
+  ///        true.
+  bool Changed(const vector<Blob<Dtype>*>& blobs);
+  bool Changed(const Blob<Dtype>& blob);
+  /// @brief Make the next call to Changed return true.
+  void Reset();
+
+ protected:
+  /// @brief Remember the data of blob as the i-th one, returning whether it
+  ///        differs from that remembered before.
+  bool Update(int i, const Blob<Dtype>& blob);
+
+  bool seen_;
+  vector<boost::weak_ptr<SyncedMemory> > memories_;
+  vector<size_t> versions_;
+  vector<vector<Dtype> > values_;
+
+  DISABLE_COPY_AND_ASSIGN(BlobChangeTracker);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_BLOB_CHANGE_TRACKER_HPP_
@@ -15,9 +15,15 @@ class Cursor {
   Cursor() { }
   virtual ~Cursor() { }
   virtual void SeekToFirst() = 0;
+  // Move to the first key not less than key.
+  virtual void Seek(const string& key) = 0;
   virtual void Next() = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  // The value without a copy. It stays valid until the cursor moves or, if
+  // pins_values(), for as long as the cursor lives.
+  virtual void value_data(const char** data, size_t* size) = 0;
+  virtual bool pins_values() const { return false; }
   virtual bool valid() = 0;
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
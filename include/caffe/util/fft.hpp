@@ -0,0 +1,132 @@
+#ifndef CAFFE_UTIL_FFT_HPP_
+#define CAFFE_UTIL_FFT_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/blob_change_tracker.hpp"
+
+namespace caffe {
+
+/// @brief The smallest power of two >= n.
+int fft_size(int n);
+
+/**
+ * @brief In-place FFTs of height x width complex arrays stored as separate
+ *        real and imaginary parts; both sizes must be powers of two.
+ *
+ * The twiddle factors are computed once by Reshape for all the transforms of
+ * that size. The inverse transform is scaled by 1 / (height * width), so that
+ * it undoes the forward one.
+ */
+template <typename Dtype>
+class FFTPlan {
+ public:
+  FFTPlan() : height_(0), width_(0) {}
+
+  /// @brief Set the sizes, recomputing the tables if they changed.
+  void Reshape(int height, int width);
+  void Transform(Dtype* re, Dtype* im, bool inverse) const;
+
+ protected:
+  int height_, width_;
+  // cos and sin of 2 pi k / n for k < n / 2, for n the width and height.
+  vector<Dtype> cos_w_, sin_w_, cos_h_, sin_h_;
+};
+
+/// @brief A single transform with FFTPlan.
+template <typename Dtype>
+void fft_2d_cpu(int height, int width, Dtype* re, Dtype* im, bool inverse);
+
+/**
+ * @brief 2D convolution (in the sense of ConvolutionLayer: correlation of the
+ *        padded input with the filters) computed by FFT on CPU.
+ *
+ * The padded input is cut into overlapping tile_h x tile_w tiles, each giving
+ * (tile - kernel_extent + 1) outputs per axis at stride 1 (overlap-save), so
+ * the spectra stay small whatever the input size. Outputs are then picked
+ * at the actual stride. At each frequency the channel reduction is a
+ * pointwise complex multiply-add, whose cost per output no longer grows with
+ * kernel_h * kernel_w, so it pays off for large kernels.
+ *
+ * The filter spectra are cached and recomputed when the weights change.
+ * Sizes and weights follow BaseConvolutionLayer in the convolution
+ * direction: weights are (out_channels, in_channels / group, kernel_h,
+ * kernel_w).
+ */
+template <typename Dtype>
+class FFTConvolver {
+ public:
+  FFTConvolver() : tile_h_(0), tile_w_(0), spectra_valid_(false) {}
+
+  /**
+   * @brief Set the geometry. The shape arguments are (height, width) pairs;
+   *        output_shape must be the one ConvolutionLayer computes.
+   */
+  void Reshape(int in_channels, int out_channels, int group,
+      const int* input_shape, const int* output_shape, const int* kernel_shape,
+      const int* pad, const int* stride, const int* dilation);
+
+  /**
+   * @brief Estimated multiply-adds of Forward over num images divided by
+   *        those of im2col + GEMM, weighted by how much faster GEMM runs;
+   *        below 1 the FFT is expected to win.
+   */
+  double relative_cost(int num) const;
+
+  /// @brief output = conv(input) for num images; overwrites output.
+  void Forward(const Blob<Dtype>& weights, const Dtype* input,
+      Dtype* output, int num);
+  /// @brief input_diff = gradient of Forward; overwrites input_diff.
+  void BackwardData(const Blob<Dtype>& weights, const Dtype* output_diff,
+      Dtype* input_diff, int num);
+  /// @brief Add the weight gradient over num images to weight_diff.
+  void WeightGrad(const Dtype* input, const Dtype* output_diff,
+      Dtype* weight_diff, int num);
+
+ protected:
+  /// @brief Recompute the filter spectra if the weights changed.
+  void UpdateSpectra(const Blob<Dtype>& weights);
+  /**
+   * @brief Load the tile at (h0, w0) of a rows x cols channel that is
+   *        shifted by offset and upsampled by step into re and im, and
+   *        transform it.
+   *
+   * Values outside the channel, and beyond valid_h x valid_w in the tile,
+   * read as zero.
+   */
+  void LoadTile(const Dtype* channel, int rows, int cols, int offset_h,
+      int offset_w, int step_h, int step_w, int h0, int w0, int valid_h,
+      int valid_w, Dtype* re, Dtype* im);
+
+  int in_channels_, out_channels_, group_;
+  int in_per_group_, out_per_group_;
+  int height_, width_, output_h_, output_w_;
+  int kernel_h_, kernel_w_, pad_h_, pad_w_;
+  int stride_h_, stride_w_, dilation_h_, dilation_w_;
+  int extent_h_, extent_w_;  // dilated kernel sizes
+  int full_h_, full_w_;      // stride 1 output sizes
+  int tile_h_, tile_w_;      // FFT sizes
+  int step_h_, step_w_;      // valid outputs per tile
+  int tile_size_;            // tile_h_ * tile_w_
+  FFTPlan<Dtype> plan_;      // for tile_h_ x tile_w_ transforms
+
+  /// Filter spectra, [out_channels][in_per_group][freq], real and imaginary
+  /// parts.
+  Blob<Dtype> weight_re_, weight_im_;
+  /// Tells when the weights changed since the spectra were computed.
+  BlobChangeTracker<Dtype> weight_tracker_;
+  bool spectra_valid_;
+  /// Spectra of the input and output tiles of one group, [in_per_group][freq]
+  /// and [out_per_group][freq].
+  Blob<Dtype> in_re_, in_im_, out_re_, out_im_;
+  /// Weight gradient spectra, like weight_re_ and weight_im_.
+  Blob<Dtype> weight_diff_re_, weight_diff_im_;
+
+  DISABLE_COPY_AND_ASSIGN(FFTConvolver);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_FFT_HPP_
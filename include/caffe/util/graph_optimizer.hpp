@@ -0,0 +1,103 @@
+#ifndef CAFFE_UTIL_GRAPH_OPTIMIZER_HPP_
+#define CAFFE_UTIL_GRAPH_OPTIMIZER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A rewrite of a NetParameter that Net::Init runs after filtering the
+ *        layers and before inserting the splits and creating the layers.
+ *
+ * A pass must leave the net computing the same outputs, which are the blobs
+ * no layer reads, the tops with a loss weight and the blobs listed in
+ * GraphOptimizerParameter.output.
+ */
+class GraphPass {
+ public:
+  virtual ~GraphPass() {}
+  /// @brief The name the pass is reported by.
+  virtual const char* name() const = 0;
+  /// @brief Whether the pass runs for the given settings.
+  virtual bool enabled(const GraphOptimizerParameter& param) const = 0;
+  /// @brief Rewrite *net, appending the names of the layers or blobs it
+  ///        removed to *removed.
+  virtual void Run(const GraphOptimizerParameter& param, NetParameter* net,
+      vector<string>* removed) const = 0;
+};
+
+// Dead layer elimination: removes the layers none of whose tops is an output
+// or read by a kept layer, other than by a Silence layer.
+class EliminateDeadLayersPass : public GraphPass {
+ public:
+  virtual const char* name() const { return "EliminateDeadLayers"; }
+  virtual bool enabled(const GraphOptimizerParameter& param) const {
+    return param.eliminate_dead_layers();
+  }
+  virtual void Run(const GraphOptimizerParameter& param, NetParameter* net,
+      vector<string>* removed) const;
+};
+
+// In-place conversion: makes the elementwise layers that support computing
+// in place do so when no other layer reads their bottom, removing their top.
+// In nets that run Backward, the layer computing the bottom must also not
+// read it in its own Backward.
+class ConvertInPlacePass : public GraphPass {
+ public:
+  virtual const char* name() const { return "ConvertInPlace"; }
+  virtual bool enabled(const GraphOptimizerParameter& param) const {
+    return param.convert_in_place();
+  }
+  virtual void Run(const GraphOptimizerParameter& param, NetParameter* net,
+      vector<string>* removed) const;
+};
+
+// Identity removal: removes the Split layers and the Flatten and Reshape
+// layers that keep the shape of their bottom, making their consumers read
+// the bottom instead.
+class RemoveIdentityLayersPass : public GraphPass {
+ public:
+  virtual const char* name() const { return "RemoveIdentityLayers"; }
+  virtual bool enabled(const GraphOptimizerParameter& param) const {
+    return param.remove_identity_layers();
+  }
+  virtual void Run(const GraphOptimizerParameter& param, NetParameter* net,
+      vector<string>* removed) const;
+};
+
+// Constant folding: computes the layers that only depend on constant
+// DummyData tops and on fixed Parameter layers whose values the NetParameter
+// holds, replacing them with Parameter layers holding the results.
+class FoldConstantsPass : public GraphPass {
+ public:
+  virtual const char* name() const { return "FoldConstants"; }
+  virtual bool enabled(const GraphOptimizerParameter& param) const {
+    return param.fold_constants();
+  }
+  virtual void Run(const GraphOptimizerParameter& param, NetParameter* net,
+      vector<string>* removed) const;
+};
+
+/**
+ * @brief The passes OptimizeGraph runs, in order: the built-in constant
+ *        folding, identity removal, dead layer elimination and in-place
+ *        conversion, followed by those added with RegisterGraphPass.
+ */
+const vector<shared_ptr<GraphPass> >& GraphPasses();
+
+/// @brief Append a pass to those OptimizeGraph runs.
+void RegisterGraphPass(shared_ptr<GraphPass> pass);
+
+// Copy param, running the passes enabled by its graph_optimizer_param on the
+// copy. If report is given, one line per pass run is appended to it, naming
+// what the pass removed.
+void OptimizeGraph(const NetParameter& param, NetParameter* param_optimized,
+    vector<string>* report = NULL);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_GRAPH_OPTIMIZER_HPP_
@@ -2,6 +2,7 @@
 #define CAFFE_UTIL_HDF5_H_
 
 #include <string>
+#include <vector>
 
 #include "hdf5.h"
 #include "hdf5_hl.h"
@@ -10,6 +11,28 @@
 
 namespace caffe {
 
+/**
+ * @brief Holds the lock every call into HDF5 is made under.
+ *
+ * The HDF5 library is usually built without thread safety, and
+ * HDF5DataLayer reads from its own thread while the solver snapshots or
+ * HDF5OutputLayer writes. The lock is recursive: the functions below take it
+ * themselves and may be called with it held.
+ */
+class HDF5Lock {
+ public:
+  HDF5Lock();
+  ~HDF5Lock();
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(HDF5Lock);
+};
+
+// Returns the dimensions of a dataset, verifying it holds numbers and has
+// between min_dim and max_dim axes.
+std::vector<hsize_t> hdf5_get_dataset_dims(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim);
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
@@ -20,6 +43,13 @@ void hdf5_load_nd_dataset(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob);
 
+// Loads rows [row, row + num_rows) of a dataset, the first axis indexing the
+// rows, reading only them from the file.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(
+    hid_t file_id, const char* dataset_name_, hsize_t row, hsize_t num_rows,
+    Blob<Dtype>* blob);
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
@@ -0,0 +1,70 @@
+#ifndef CAFFE_UTIL_HOST_MEMORY_POOL_HPP_
+#define CAFFE_UTIL_HOST_MEMORY_POOL_HPP_
+
+#include <cstddef>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A process-wide caching arena for host (CPU) memory.
+ *
+ * Blocks are rounded up to a size class and 64-byte aligned. Freed blocks are
+ * kept on a per-class free list and handed out again to later requests of the
+ * same class, so repeated net construction and Blob::Reshape cycles reuse
+ * memory instead of going back to the system allocator and faulting in fresh
+ * pages. The pool is disabled by default; when disabled, Allocate() is never
+ * called and CaffeMallocHost falls back to plain malloc.
+ */
+class HostMemoryPool {
+ public:
+  struct Stats {
+    // Allocations served from a free list.
+    size_t hits;
+    // Allocations that had to go to the system allocator.
+    size_t misses;
+    // Bytes (rounded to size class) handed out and not yet returned.
+    size_t bytes_in_use;
+    // Bytes held on the free lists, ready for reuse.
+    size_t bytes_cached;
+    // High-water mark of bytes_in_use + bytes_cached.
+    size_t peak_bytes_held;
+  };
+
+  static const size_t kAlignment = 64;
+
+  // Whether CaffeMallocHost routes host allocations through the pool.
+  // Blocks already handed out stay valid when the pool is toggled off.
+  // Does not lock, so that allocations pay nothing while the pool is off.
+  static bool enabled();
+  static void set_enabled(bool enabled);
+  // Whether any block from Allocate() has not been freed yet; while not,
+  // CaffeFreeHost skips Free(). Does not lock.
+  static bool has_live_blocks();
+
+  // Upper bound on bytes kept on the free lists; 0 means unbounded.
+  // Blocks returned past the limit are released to the system.
+  static size_t max_cached_bytes();
+  static void set_max_cached_bytes(size_t bytes);
+
+  // Returns a 64-byte aligned block of at least size bytes.
+  static void* Allocate(size_t size);
+  // Returns a block to the pool. Returns false, and does nothing, if ptr was
+  // not obtained from Allocate().
+  static bool Free(void* ptr);
+  // Releases every cached block back to the system.
+  static void Trim();
+
+  static Stats stats();
+  static void ResetStats();
+  // Logs the current statistics at INFO level.
+  static void LogStats();
+
+  // The size class a request of the given size is rounded up to.
+  static size_t SizeClass(size_t size);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_MEMORY_POOL_HPP_
@@ -11,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/format.hpp"
+#include "caffe/util/mapped_datum.hpp"
 
 #ifndef CAFFE_TMP_DIR_RETRIES
 #define CAFFE_TMP_DIR_RETRIES 100
@@ -133,6 +134,12 @@ bool DecodeDatum(Datum* datum, bool is_color);
 cv::Mat ReadImageToCVMat(const string& filename,
     const int height, const int width, const bool is_color);
 
+// Read the image at a reduced scale that is still at least min_height x
+// min_width, if it is a JPEG, before resizing it (see DecodeImageToCVMat).
+cv::Mat ReadImageToCVMat(const string& filename,
+    const int height, const int width, const bool is_color,
+    const int min_height, const int min_width);
+
 cv::Mat ReadImageToCVMat(const string& filename,
     const int height, const int width);
 
@@ -141,8 +148,25 @@ cv::Mat ReadImageToCVMat(const string& filename,
 
 cv::Mat ReadImageToCVMat(const string& filename);
 
-cv::Mat DecodeDatumToCVMatNative(const Datum& datum);
-cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
+// Decode the encoded image of size bytes with cv::imdecode's cv_read_flag.
+// If min_height or min_width is given and the image is a JPEG, it is decoded
+// at the smallest of 1/8, 1/4 and 1/2 of its size that is still at least
+// min_height x min_width: libjpeg then does a reduced inverse DCT, which
+// costs a fraction of the full decode. This takes OpenCV 3.1 or later;
+// older versions always decode at full size.
+cv::Mat DecodeImageToCVMat(const char* data, size_t size, int cv_read_flag,
+    int min_height = 0, int min_width = 0);
+
+// The min_height and min_width of the decodes are as in DecodeImageToCVMat.
+cv::Mat DecodeDatumToCVMatNative(const Datum& datum, int min_height = 0,
+    int min_width = 0);
+cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color,
+    int min_height = 0, int min_width = 0);
+// Decode the data bytes where they are, without copying them first.
+cv::Mat DecodeDatumToCVMatNative(const MappedDatum& datum, int min_height = 0,
+    int min_width = 0);
+cv::Mat DecodeDatumToCVMat(const MappedDatum& datum, bool is_color,
+    int min_height = 0, int min_width = 0);
 
 void CVMatToDatum(const cv::Mat& cv_img, Datum* datum);
 #endif  // USE_OPENCV
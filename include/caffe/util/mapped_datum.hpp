@@ -0,0 +1,58 @@
+#ifndef CAFFE_UTIL_MAPPED_DATUM_HPP_
+#define CAFFE_UTIL_MAPPED_DATUM_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A Datum parsed from a database value whose data bytes can be left
+ *        in the value instead of being copied into the Datum.
+ *
+ * LMDB cursors return values that point into the memory map of the database
+ * and stay valid as long as their read transaction, which the cursor keeps
+ * open. Referring to the pixel bytes there saves copying them out of the map,
+ * so they are only read once, when transformed into the batch.
+ */
+class MappedDatum {
+ public:
+  MappedDatum() : data_(NULL), data_size_(0) {}
+
+  /**
+   * @brief Parse a serialized Datum. If map is true, the data bytes are
+   *        referred to in place, so serialized must stay valid until the
+   *        next Parse; the other fields are copied into datum().
+   * @return whether serialized is a valid Datum.
+   */
+  bool Parse(const char* serialized, size_t size, bool map);
+  /// @brief Exchange the contents of two datums without copying the data.
+  void Swap(MappedDatum* other);
+
+  /// @brief The fields of the Datum; its data is empty if is_mapped().
+  inline const Datum& datum() const { return datum_; }
+  /// @brief Whether the data bytes are referred to in place.
+  inline bool is_mapped() const { return data_ != NULL; }
+  /// @brief The data bytes, wherever they are.
+  inline const char* data() const {
+    return is_mapped() ? data_ : datum_.data().data();
+  }
+  inline size_t data_size() const {
+    return is_mapped() ? data_size_ : datum_.data().size();
+  }
+
+ protected:
+  Datum datum_;
+  const char* data_;
+  size_t data_size_;
+  /// The serialized fields other than the data, reused across Parse calls.
+  string header_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedDatum);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MAPPED_DATUM_HPP_
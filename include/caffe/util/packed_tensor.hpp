@@ -0,0 +1,145 @@
+#ifndef CAFFE_UTIL_PACKED_TENSOR_HPP_
+#define CAFFE_UTIL_PACKED_TENSOR_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * A packed tensor file holds a fixed number of records, each made of one
+ * item of every tensor of the file, an item having the same shape and type in
+ * all records. It is laid out, in native byte order, as:
+ *
+ *   PackedFileHeader
+ *   PackedTensorHeader[num_tensors]
+ *   for each tensor, from its offset, which is a multiple of
+ *   kPackedAlignment, the items of all the records one after another.
+ *
+ * So the items of consecutive records are contiguous, and reading a batch
+ * of them is a single copy out of the memory-mapped file, or no copy at all.
+ */
+enum PackedType {
+  PACKED_UINT8 = 1,
+  PACKED_FLOAT = 2,
+  PACKED_DOUBLE = 3
+};
+
+const char kPackedMagic[8] = {'C', 'A', 'F', 'F', 'E', 'P', 'K', 'T'};
+const uint32_t kPackedVersion = 1;
+const int kPackedMaxAxes = 8;
+const int kPackedMaxName = 64;
+const uint64_t kPackedAlignment = 4096;
+
+struct PackedFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_tensors;
+  uint64_t num_records;
+};
+
+struct PackedTensorHeader {
+  char name[kPackedMaxName];  // NUL-terminated
+  uint32_t type;
+  uint32_t num_axes;
+  uint32_t shape[kPackedMaxAxes];  // of one item
+  uint64_t offset;
+};
+
+/// @brief The size in bytes of one value of type.
+size_t PackedTypeSize(PackedType type);
+
+/// @brief The type storing Dtype values as they are.
+template <typename Dtype> inline PackedType packed_type();
+template <> inline PackedType packed_type<float>() { return PACKED_FLOAT; }
+template <> inline PackedType packed_type<double>() { return PACKED_DOUBLE; }
+
+/// @brief A tensor of a packed file, as described by its header.
+struct PackedTensor {
+  string name;
+  PackedType type;
+  vector<int> shape;
+  // The size in bytes of one item, and where the items start in the file.
+  size_t item_size;
+  uint64_t offset;
+};
+
+/**
+ * @brief Creates a packed tensor file by mapping it, so that the items are
+ *        written in place.
+ */
+class PackedTensorWriter {
+ public:
+  PackedTensorWriter() : map_(NULL), map_size_(0), num_records_(0) {}
+  ~PackedTensorWriter() { Close(); }
+
+  /// @brief Declare a tensor, before Open.
+  void AddTensor(const string& name, PackedType type, const vector<int>& shape);
+  /// @brief Create the file with room for num_records records.
+  void Open(const string& filename, uint64_t num_records);
+  /// @brief The item of a tensor in a record, to be filled in.
+  char* mutable_item(int tensor, uint64_t record);
+  /// @brief Copy an item of item_size bytes into place.
+  void Write(int tensor, uint64_t record, const void* data);
+  void Close();
+
+ private:
+  vector<PackedTensor> tensors_;
+  char* map_;
+  size_t map_size_;
+  uint64_t num_records_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedTensorWriter);
+};
+
+/**
+ * @brief Reads a packed tensor file through a private memory map: the items
+ *        can be written to in place without changing the file, and
+ *        DontNeed reverts such writes.
+ */
+class PackedTensorFile {
+ public:
+  PackedTensorFile() : map_(NULL), map_size_(0), num_records_(0) {}
+  ~PackedTensorFile() { Close(); }
+
+  void Open(const string& filename);
+  void Close();
+
+  inline uint64_t num_records() const { return num_records_; }
+  inline int num_tensors() const { return tensors_.size(); }
+  inline const PackedTensor& tensor(int i) const { return tensors_[i]; }
+  /// @brief The index of the tensor with that name, or -1.
+  int FindTensor(const string& name) const;
+
+  /// @brief The item of a tensor in a record; those of the next records
+  ///        follow it.
+  inline char* item(int tensor, uint64_t record) const {
+    return map_ + tensors_[tensor].offset + record * tensors_[tensor].item_size;
+  }
+  /// @brief Convert the item of a tensor in a record into data.
+  template <typename Dtype>
+  void Read(int tensor, uint64_t record, Dtype* data) const;
+  /// @brief Ask the kernel to read the items of count records ahead.
+  void WillNeed(int tensor, uint64_t record, uint64_t count) const;
+  /// @brief Release the pages of the items of count records, dropping any
+  ///        writes to them; they are read from the file again if accessed.
+  void DontNeed(int tensor, uint64_t record, uint64_t count) const;
+
+ private:
+  void Advise(int tensor, uint64_t record, uint64_t count, int advice) const;
+
+  vector<PackedTensor> tensors_;
+  char* map_;
+  size_t map_size_;
+  uint64_t num_records_;
+
+  DISABLE_COPY_AND_ASSIGN(PackedTensorFile);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PACKED_TENSOR_HPP_
@@ -0,0 +1,60 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of worker threads for splitting CPU work, such as the
+ *        images of a batch, into independent tasks.
+ *
+ * The thread calling Run() takes part in the work, so a pool of num_threads
+ * keeps num_threads - 1 workers, and Run() may be called from several threads
+ * at once or from within a task. CPU layers share the Global() pool; with a
+ * multithreaded BLAS, limit it to one thread (e.g. OPENBLAS_NUM_THREADS=1)
+ * to avoid oversubscribing the cores.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  /// @brief The number of threads that may run tasks at once.
+  int num_threads() const { return num_threads_; }
+
+  /**
+   * @brief Run task(i, slot) for every i in [0, num_tasks) and return once
+   *        all of them are done.
+   *
+   * slot is in [0, num_threads()) and differs between tasks running at the
+   * same time, so it can index per-thread scratch buffers.
+   */
+  void Run(int num_tasks, const boost::function<void(int, int)>& task);
+
+  /// @brief The process-wide pool, by default one thread per core.
+  static ThreadPool& Global();
+  /// @brief Global().num_threads() without locking, or 0 if Global() was
+  ///        never called.
+  static int GlobalThreads();
+  /// @brief Resize the global pool; 0 means one thread per core. Must not be
+  ///        called while the pool is running tasks.
+  static void SetGlobalThreads(int num_threads);
+
+ protected:
+  // Keeps boost/thread.hpp out of the header, as in BlockingQueue.
+  class sync;
+
+  void WorkerEntry();
+
+  int num_threads_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
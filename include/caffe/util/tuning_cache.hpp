@@ -0,0 +1,40 @@
+#ifndef CAFFE_UTIL_TUNING_CACHE_HPP_
+#define CAFFE_UTIL_TUNING_CACHE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A process-wide store of autotuning results, such as the fastest
+ *        convolution engine for a layer shape, optionally backed by a file.
+ *
+ * Entries are keyed by a string the tuner builds from what the result
+ * depends on, and by the CPU model, so one file can be shared by several
+ * machines. With a file set, the entries for this CPU are loaded from it and
+ * new ones are appended, so later processes skip the search. Without one the
+ * results only last for the process.
+ */
+class TuningCache {
+ public:
+  // The backing file; empty means none. Setting it drops the entries held
+  // so far and loads those of the file that match this CPU.
+  static string file();
+  static void set_file(const string& path);
+
+  // Returns whether key has an entry for this CPU, and if so sets *value.
+  static bool Lookup(const string& key, string* value);
+  // Adds or replaces the entry for key, and appends it to the file if any.
+  static void Insert(const string& key, const string& value);
+  // Drops the entries held in memory; the file is left as is.
+  static void Clear();
+
+  // The CPU model entries are recorded for, e.g. from /proc/cpuinfo.
+  static string CPUModel();
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_TUNING_CACHE_HPP_
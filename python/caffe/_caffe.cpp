@@ -18,6 +18,9 @@
 #include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/layers/python_layer.hpp"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/host_memory_pool.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/tuning_cache.hpp"
 
 // Temporary solution for numpy < 1.7 versions: old macro, no promises.
 // You're strongly advised to upgrade to >= 1.7.
@@ -261,6 +264,9 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::def("set_mode_cpu", &set_mode_cpu);
   bp::def("set_mode_gpu", &set_mode_gpu);
   bp::def("set_device", &Caffe::SetDevice);
+  bp::def("set_host_pool", &HostMemoryPool::set_enabled);
+  bp::def("set_cpu_threads", &ThreadPool::SetGlobalThreads);
+  bp::def("set_conv_tuning_cache", &TuningCache::set_file);
 
   bp::def("layer_type_list", &LayerRegistry<Dtype>::LayerTypeList);
 
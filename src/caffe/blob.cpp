@@ -146,6 +146,19 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareDataMemory(const shared_ptr<SyncedMemory>& data) {
+  CHECK(data);
+  CHECK_LE(count_ * sizeof(Dtype), data->size());
+  data_ = data;
+  capacity_ = count_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ReleaseData() {
+  data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
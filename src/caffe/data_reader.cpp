@@ -1,4 +1,8 @@
 #include <boost/thread.hpp>
+#include <stdint.h>
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
 #include <map>
 #include <string>
 #include <vector>
@@ -7,6 +11,9 @@
 #include "caffe/data_reader.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
@@ -44,12 +51,12 @@ DataReader::~DataReader() {
 DataReader::QueuePair::QueuePair(int size) {
   // Initialize the free queue with requested number of datums
   for (int i = 0; i < size; ++i) {
-    free_.push(new Datum());
+    free_.push(new MappedDatum());
   }
 }
 
 DataReader::QueuePair::~QueuePair() {
-  Datum* datum;
+  MappedDatum* datum;
   while (free_.try_pop(&datum)) {
     delete datum;
   }
@@ -60,9 +67,170 @@ DataReader::QueuePair::~QueuePair() {
 
 //
 
+// How often, in seconds of work, each of several readers logs its throughput.
+static const double kThroughputLogPeriod = 60;
+
+static void LogThroughput(int id, int num_readers, const char* when,
+    double read_seconds, double wait_seconds, int64_t items, double bytes) {
+  const double seconds = read_seconds + wait_seconds;
+  if (seconds <= 0) {
+    return;
+  }
+  LOG(INFO) << "Data reader " << id << "/" << num_readers << when << ": "
+      << items / seconds << " items/s, "
+      << bytes / seconds / (1 << 20) << " MB/s, "
+      << 100 * read_seconds / seconds << "% reading, "
+      << 100 * wait_seconds / seconds << "% waiting for the data layers";
+}
+
+DataReader::Reader::Reader(int id, int num_readers,
+    const DataParameter& param, shared_ptr<db::Cursor> cursor,
+    const string& begin, const string& end,
+    shared_ptr<const vector<string> > keys, unsigned int keys_seed)
+    : free_(), full_(), id_(id), num_readers_(num_readers),
+      shuffle_buffer_(param.shuffle_buffer()), cursor_(cursor),
+      begin_(begin), end_(end), keys_(keys), keys_seed_(keys_seed),
+      index_(0), epoch_(-1) {
+  // The shuffle buffer holds its datums on top of those queued.
+  for (int i = 0; i < param.batch_size() + shuffle_buffer_; ++i) {
+    free_.push(new MappedDatum());
+  }
+  Rewind();
+  StartInternalThread();
+}
+
+DataReader::Reader::~Reader() {
+  StopInternalThread();
+  MappedDatum* datum;
+  while (free_.try_pop(&datum)) {
+    delete datum;
+  }
+  while (full_.try_pop(&datum)) {
+    delete datum;
+  }
+}
+
+void DataReader::Reader::Rewind() {
+  if (keys_) {
+    index_ = id_;
+    Permute();
+    SeekKey();
+  } else if (begin_.empty()) {
+    cursor_->SeekToFirst();
+  } else {
+    cursor_->Seek(begin_);
+  }
+}
+
+void DataReader::Reader::Next() {
+  if (keys_) {
+    index_ += num_readers_;
+    if (index_ / static_cast<int64_t>(keys_->size()) != epoch_) {
+      Permute();
+    }
+    SeekKey();
+    return;
+  }
+  cursor_->Next();
+  if (!cursor_->valid() || (!end_.empty() && cursor_->key() >= end_)) {
+    DLOG(INFO) << "Restarting data prefetching from start.";
+    Rewind();
+  }
+}
+
+void DataReader::Reader::Permute() {
+  // Every reader draws the same permutation for an epoch, so that taking the
+  // readers in turn follows the permutation, whatever the number of keys
+  // left to each reader.
+  epoch_ = index_ / static_cast<int64_t>(keys_->size());
+  permutation_.resize(keys_->size());
+  for (int i = 0; i < permutation_.size(); ++i) {
+    permutation_[i] = i;
+  }
+  caffe::rng_t rng(keys_seed_ + epoch_);
+  shuffle(permutation_.begin(), permutation_.end(), &rng);
+}
+
+void DataReader::Reader::SeekKey() {
+  const int position = index_ % static_cast<int64_t>(keys_->size());
+  const string& key = (*keys_)[permutation_[position]];
+  cursor_->Seek(key);
+  CHECK(cursor_->valid() && cursor_->key() == key) << "Key " << key
+      << " of the key index is not in the source.";
+}
+
+void DataReader::Reader::InternalThreadEntry() {
+  CPUTimer timer;
+  double read_seconds = 0, wait_seconds = 0, bytes = 0;
+  int64_t items = 0;
+  double total_read_seconds = 0, total_wait_seconds = 0, total_bytes = 0;
+  int64_t total_items = 0;
+  vector<MappedDatum*> shuffle_buffer;
+  try {
+    while (!must_stop()) {
+      timer.Start();
+      MappedDatum* datum = free_.pop();
+      wait_seconds += timer.MilliSeconds() / 1000;
+      timer.Start();
+      // Deserialize in place: the data bytes are left in the database map if
+      // the cursor keeps it, and only the other fields are copied.
+      const char* value;
+      size_t size;
+      cursor_->value_data(&value, &size);
+      datum->Parse(value, size, cursor_->pins_values());
+      if (datum->is_mapped()) {
+        // Touch the pages of the data, so that they are read from disk here
+        // rather than by the threads transforming it.
+        volatile char touch = 0;
+        for (size_t i = 0; i < datum->data_size(); i += 4096) {
+          touch ^= datum->data()[i];
+        }
+      }
+      ++items;
+      bytes += size;
+
+      // go to the next iter
+      Next();
+      read_seconds += timer.MilliSeconds() / 1000;
+      if (shuffle_buffer_ > 0) {
+        // Output a datum drawn from the buffer, which the new one replaces.
+        if (static_cast<int>(shuffle_buffer.size()) < shuffle_buffer_) {
+          shuffle_buffer.push_back(datum);
+          continue;
+        }
+        std::swap(datum, shuffle_buffer[caffe_rng_rand() % shuffle_buffer_]);
+      }
+      full_.push(datum);
+
+      if (num_readers_ > 1 &&
+          read_seconds + wait_seconds >= kThroughputLogPeriod) {
+        LogThroughput(id_, num_readers_, "", read_seconds, wait_seconds,
+            items, bytes);
+        total_read_seconds += read_seconds;
+        total_wait_seconds += wait_seconds;
+        total_items += items;
+        total_bytes += bytes;
+        read_seconds = wait_seconds = bytes = 0;
+        items = 0;
+      }
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+  for (int i = 0; i < shuffle_buffer.size(); ++i) {
+    free_.push(shuffle_buffer[i]);
+  }
+  LogThroughput(id_, num_readers_, " in total",
+      total_read_seconds + read_seconds, total_wait_seconds + wait_seconds,
+      total_items + items, total_bytes + bytes);
+}
+
+//
+
 DataReader::Body::Body(const LayerParameter& param)
     : param_(param),
-      new_queue_pairs_() {
+      new_queue_pairs_(),
+      next_reader_(0) {
   StartInternalThread();
 }
 
@@ -71,9 +239,56 @@ DataReader::Body::~Body() {
 }
 
 void DataReader::Body::InternalThreadEntry() {
-  shared_ptr<db::DB> db(db::GetDB(param_.data_param().backend()));
-  db->Open(param_.data_param().source(), db::READ);
-  shared_ptr<db::Cursor> cursor(db->NewCursor());
+  db_.reset(db::GetDB(param_.data_param().backend()));
+  db_->Open(param_.data_param().source(), db::READ);
+  int num_readers = param_.data_param().reader_threads();
+  CHECK_GE(num_readers, 1) << "reader_threads must be positive.";
+  // The first key of each reader's range; the first reader starts from the
+  // beginning of the database.
+  vector<string> begins(1);
+  shared_ptr<vector<string> > keys;
+  unsigned int keys_seed = 0;
+  if (param_.data_param().has_key_index()) {
+    const string& key_index = param_.data_param().key_index();
+    std::ifstream file(key_index.c_str());
+    CHECK(file) << "Cannot open key index " << key_index;
+    keys.reset(new vector<string>());
+    string key;
+    while (std::getline(file, key)) {
+      keys->push_back(key);
+    }
+    CHECK(!keys->empty()) << "Empty key index " << key_index;
+    num_readers = std::min<int>(num_readers, keys->size());
+    begins.resize(num_readers);
+    keys_seed = caffe_rng_rand();
+    LOG(INFO) << "Reading the " << keys->size() << " keys of " << key_index
+        << " in a random order with " << num_readers << " readers.";
+  } else if (num_readers > 1) {
+    // Split the keys into contiguous ranges of the same size, which takes a
+    // pass over the database to count them.
+    shared_ptr<db::Cursor> cursor(db_->NewCursor());
+    int count = 0;
+    for (cursor->SeekToFirst(); cursor->valid(); cursor->Next()) {
+      ++count;
+    }
+    num_readers = std::max(std::min(num_readers, count), 1);
+    cursor->SeekToFirst();
+    for (int i = 0; static_cast<int>(begins.size()) < num_readers;
+        ++i, cursor->Next()) {
+      if (i == static_cast<int>(begins.size()) * count / num_readers) {
+        begins.push_back(cursor->key());
+      }
+    }
+    LOG(INFO) << "Reading " << count << " items of "
+        << param_.data_param().source() << " with " << num_readers
+        << " readers.";
+  }
+  for (int i = 0; i < num_readers; ++i) {
+    const string end = i + 1 < num_readers ? begins[i + 1] : string();
+    readers_.push_back(shared_ptr<Reader>(new Reader(i, num_readers,
+        param_.data_param(), shared_ptr<db::Cursor>(db_->NewCursor()),
+        begins[i], end, keys, keys_seed)));
+  }
   vector<shared_ptr<QueuePair> > qps;
   try {
     int solver_count = param_.phase() == TRAIN ? Caffe::solver_count() : 1;
@@ -83,13 +298,13 @@ void DataReader::Body::InternalThreadEntry() {
     // so read one item, then wait for the next solver.
     for (int i = 0; i < solver_count; ++i) {
       shared_ptr<QueuePair> qp(new_queue_pairs_.pop());
-      read_one(cursor.get(), qp.get());
+      read_one(qp.get());
       qps.push_back(qp);
     }
     // Main loop
     while (!must_stop()) {
       for (int i = 0; i < solver_count; ++i) {
-        read_one(cursor.get(), qps[i].get());
+        read_one(qps[i].get());
       }
       // Check no additional readers have been created. This can happen if
       // more than one net is trained at a time per process, whether single
@@ -102,18 +317,17 @@ void DataReader::Body::InternalThreadEntry() {
   }
 }
 
-void DataReader::Body::read_one(db::Cursor* cursor, QueuePair* qp) {
-  Datum* datum = qp->free_.pop();
-  // TODO deserialize in-place instead of copy?
-  datum->ParseFromString(cursor->value());
+void DataReader::Body::read_one(QueuePair* qp) {
+  // Take the readers' datums in turn, which keeps the order deterministic.
+  Reader* reader = readers_[next_reader_].get();
+  next_reader_ = (next_reader_ + 1) % readers_.size();
+  // Only peek while waiting, so that no datum is lost if interrupted.
+  MappedDatum* read = reader->full_.peek();
+  MappedDatum* datum = qp->free_.pop();
+  reader->full_.pop();
+  datum->Swap(read);
+  reader->free_.push(read);
   qp->full_.push(datum);
-
-  // go to the next iter
-  cursor->Next();
-  if (!cursor->valid()) {
-    DLOG(INFO) << "Restarting data prefetching from start.";
-    cursor->SeekToFirst();
-  }
 }
 
 }  // namespace caffe
@@ -1,6 +1,10 @@
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+#include <stdint.h>
 
 #include <string>
 #include <vector>
@@ -12,6 +16,64 @@
 
 namespace caffe {
 
+// Transform a row of width pixels: out[w] = (in[w] - mean) * scale, where
+// mean is mean_row[w] if given and mean_value otherwise, the row being
+// mirrored if kMirror. The choices are made once per row, not per pixel.
+template <bool kMirror, typename T, typename Dtype>
+static void TransformRow(const T* in, const Dtype* mean_row, Dtype mean_value,
+    Dtype scale, int width, Dtype* out) {
+  if (mean_row) {
+    for (int w = 0; w < width; ++w) {
+      out[kMirror ? width - 1 - w : w] =
+          (static_cast<Dtype>(in[w]) - mean_row[w]) * scale;
+    }
+  } else {
+    for (int w = 0; w < width; ++w) {
+      out[kMirror ? width - 1 - w : w] =
+          (static_cast<Dtype>(in[w]) - mean_value) * scale;
+    }
+  }
+}
+
+#ifdef __SSE2__
+// The common case of uint8 pixels transformed to float, 16 at a time: the
+// conversion is fused with the mean subtraction and the scaling.
+template <bool kMirror>
+static void TransformRow(const uint8_t* in, const float* mean_row,
+    float mean_value, float scale, int width, float* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scales = _mm_set1_ps(scale);
+  const __m128 mean_values = _mm_set1_ps(mean_value);
+  int w = 0;
+  for (; w + 16 <= width; w += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + w));
+    const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    __m128 pixels[4];
+    pixels[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+    pixels[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+    pixels[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+    pixels[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+    for (int k = 0; k < 4; ++k) {
+      const __m128 mean =
+          mean_row ? _mm_loadu_ps(mean_row + w + 4 * k) : mean_values;
+      const __m128 result =
+          _mm_mul_ps(_mm_sub_ps(pixels[k], mean), scales);
+      if (kMirror) {
+        _mm_storeu_ps(out + width - w - 4 * k - 4,
+            _mm_shuffle_ps(result, result, _MM_SHUFFLE(0, 1, 2, 3)));
+      } else {
+        _mm_storeu_ps(out + w + 4 * k, result);
+      }
+    }
+  }
+  // The remaining pixels go to the start of the row if it is mirrored.
+  TransformRow<kMirror, uint8_t, float>(in + w, mean_row ? mean_row + w : NULL,
+      mean_value, scale, width - w, kMirror ? out : out + w);
+}
+#endif  // __SSE2__
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -41,7 +103,13 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Dtype* transformed_data) {
-  const string& data = datum.data();
+  Transform(datum, datum.data().data(), datum.data().size(),
+      transformed_data);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum, const char* data,
+    size_t data_size, Dtype* transformed_data) {
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
   const int datum_width = datum.width();
@@ -50,19 +118,19 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
+  const bool has_uint8 = data_size > 0;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
   CHECK_GE(datum_width, crop_size);
 
-  Dtype* mean = NULL;
+  const Dtype* mean = NULL;
   if (has_mean_file) {
     CHECK_EQ(datum_channels, data_mean_.channels());
     CHECK_EQ(datum_height, data_mean_.height());
     CHECK_EQ(datum_width, data_mean_.width());
-    mean = data_mean_.mutable_cpu_data();
+    mean = data_mean_.cpu_data();
   }
   if (has_mean_values) {
     CHECK(mean_values_.size() == 1 || mean_values_.size() == datum_channels) <<
@@ -93,34 +161,27 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     }
   }
 
-  Dtype datum_element;
-  int top_index, data_index;
+  const uint8_t* pixels = reinterpret_cast<const uint8_t*>(data);
+  const float* float_data = datum.float_data().data();
   for (int c = 0; c < datum_channels; ++c) {
+    const Dtype mean_value = has_mean_values ? mean_values_[c] : Dtype(0);
     for (int h = 0; h < height; ++h) {
-      for (int w = 0; w < width; ++w) {
-        data_index = (c * datum_height + h_off + h) * datum_width + w_off + w;
-        if (do_mirror) {
-          top_index = (c * height + h) * width + (width - 1 - w);
-        } else {
-          top_index = (c * height + h) * width + w;
-        }
-        if (has_uint8) {
-          datum_element =
-            static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-        } else {
-          datum_element = datum.float_data(data_index);
-        }
-        if (has_mean_file) {
-          transformed_data[top_index] =
-            (datum_element - mean[data_index]) * scale;
-        } else {
-          if (has_mean_values) {
-            transformed_data[top_index] =
-              (datum_element - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = datum_element * scale;
-          }
-        }
+      const int data_index = (c * datum_height + h_off + h) * datum_width +
+          w_off;
+      const Dtype* mean_row = has_mean_file ? mean + data_index : NULL;
+      Dtype* top_row = transformed_data + (c * height + h) * width;
+      if (has_uint8 && do_mirror) {
+        TransformRow<true>(pixels + data_index, mean_row, mean_value, scale,
+            width, top_row);
+      } else if (has_uint8) {
+        TransformRow<false>(pixels + data_index, mean_row, mean_value, scale,
+            width, top_row);
+      } else if (do_mirror) {
+        TransformRow<true>(float_data + data_index, mean_row, mean_value,
+            scale, width, top_row);
+      } else {
+        TransformRow<false>(float_data + data_index, mean_row, mean_value,
+            scale, width, top_row);
       }
     }
   }
@@ -135,24 +196,59 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
 #ifdef USE_OPENCV
     CHECK(!(param_.force_color() && param_.force_gray()))
         << "cannot set both force_color and force_gray";
+    const int decode_size = param_.scaled_decode() ? param_.crop_size() : 0;
     cv::Mat cv_img;
     if (param_.force_color() || param_.force_gray()) {
     // If force_color then decode in color otherwise decode in gray.
-      cv_img = DecodeDatumToCVMat(datum, param_.force_color());
+      cv_img = DecodeDatumToCVMat(datum, param_.force_color(),
+          decode_size, decode_size);
     } else {
-      cv_img = DecodeDatumToCVMatNative(datum);
+      cv_img = DecodeDatumToCVMatNative(datum, decode_size, decode_size);
     }
     // Transform the cv::image into blob.
     return Transform(cv_img, transformed_blob);
 #else
     LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
-  } else {
+  }
+  Transform(datum, datum.data().data(), datum.data().size(),
+      transformed_blob);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const MappedDatum& datum,
+                                       Blob<Dtype>* transformed_blob) {
+  if (!datum.is_mapped()) {
+    return Transform(datum.datum(), transformed_blob);
+  }
+  // If datum is encoded, decode the bytes in place and transform the image.
+  if (datum.datum().encoded()) {
+#ifdef USE_OPENCV
+    CHECK(!(param_.force_color() && param_.force_gray()))
+        << "cannot set both force_color and force_gray";
+    const int decode_size = param_.scaled_decode() ? param_.crop_size() : 0;
+    cv::Mat cv_img;
     if (param_.force_color() || param_.force_gray()) {
-      LOG(ERROR) << "force_color and force_gray only for encoded datum";
+      cv_img = DecodeDatumToCVMat(datum, param_.force_color(),
+          decode_size, decode_size);
+    } else {
+      cv_img = DecodeDatumToCVMatNative(datum, decode_size, decode_size);
     }
+    return Transform(cv_img, transformed_blob);
+#else
+    LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
   }
+  Transform(datum.datum(), datum.data(), datum.data_size(),
+      transformed_blob);
+}
 
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const Datum& datum, const char* data,
+    size_t data_size, Blob<Dtype>* transformed_blob) {
+  if (param_.force_color() || param_.force_gray()) {
+    LOG(ERROR) << "force_color and force_gray only for encoded datum";
+  }
   const int crop_size = param_.crop_size();
   const int datum_channels = datum.channels();
   const int datum_height = datum.height();
@@ -178,7 +274,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   }
 
   Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  Transform(datum, transformed_data);
+  Transform(datum, data, data_size, transformed_data);
 }
 
 template<typename Dtype>
@@ -444,12 +540,14 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
 #ifdef USE_OPENCV
     CHECK(!(param_.force_color() && param_.force_gray()))
         << "cannot set both force_color and force_gray";
+    const int decode_size = param_.scaled_decode() ? param_.crop_size() : 0;
     cv::Mat cv_img;
     if (param_.force_color() || param_.force_gray()) {
     // If force_color then decode in color otherwise decode in gray.
-      cv_img = DecodeDatumToCVMat(datum, param_.force_color());
+      cv_img = DecodeDatumToCVMat(datum, param_.force_color(),
+          decode_size, decode_size);
     } else {
-      cv_img = DecodeDatumToCVMatNative(datum);
+      cv_img = DecodeDatumToCVMatNative(datum, decode_size, decode_size);
     }
     // InferBlobShape using the cv::image.
     return InferBlobShape(cv_img);
@@ -474,6 +572,28 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
   return shape;
 }
 
+template<typename Dtype>
+vector<int> DataTransformer<Dtype>::InferBlobShape(const MappedDatum& datum) {
+  if (datum.is_mapped() && datum.datum().encoded()) {
+#ifdef USE_OPENCV
+    CHECK(!(param_.force_color() && param_.force_gray()))
+        << "cannot set both force_color and force_gray";
+    const int decode_size = param_.scaled_decode() ? param_.crop_size() : 0;
+    cv::Mat cv_img;
+    if (param_.force_color() || param_.force_gray()) {
+      cv_img = DecodeDatumToCVMat(datum, param_.force_color(),
+          decode_size, decode_size);
+    } else {
+      cv_img = DecodeDatumToCVMatNative(datum, decode_size, decode_size);
+    }
+    return InferBlobShape(cv_img);
+#else
+    LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  }
+  return InferBlobShape(datum.datum());
+}
+
 template<typename Dtype>
 vector<int> DataTransformer<Dtype>::InferBlobShape(
     const vector<Datum> & datum_vector) {
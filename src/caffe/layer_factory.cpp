@@ -3,17 +3,25 @@
 #ifdef WITH_PYTHON_LAYER
 #include <boost/python.hpp>
 #endif
+#include <algorithm>
 #include <string>
 
 #include "caffe/layer.hpp"
 #include "caffe/layer_factory.hpp"
+#include "caffe/layers/autotuned_conv_layer.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/deconv_layer.hpp"
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/layers/fft_conv_layer.hpp"
+#include "caffe/layers/fft_deconv_layer.hpp"
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/layers/relu_layer.hpp"
 #include "caffe/layers/sigmoid_layer.hpp"
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/layers/threaded_conv_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #ifdef USE_CUDNN
@@ -33,6 +41,18 @@
 
 namespace caffe {
 
+// Kernels at least this large go to the FFT engine by default, which then
+// uses its cost model to choose between FFT and GEMM.
+static const int kFFTMinKernelSize = 7;
+
+static bool HasLargeKernel(const ConvolutionParameter& conv_param) {
+  int kernel_size = std::max(conv_param.kernel_h(), conv_param.kernel_w());
+  for (int i = 0; i < conv_param.kernel_size_size(); ++i) {
+    kernel_size = std::max<int>(kernel_size, conv_param.kernel_size(i));
+  }
+  return kernel_size >= kFFTMinKernelSize;
+}
+
 // Get convolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetConvolutionLayer(
@@ -54,9 +74,27 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
       engine = ConvolutionParameter_Engine_CUDNN;
     }
 #endif
+    if (engine == ConvolutionParameter_Engine_CAFFE &&
+        HasLargeKernel(conv_param)) {
+      // The layer still sees engine DEFAULT and applies its cost model.
+      return shared_ptr<Layer<Dtype> >(new FFTConvolutionLayer<Dtype>(param));
+    }
   }
   if (engine == ConvolutionParameter_Engine_CAFFE) {
     return shared_ptr<Layer<Dtype> >(new ConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_THREADED) {
+    return shared_ptr<Layer<Dtype> >(
+        new ThreadedConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_DIRECT) {
+    return shared_ptr<Layer<Dtype> >(new DirectConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_WINOGRAD) {
+    return shared_ptr<Layer<Dtype> >(
+        new WinogradConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_FFT) {
+    return shared_ptr<Layer<Dtype> >(new FFTConvolutionLayer<Dtype>(param));
+  } else if (engine == ConvolutionParameter_Engine_AUTOTUNE) {
+    return shared_ptr<Layer<Dtype> >(
+        new AutotunedConvolutionLayer<Dtype>(param));
 #ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
     if (use_dilation) {
@@ -72,6 +110,22 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
 
 REGISTER_LAYER_CREATOR(Convolution, GetConvolutionLayer);
 
+// Get deconvolution layer according to engine.
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > GetDeconvolutionLayer(
+    const LayerParameter& param) {
+  const ConvolutionParameter& conv_param = param.convolution_param();
+  ConvolutionParameter_Engine engine = conv_param.engine();
+  if (engine == ConvolutionParameter_Engine_FFT ||
+      (engine == ConvolutionParameter_Engine_DEFAULT &&
+       HasLargeKernel(conv_param))) {
+    return shared_ptr<Layer<Dtype> >(new FFTDeconvolutionLayer<Dtype>(param));
+  }
+  return shared_ptr<Layer<Dtype> >(new DeconvolutionLayer<Dtype>(param));
+}
+
+REGISTER_LAYER_CREATOR(Deconvolution, GetDeconvolutionLayer);
+
 // Get pooling layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetPoolingLayer(const LayerParameter& param) {
@@ -0,0 +1,211 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/autotuned_conv_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/tuning_cache.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Timed runs per engine, after one warm-up run; the fastest one counts.
+const int kTuningRuns = 3;
+
+void AppendShape(const char* name, const int* data, int count,
+    std::ostringstream* key) {
+  *key << ' ' << name << '=';
+  for (int i = 0; i < count; ++i) {
+    *key << (i ? "," : "") << data[i];
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void AutotunedConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // The rest of the key is fixed, so the engine only changes with these.
+  if (bottom[0]->shape() == tuned_shape_ &&
+      ThreadPool::GlobalThreads() == tuned_threads_) {
+    return;
+  }
+  const string key = TuningKey(bottom[0]->shape());
+  tuned_shape_ = bottom[0]->shape();
+  tuned_threads_ = ThreadPool::GlobalThreads();
+  if (key == tuned_key_) {
+    return;
+  }
+  ConvolutionParameter_Engine engine;
+  string engine_name;
+  if (!TuningCache::Lookup(key, &engine_name) ||
+      !ConvolutionParameter_Engine_Parse(engine_name, &engine)) {
+    engine = Tune(bottom[0]->shape());
+    TuningCache::Insert(key, ConvolutionParameter_Engine_Name(engine));
+  }
+  LOG(INFO) << "Layer " << this->layer_param_.name() << " uses engine "
+      << ConvolutionParameter_Engine_Name(engine);
+  if (engine == ConvolutionParameter_Engine_CAFFE) {
+    selected_.reset();
+  } else if (!selected_ || engine != selected_engine_) {
+    selected_ = CreateEngineLayer(engine);
+    // Sharing the blobs makes the layer skip parameter initialization.
+    selected_->blobs() = this->blobs_;
+    static_cast<BaseConvolutionLayer<Dtype>*>(selected_.get())->
+        set_fused_relu(this->fused_relu_, this->relu_negative_slope_);
+    selected_->SetUp(bottom, top);
+  }
+  selected_engine_ = engine;
+  tuned_key_ = key;
+}
+
+template <typename Dtype>
+void AutotunedConvolutionLayer<Dtype>::set_fused_relu(bool fused_relu,
+    Dtype negative_slope) {
+  ConvolutionLayer<Dtype>::set_fused_relu(fused_relu, negative_slope);
+  if (selected_) {
+    static_cast<BaseConvolutionLayer<Dtype>*>(selected_.get())->
+        set_fused_relu(fused_relu, negative_slope);
+  }
+}
+
+template <typename Dtype>
+string AutotunedConvolutionLayer<Dtype>::TuningKey(
+    const vector<int>& bottom_shape) const {
+  std::ostringstream key;
+  key << "Convolution"
+      << (sizeof(Dtype) == sizeof(float) ? " float" : " double")
+      << (this->phase_ == TRAIN ? " TRAIN" : " TEST")
+      << " threads=" << ThreadPool::Global().num_threads();
+  AppendShape("bottom", bottom_shape.data(), bottom_shape.size(), &key);
+  const int axes = this->num_spatial_axes_;
+  AppendShape("kernel", this->kernel_shape_.cpu_data(), axes, &key);
+  AppendShape("stride", this->stride_.cpu_data(), axes, &key);
+  AppendShape("pad", this->pad_.cpu_data(), axes, &key);
+  AppendShape("dilation", this->dilation_.cpu_data(), axes, &key);
+  const ConvolutionParameter& conv_param =
+      this->layer_param_.convolution_param();
+  key << " output=" << this->num_output_ << " group=" << this->group_
+      << " axis=" << conv_param.axis() << " bias=" << this->bias_term_
+      << " force_nd=" << this->force_nd_im2col_
+      << " winograd_tile=" << conv_param.winograd_tile();
+  return key.str();
+}
+
+template <typename Dtype>
+vector<ConvolutionParameter_Engine>
+AutotunedConvolutionLayer<Dtype>::Candidates() const {
+  vector<ConvolutionParameter_Engine> engines(1,
+      ConvolutionParameter_Engine_CAFFE);
+  if (ThreadPool::Global().num_threads() > 1 && this->num_ > 1) {
+    engines.push_back(ConvolutionParameter_Engine_THREADED);
+  }
+  if (this->num_spatial_axes_ != 2 || this->force_nd_im2col_) {
+    return engines;
+  }
+  const int* kernel = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  if (dilation[0] == 1 && dilation[1] == 1) {
+    engines.push_back(ConvolutionParameter_Engine_DIRECT);
+    if (kernel[0] == 3 && kernel[1] == 3 && stride[0] == 1 &&
+        stride[1] == 1) {
+      engines.push_back(ConvolutionParameter_Engine_WINOGRAD);
+    }
+  }
+  engines.push_back(ConvolutionParameter_Engine_FFT);
+  return engines;
+}
+
+template <typename Dtype>
+ConvolutionParameter_Engine AutotunedConvolutionLayer<Dtype>::Tune(
+    const vector<int>& bottom_shape) {
+  Blob<Dtype> bottom(bottom_shape);
+  Blob<Dtype> top;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  const vector<bool> propagate_down(1, true);
+  const vector<ConvolutionParameter_Engine> engines = Candidates();
+  ConvolutionParameter_Engine best_engine = engines[0];
+  float best_time = 0;
+  CPUTimer timer;
+  for (int i = 0; i < engines.size(); ++i) {
+    shared_ptr<Layer<Dtype> > layer = CreateEngineLayer(engines[i]);
+    // Copies of the weights keep the timed backward passes from touching
+    // this layer's gradients.
+    for (int j = 0; j < this->blobs_.size(); ++j) {
+      layer->blobs().push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      layer->blobs()[j]->CopyFrom(*this->blobs_[j], false, true);
+    }
+    layer->SetUp(bottom_vec, top_vec);
+    caffe_set(top.count(), Dtype(1), top.mutable_cpu_diff());
+    float time = 0;
+    // Run 0 is a warm-up.
+    for (int run = 0; run <= kTuningRuns; ++run) {
+      timer.Start();
+      layer->Forward(bottom_vec, top_vec);
+      if (this->phase_ == TRAIN) {
+        layer->Backward(top_vec, propagate_down, bottom_vec);
+      }
+      timer.Stop();
+      if (run == 1 || (run > 1 && timer.MicroSeconds() < time)) {
+        time = timer.MicroSeconds();
+      }
+    }
+    LOG(INFO) << "Layer " << this->layer_param_.name() << " engine "
+        << ConvolutionParameter_Engine_Name(engines[i]) << ": "
+        << time / 1000 << " ms";
+    if (i == 0 || time < best_time) {
+      best_engine = engines[i];
+      best_time = time;
+    }
+  }
+  return best_engine;
+}
+
+template <typename Dtype>
+shared_ptr<Layer<Dtype> > AutotunedConvolutionLayer<Dtype>::CreateEngineLayer(
+    ConvolutionParameter_Engine engine) const {
+  LayerParameter param(this->layer_param_);
+  param.mutable_convolution_param()->set_engine(engine);
+  return LayerRegistry<Dtype>::CreateLayer(param);
+}
+
+template <typename Dtype>
+void AutotunedConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!selected_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  selected_->Forward(bottom, top);
+}
+
+template <typename Dtype>
+void AutotunedConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!selected_) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  for (int i = 0; i < this->blobs_.size(); ++i) {
+    selected_->set_param_propagate_down(i, this->param_propagate_down(i));
+  }
+  selected_->Backward(top, propagate_down, bottom);
+}
+
+INSTANTIATE_CLASS(AutotunedConvolutionLayer);
+
+}  // namespace caffe
@@ -196,6 +196,7 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK(bottom[0]->shape() == bottom[bottom_id]->shape())
         << "All inputs must have the same shape.";
   }
+  CHECK(!fused_relu_ || bias_term_) << "A fused ReLU needs a bias term.";
   // Shape the tops.
   bottom_shape_ = &bottom[0]->shape();
   compute_output_shape();
@@ -256,12 +257,20 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
+  forward_cpu_gemm(input, weights, output,
+      is_1x1_ ? NULL : col_buffer_.mutable_cpu_data(), skip_im2col);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
+    const Dtype* weights, Dtype* output, Dtype* col_buffer,
+    bool skip_im2col) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      conv_im2col_cpu(input, col_buffer);
     }
-    col_buff = col_buffer_.cpu_data();
+    col_buff = col_buffer;
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
@@ -274,15 +283,32 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
-      out_spatial_dim_, 1, (Dtype)1., bias, bias_multiplier_.cpu_data(),
-      (Dtype)1., output);
+  if (!fused_relu_) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
+        out_spatial_dim_, 1, (Dtype)1., bias, bias_multiplier_.cpu_data(),
+        (Dtype)1., output);
+    return;
+  }
+  // One pass adding the bias and applying the ReLU.
+  for (int o = 0; o < num_output_; ++o) {
+    Dtype* channel = output + o * out_spatial_dim_;
+    for (int i = 0; i < out_spatial_dim_; ++i) {
+      channel[i] = fused_relu(channel[i] + bias[o]);
+    }
+  }
 }
 
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
+  backward_cpu_gemm(output, weights, input,
+      is_1x1_ ? NULL : col_buffer_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
+    const Dtype* weights, Dtype* input, Dtype* col_buffer) {
+  Dtype* col_buff = col_buffer;
   if (is_1x1_) {
     col_buff = input;
   }
@@ -300,10 +326,17 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
+  weight_cpu_gemm(input, output, weights,
+      is_1x1_ ? NULL : col_buffer_.mutable_cpu_data());
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
+    const Dtype* output, Dtype* weights, Dtype* col_buffer) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
-    col_buff = col_buffer_.cpu_data();
+    conv_im2col_cpu(input, col_buffer);
+    col_buff = col_buffer;
   }
   for (int g = 0; g < group_; ++g) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, conv_out_channels_ / group_,
@@ -1,4 +1,8 @@
 #include <boost/thread.hpp>
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <limits>
+#include <string>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -7,6 +11,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
 namespace caffe {
@@ -36,9 +41,15 @@ template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_free_.push(&prefetch_[i]);
+      prefetch_(param.has_data_param() ? param.data_param().prefetch() :
+          PREFETCH_COUNT),
+      prefetch_free_(), prefetch_full_(), held_(NULL), held_count_(0),
+      waited_(false), available_memory_(0), batches_since_memory_check_(0),
+      prefetch_wait_time_(0), prefetch_waits_(0) {
+  CHECK_GT(prefetch_.size(), 0) << "prefetch must be positive.";
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i].reset(new Batch<Dtype>());
+    prefetch_free_.push(prefetch_[i].get());
   }
 }
 
@@ -50,18 +61,18 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
   // calls so that the prefetch thread does not accidentally make simultaneous
   // cudaMalloc calls when the main thread is running. In some GPUs this
   // seems to cause failures if we do not so.
-  for (int i = 0; i < PREFETCH_COUNT; ++i) {
-    prefetch_[i].data_.mutable_cpu_data();
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i]->data_.mutable_cpu_data();
     if (this->output_labels_) {
-      prefetch_[i].label_.mutable_cpu_data();
+      prefetch_[i]->label_.mutable_cpu_data();
     }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
-    for (int i = 0; i < PREFETCH_COUNT; ++i) {
-      prefetch_[i].data_.mutable_gpu_data();
+    for (int i = 0; i < prefetch_.size(); ++i) {
+      prefetch_[i]->data_.mutable_gpu_data();
       if (this->output_labels_) {
-        prefetch_[i].label_.mutable_gpu_data();
+        prefetch_[i]->label_.mutable_gpu_data();
       }
     }
   }
@@ -103,25 +114,124 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+template <typename Dtype>
+Batch<Dtype>* BasePrefetchingDataLayer<Dtype>::NextBatch() {
+  Batch<Dtype>* batch;
+  waited_ = !prefetch_full_.try_pop(&batch);
+  if (waited_) {
+    CPUTimer timer;
+    timer.Start();
+    batch = prefetch_full_.pop("Data layer prefetch queue empty");
+    prefetch_wait_time_ += timer.MilliSeconds();
+    ++prefetch_waits_;
+  }
+  return batch;
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::RecycleBatch(Batch<Dtype>* batch) {
+  const DataParameter& param = this->layer_param_.data_param();
+  const size_t min_count = param.prefetch();
+  const size_t max_count = param.max_prefetch();
+  if (max_count > min_count) {
+    const size_t reserve = size_t(param.min_free_memory_mb()) << 20;
+    const size_t batch_size =
+        (batch->data_.count() + batch->label_.count()) * sizeof(Dtype);
+    // Reading /proc/meminfo on every Forward would cost more than the
+    // batches it sizes change.
+    if (batches_since_memory_check_ == 0) {
+      available_memory_ = available_memory();
+    }
+    batches_since_memory_check_ =
+        (batches_since_memory_check_ + 1) % MEMORY_CHECK_INTERVAL;
+    const size_t available = available_memory_;
+    if (available < reserve && prefetch_count() > min_count) {
+      // Drop the batch to give its memory back.
+      for (int i = 0; i < prefetch_.size(); ++i) {
+        if (prefetch_[i].get() == batch) {
+          prefetch_.erase(prefetch_.begin() + i);
+          break;
+        }
+      }
+      LOG(INFO) << this->layer_param_.name() << " prefetches "
+          << prefetch_count() << " batches, as memory runs low.";
+      return;
+    }
+    if (waited_ && prefetch_count() < max_count &&
+        available - std::min(available, reserve) > 2 * batch_size) {
+      AddBatch(*batch);
+      LOG(INFO) << this->layer_param_.name() << " prefetches "
+          << prefetch_count() << " batches, after waiting "
+          << prefetch_wait_time_ << " ms over " << prefetch_waits_
+          << " batches.";
+    }
+  }
+  prefetch_free_.push(batch);
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::AddBatch(const Batch<Dtype>& like) {
+  shared_ptr<Batch<Dtype> > added(new Batch<Dtype>());
+  added->data_.ReshapeLike(like.data_);
+  added->data_.mutable_cpu_data();
+  if (this->output_labels_) {
+    added->label_.ReshapeLike(like.label_);
+    added->label_.mutable_cpu_data();
+  }
+#ifndef CPU_ONLY
+  if (Caffe::mode() == Caffe::GPU) {
+    added->data_.mutable_gpu_data();
+    if (this->output_labels_) {
+      added->label_.mutable_gpu_data();
+    }
+  }
+#endif
+  prefetch_.push_back(added);
+  prefetch_free_.push(added.get());
+}
+
+template <typename Dtype>
+size_t BasePrefetchingDataLayer<Dtype>::available_memory() const {
+  // Linux reports the memory that can be allocated without swapping, page
+  // cache included; elsewhere, never report memory pressure.
+  std::ifstream meminfo("/proc/meminfo");
+  string name;
+  size_t kilobytes;
+  while (meminfo >> name >> kilobytes) {
+    if (name == "MemAvailable:") {
+      return kilobytes << 10;
+    }
+    meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  return std::numeric_limits<size_t>::max();
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  // The tops are done with the batch they shared, which can be loaded again.
+  if (held_) {
+    Batch<Dtype>* previous = held_;
+    held_ = NULL;
+    RecycleBatch(previous);
+  }
+  Batch<Dtype>* batch = NextBatch();
+  if (!held_count_) {
+    AddBatch(*batch);
+    held_count_ = 1;
+  }
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
-  // Copy the data
-  caffe_copy(batch->data_.count(), batch->data_.cpu_data(),
-             top[0]->mutable_cpu_data());
-  DLOG(INFO) << "Prefetch copied";
+  // Share the data, which is not loaded over until the next Forward.
+  top[0]->ShareDataMemory(batch->data_.data());
+  DLOG(INFO) << "Prefetch shared";
   if (this->output_labels_) {
     // Reshape to loaded labels.
     top[1]->ReshapeLike(batch->label_);
-    // Copy the labels.
-    caffe_copy(batch->label_.count(), batch->label_.cpu_data(),
-        top[1]->mutable_cpu_data());
+    // Share the labels.
+    top[1]->ShareDataMemory(batch->label_.data());
   }
-
-  prefetch_free_.push(batch);
+  held_ = batch;
 }
 
 #ifdef CPU_ONLY
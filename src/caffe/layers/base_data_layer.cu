@@ -7,7 +7,18 @@ namespace caffe {
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-  Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
+  // Coming from CPU mode, the tops get memory of their own again before the
+  // batch they shared is loaded over.
+  if (held_) {
+    top[0]->ReleaseData();
+    if (this->output_labels_) {
+      top[1]->ReleaseData();
+    }
+    Batch<Dtype>* previous = held_;
+    held_ = NULL;
+    RecycleBatch(previous);
+  }
+  Batch<Dtype>* batch = NextBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(batch->data_);
   // Copy the data
@@ -23,7 +34,7 @@ void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
   // Ensure the copy is synchronous wrt the host, so that the next batch isn't
   // copied in meanwhile.
   CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
-  prefetch_free_.push(batch);
+  RecycleBatch(batch);
 }
 
 INSTANTIATE_LAYER_GPU_FORWARD(BasePrefetchingDataLayer);
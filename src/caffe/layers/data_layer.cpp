@@ -3,6 +3,7 @@
 #endif  // USE_OPENCV
 #include <stdint.h>
 
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
@@ -26,8 +27,21 @@ template <typename Dtype>
 void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.data_param().batch_size();
+  const int transform_threads =
+      this->layer_param_.data_param().transform_threads();
+  CHECK_GE(transform_threads, 1) << "transform_threads must be positive.";
+  transformers_.clear();
+  transformers_.push_back(this->data_transformer_);
+  for (int i = 1; i < transform_threads; ++i) {
+    transformers_.push_back(shared_ptr<DataTransformer<Dtype> >(
+        new DataTransformer<Dtype>(this->transform_param_, this->phase_)));
+    transformers_.back()->InitRand();
+  }
+  if (transform_threads > 1) {
+    transform_pool_.reset(new ThreadPool(transform_threads));
+  }
   // Read a data point, and use it to initialize the top blob.
-  Datum& datum = *(reader_.full().peek());
+  MappedDatum& datum = *(reader_.full().peek());
 
   // Use data_transformer to infer the expected blob shape from datum.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
@@ -35,8 +49,8 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Reshape top[0] and prefetch_data according to the batch_size.
   top_shape[0] = batch_size;
   top[0]->Reshape(top_shape);
-  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-    this->prefetch_[i].data_.Reshape(top_shape);
+  for (int i = 0; i < this->prefetch_.size(); ++i) {
+    this->prefetch_[i]->data_.Reshape(top_shape);
   }
   LOG(INFO) << "output data size: " << top[0]->num() << ","
       << top[0]->channels() << "," << top[0]->height() << ","
@@ -45,8 +59,8 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   if (this->output_labels_) {
     vector<int> label_shape(1, batch_size);
     top[1]->Reshape(label_shape);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-      this->prefetch_[i].label_.Reshape(label_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->label_.Reshape(label_shape);
     }
   }
 }
@@ -65,7 +79,7 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   // Reshape according to the first datum of each batch
   // on single input batches allows for inputs of varying dimension.
   const int batch_size = this->layer_param_.data_param().batch_size();
-  Datum& datum = *(reader_.full().peek());
+  MappedDatum& datum = *(reader_.full().peek());
   // Use data_transformer to infer the expected blob shape from datum.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
   this->transformed_data_.Reshape(top_shape);
@@ -73,29 +87,30 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   top_shape[0] = batch_size;
   batch->data_.Reshape(top_shape);
 
+  // Take the datums of the batch in order first, so that each item gets the
+  // same datum whatever the number of transform threads.
+  vector<MappedDatum*> datums(batch_size);
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    timer.Start();
+    datums[item_id] = reader_.full().pop("Waiting for data");
+    read_time += timer.MicroSeconds();
+  }
+  timer.Start();
   Dtype* top_data = batch->data_.mutable_cpu_data();
   Dtype* top_label = NULL;  // suppress warnings about uninitialized variables
-
   if (this->output_labels_) {
     top_label = batch->label_.mutable_cpu_data();
   }
+  if (transform_pool_) {
+    transform_pool_->Run(transformers_.size(), boost::bind(
+        &DataLayer<Dtype>::TransformStream, this, boost::cref(*batch),
+        boost::cref(datums), top_data, top_label, _1));
+  } else {
+    TransformStream(*batch, datums, top_data, top_label, 0);
+  }
+  trans_time += timer.MicroSeconds();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    timer.Start();
-    // get a datum
-    Datum& datum = *(reader_.full().pop("Waiting for data"));
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply data transformations (mirror, scale, crop...)
-    int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
-    // Copy label.
-    if (this->output_labels_) {
-      top_label[item_id] = datum.label();
-    }
-    trans_time += timer.MicroSeconds();
-
-    reader_.free().push(const_cast<Datum*>(&datum));
+    reader_.free().push(datums[item_id]);
   }
   timer.Stop();
   batch_timer.Stop();
@@ -104,6 +119,28 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
 }
 
+// Called on the transform threads, each with its own stream of the batch and
+// its own transformer, hence its own random numbers.
+template<typename Dtype>
+void DataLayer<Dtype>::TransformStream(const Batch<Dtype>& batch,
+    const vector<MappedDatum*>& datums, Dtype* top_data, Dtype* top_label,
+    int stream) {
+  DataTransformer<Dtype>* transformer = transformers_[stream].get();
+  Blob<Dtype> transformed_data(this->transformed_data_.shape());
+  for (int item_id = stream; item_id < datums.size();
+      item_id += transformers_.size()) {
+    const MappedDatum& datum = *datums[item_id];
+    // Apply data transformations (mirror, scale, crop...)
+    int offset = batch.data_.offset(item_id);
+    transformed_data.set_cpu_data(top_data + offset);
+    transformer->Transform(datum, &transformed_data);
+    // Copy label.
+    if (this->output_labels_) {
+      top_label[item_id] = datum.datum().label();
+    }
+  }
+}
+
 INSTANTIATE_CLASS(DataLayer);
 REGISTER_LAYER_CLASS(Data);
 
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+const int DirectConvolutionLayer<Dtype>::kBlock;
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  use_direct_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  const int* dilation_data = this->dilation_.cpu_data();
+  for (int i = 0; i < this->num_spatial_axes_; ++i) {
+    use_direct_ &= dilation_data[i] == 1;
+  }
+  if (!use_direct_) {
+    return;
+  }
+  const int out_per_group = this->num_output_ / this->group_;
+  const int in_per_group = this->channels_ / this->group_;
+  const int* kernel_shape_data = this->kernel_shape_.cpu_data();
+  out_blocks_ = (out_per_group + kBlock - 1) / kBlock;
+  vector<int> packed_shape(1, this->group_ * out_blocks_ * in_per_group *
+      kernel_shape_data[0] * kernel_shape_data[1] * kBlock);
+  if (packed_weights_.count() != packed_shape[0]) {
+    weight_tracker_.Reset();
+  }
+  packed_weights_.Reshape(packed_shape);
+  vector<int> row_shape(1, this->output_shape_[1] * kBlock);
+  row_buffer_.Reshape(row_shape);
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::PackWeights() {
+  if (!weight_tracker_.Changed(*this->blobs_[0])) {
+    return;
+  }
+  const int out_per_group = this->num_output_ / this->group_;
+  const int in_per_group = this->channels_ / this->group_;
+  const int kernel_dim = in_per_group * this->kernel_shape_.cpu_data()[0] *
+      this->kernel_shape_.cpu_data()[1];
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  Dtype* packed = packed_weights_.mutable_cpu_data();
+  // The weights are (num_output, in_per_group, kh, kw); the padding channels
+  // of a partial last block get zero weights.
+  caffe_set(packed_weights_.count(), Dtype(0), packed);
+  for (int g = 0; g < this->group_; ++g) {
+    for (int o = 0; o < out_per_group; ++o) {
+      const Dtype* src = weight + (g * out_per_group + o) * kernel_dim;
+      Dtype* dst = packed + ((g * out_blocks_ + o / kBlock) * kernel_dim) *
+          kBlock + o % kBlock;
+      for (int k = 0; k < kernel_dim; ++k) {
+        dst[k * kBlock] = src[k];
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::ForwardImage(const Dtype* input,
+    Dtype* output) {
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int kernel_h = this->kernel_shape_.cpu_data()[0];
+  const int kernel_w = this->kernel_shape_.cpu_data()[1];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int stride_h = this->stride_.cpu_data()[0];
+  const int stride_w = this->stride_.cpu_data()[1];
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int out_per_group = this->num_output_ / this->group_;
+  const int in_per_group = this->channels_ / this->group_;
+  const int kernel_dim = in_per_group * kernel_h * kernel_w;
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  // The range of output columns that read inside the input for each kw.
+  vector<int> ow_begin(kernel_w), ow_end(kernel_w);
+  for (int kw = 0; kw < kernel_w; ++kw) {
+    const int offset = pad_w - kw;
+    ow_begin[kw] = offset > 0 ? (offset + stride_w - 1) / stride_w : 0;
+    ow_end[kw] = width - 1 + offset >= 0 ?
+        std::min(output_w, (width - 1 + offset) / stride_w + 1) : 0;
+  }
+  Dtype* acc = row_buffer_.mutable_cpu_data();
+  for (int g = 0; g < this->group_; ++g) {
+    const Dtype* group_input = input + g * in_per_group * height * width;
+    for (int ob = 0; ob < out_blocks_; ++ob) {
+      const Dtype* block_weights = packed_weights_.cpu_data() +
+          (g * out_blocks_ + ob) * kernel_dim * kBlock;
+      const int o_begin = g * out_per_group + ob * kBlock;
+      const int o_count = std::min(kBlock, out_per_group - ob * kBlock);
+      for (int oh = 0; oh < output_h; ++oh) {
+        caffe_set(output_w * kBlock, Dtype(0), acc);
+        for (int c = 0; c < in_per_group; ++c) {
+          const Dtype* channel = group_input + c * height * width;
+          for (int kh = 0; kh < kernel_h; ++kh) {
+            const int ih = oh * stride_h - pad_h + kh;
+            if (ih < 0 || ih >= height) {
+              continue;
+            }
+            const Dtype* row = channel + ih * width;
+            for (int kw = 0; kw < kernel_w; ++kw) {
+              const Dtype* w = block_weights +
+                  ((c * kernel_h + kh) * kernel_w + kw) * kBlock;
+              // Index from row: row + kw - pad_w may lie before the input.
+              const int iw_offset = kw - pad_w;
+              for (int ow = ow_begin[kw]; ow < ow_end[kw]; ++ow) {
+                const Dtype x = row[ow * stride_w + iw_offset];
+                Dtype* a = acc + ow * kBlock;
+                for (int b = 0; b < kBlock; ++b) {
+                  a[b] += x * w[b];
+                }
+              }
+            }
+          }
+        }
+        // Scatter the block back to NCHW.
+        for (int b = 0; b < o_count; ++b) {
+          Dtype* out = output + ((o_begin + b) * output_h + oh) * output_w;
+          const Dtype bias_value = bias ? bias[o_begin + b] : Dtype(0);
+          for (int ow = 0; ow < output_w; ++ow) {
+            out[ow] = this->fused_relu(acc[ow * kBlock + b] + bias_value);
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_direct_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  PackWeights();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      ForwardImage(bottom_data + n * this->bottom_dim_,
+          top_data + n * this->top_dim_);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(DirectConvolutionLayer);
+
+}  // namespace caffe
@@ -43,6 +43,9 @@ void EmbedLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }  // parameter initialization
   this->param_propagate_down_.resize(this->blobs_.size(), true);
+  sparse_update_ = this->layer_param_.embed_param().sparse_update();
+  diff_rows_.clear();
+  row_in_diff_.assign(sparse_update_ ? K_ : 0, false);
 }
 
 template <typename Dtype>
@@ -99,6 +102,10 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       DCHECK_EQ(static_cast<Dtype>(index), bottom_data[n])
           << "non-integer input";
       caffe_axpy(N_, Dtype(1), top_diff + n * N_, weight_diff + index * N_);
+      if (sparse_update_ && !row_in_diff_[index]) {
+        row_in_diff_[index] = true;
+        diff_rows_.push_back(index);
+      }
     }
   }
   if (bias_term_ && this->param_propagate_down_[1]) {
@@ -109,6 +116,14 @@ void EmbedLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void EmbedLayer<Dtype>::ClearParamDiffRows() {
+  for (int i = 0; i < diff_rows_.size(); ++i) {
+    row_in_diff_[diff_rows_[i]] = false;
+  }
+  diff_rows_.clear();
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(EmbedLayer);
 #endif
@@ -0,0 +1,76 @@
+#include <vector>
+
+#include "caffe/layers/fft_conv_layer.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  use_fft_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  if (!use_fft_) {
+    return;
+  }
+  fft_.Reshape(this->channels_, this->num_output_, this->group_,
+      this->conv_input_shape_.cpu_data() + 1, this->output_shape_.data(),
+      this->kernel_shape_.cpu_data(), this->pad_.cpu_data(),
+      this->stride_.cpu_data(), this->dilation_.cpu_data());
+  if (this->layer_param_.convolution_param().engine() ==
+      ConvolutionParameter_Engine_DEFAULT) {
+    use_fft_ = fft_.relative_cost(this->num_) < 1;
+  }
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_fft_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  for (int i = 0; i < bottom.size(); ++i) {
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    fft_.Forward(weight, bottom[i]->cpu_data(), top_data, this->num_);
+    if (this->bias_term_) {
+      const Dtype* bias = this->blobs_[1]->cpu_data();
+      for (int n = 0; n < this->num_; ++n) {
+        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void FFTConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!use_fft_) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  for (int i = 0; i < top.size(); ++i) {
+    const Dtype* top_diff = top[i]->cpu_diff();
+    // Bias gradient, if necessary.
+    if (this->bias_term_ && this->param_propagate_down_[1]) {
+      Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+      for (int n = 0; n < this->num_; ++n) {
+        this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+      }
+    }
+    if (this->param_propagate_down_[0]) {
+      fft_.WeightGrad(bottom[i]->cpu_data(), top_diff,
+          this->blobs_[0]->mutable_cpu_diff(), this->num_);
+    }
+    if (propagate_down[i]) {
+      fft_.BackwardData(weight, top_diff, bottom[i]->mutable_cpu_diff(),
+          this->num_);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FFTConvolutionLayer);
+
+}  // namespace caffe
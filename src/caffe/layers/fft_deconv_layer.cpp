@@ -0,0 +1,80 @@
+#include <vector>
+
+#include "caffe/layers/fft_deconv_layer.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void FFTDeconvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  DeconvolutionLayer<Dtype>::Reshape(bottom, top);
+  use_fft_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  if (!use_fft_) {
+    return;
+  }
+  // In the convolution direction the top is the input and the bottom the
+  // output.
+  const int conv_output_shape[2] = { this->input_shape(1),
+      this->input_shape(2) };
+  fft_.Reshape(this->num_output_, this->channels_, this->group_,
+      this->conv_input_shape_.cpu_data() + 1, conv_output_shape,
+      this->kernel_shape_.cpu_data(), this->pad_.cpu_data(),
+      this->stride_.cpu_data(), this->dilation_.cpu_data());
+  if (this->layer_param_.convolution_param().engine() ==
+      ConvolutionParameter_Engine_DEFAULT) {
+    use_fft_ = fft_.relative_cost(this->num_) < 1;
+  }
+}
+
+template <typename Dtype>
+void FFTDeconvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_fft_) {
+    DeconvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  for (int i = 0; i < bottom.size(); ++i) {
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    fft_.BackwardData(weight, bottom[i]->cpu_data(), top_data, this->num_);
+    if (this->bias_term_) {
+      const Dtype* bias = this->blobs_[1]->cpu_data();
+      for (int n = 0; n < this->num_; ++n) {
+        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void FFTDeconvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!use_fft_) {
+    DeconvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  const Blob<Dtype>& weight = *this->blobs_[0];
+  for (int i = 0; i < top.size(); ++i) {
+    const Dtype* top_diff = top[i]->cpu_diff();
+    // Bias gradient, if necessary.
+    if (this->bias_term_ && this->param_propagate_down_[1]) {
+      Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+      for (int n = 0; n < this->num_; ++n) {
+        this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+      }
+    }
+    if (this->param_propagate_down_[0]) {
+      fft_.WeightGrad(top_diff, bottom[i]->cpu_data(),
+          this->blobs_[0]->mutable_cpu_diff(), this->num_);
+    }
+    if (propagate_down[i]) {
+      fft_.Forward(weight, top_diff, bottom[i]->mutable_cpu_diff(),
+          this->num_);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FFTDeconvolutionLayer);
+
+}  // namespace caffe
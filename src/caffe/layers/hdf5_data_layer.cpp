@@ -6,6 +6,8 @@ TODO:
   :: don't forget to update hdf5_daa_layer.cu accordingly
 - add ability to shuffle filenames if flag is set
 */
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
@@ -16,16 +18,24 @@ TODO:
 
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  this->StopInternalThread();
+  if (stream_file_id_ >= 0) {
+    HDF5Lock lock;
+    H5Fclose(stream_file_id_);
+  }
+}
 
 // Load data and label from HDF5 filename into the class property blobs.
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
   DLOG(INFO) << "Loading HDF5 file: " << filename;
+  HDF5Lock lock;
   hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
   if (file_id < 0) {
     LOG(FATAL) << "Failed opening HDF5 file: " << filename;
@@ -106,6 +116,45 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
   }
 
+  const int chunk_size = this->layer_param_.hdf5_data_param().chunk_size();
+  if (chunk_size > 0) {
+    // Take the shapes of the tops from the first file, leaving the reading
+    // to the thread.
+    const char* filename =
+        hdf_filenames_[file_permutation_[current_file_]].c_str();
+    HDF5Lock lock;
+    hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    for (int i = 0; i < top.size(); ++i) {
+      std::vector<hsize_t> dims = hdf5_get_dataset_dims(file_id,
+          this->layer_param_.top(i).c_str(), 1, INT_MAX);
+      vector<int> top_shape(dims.size());
+      top_shape[0] = this->layer_param_.hdf5_data_param().batch_size();
+      for (int j = 1; j < top_shape.size(); ++j) {
+        top_shape[j] = dims[j];
+      }
+      top[i]->Reshape(top_shape);
+    }
+    herr_t status = H5Fclose(file_id);
+    CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+    LOG(INFO) << "Streaming HDF5 files in chunks of " << chunk_size
+        << " rows";
+    // One chunk is output while the next one is read.
+    chunks_.resize(2);
+    for (int i = 0; i < chunks_.size(); ++i) {
+      chunks_[i].reset(new HDF5Chunk<Dtype>());
+      for (int j = 0; j < top.size(); ++j) {
+        chunks_[i]->blobs_.push_back(
+            shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      }
+      chunk_free_.push(chunks_[i].get());
+    }
+    StartInternalThread();
+    return;
+  }
+
   // Load the first HDF5 file and initialize the line counter.
   LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
   current_row_ = 0;
@@ -124,9 +173,120 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      HDF5Chunk<Dtype>* chunk = chunk_free_.pop();
+      LoadChunk(chunk);
+      chunk_full_.push(chunk);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::LoadChunk(HDF5Chunk<Dtype>* chunk) {
+  const HDF5DataParameter& param = this->layer_param_.hdf5_data_param();
+  const unsigned int chunk_size = param.chunk_size();
+  if (stream_file_id_ < 0 || current_window_ == window_permutation_.size()) {
+    HDF5Lock lock;
+    if (stream_file_id_ >= 0) {
+      herr_t status = H5Fclose(stream_file_id_);
+      CHECK_GE(status, 0) << "Failed to close HDF5 file";
+      if (++current_file_ == num_files_) {
+        current_file_ = 0;
+        if (param.shuffle()) {
+          shuffle(file_permutation_.begin(), file_permutation_.end());
+        }
+        DLOG(INFO) << "Looping around to first file.";
+      }
+    }
+    const char* filename =
+        hdf_filenames_[file_permutation_[current_file_]].c_str();
+    DLOG(INFO) << "Streaming HDF5 file: " << filename;
+    stream_file_id_ = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (stream_file_id_ < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    stream_rows_ = hdf5_get_dataset_dims(stream_file_id_,
+        this->layer_param_.top(0).c_str(), 1, INT_MAX)[0];
+    CHECK_GT(stream_rows_, 0) << "No rows in " << filename;
+    for (int i = 1; i < this->layer_param_.top_size(); ++i) {
+      CHECK_EQ(hdf5_get_dataset_dims(stream_file_id_,
+          this->layer_param_.top(i).c_str(), 1, INT_MAX)[0], stream_rows_);
+    }
+    window_permutation_.resize((stream_rows_ + chunk_size - 1) / chunk_size);
+    for (int i = 0; i < window_permutation_.size(); ++i) {
+      window_permutation_[i] = i;
+    }
+    if (param.shuffle()) {
+      shuffle(window_permutation_.begin(), window_permutation_.end());
+    }
+    current_window_ = 0;
+  }
+  const hsize_t row =
+      static_cast<hsize_t>(window_permutation_[current_window_++]) * chunk_size;
+  const hsize_t num_rows = std::min<hsize_t>(chunk_size, stream_rows_ - row);
+  for (int i = 0; i < this->layer_param_.top_size(); ++i) {
+    hdf5_load_nd_dataset_rows(stream_file_id_,
+        this->layer_param_.top(i).c_str(), row, num_rows,
+        chunk->blobs_[i].get());
+  }
+  chunk->permutation_.resize(num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    chunk->permutation_[i] = i;
+  }
+  if (param.shuffle()) {
+    shuffle(chunk->permutation_.begin(), chunk->permutation_.end());
+  }
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::ForwardStream(const vector<Blob<Dtype>*>& top,
+      bool gpu) {
+  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  for (int i = 0; i < batch_size;) {
+    if (!chunk_ || chunk_row_ == chunk_->permutation_.size()) {
+      if (chunk_) {
+        chunk_free_.push(chunk_);
+      }
+      chunk_ = chunk_full_.pop("Waiting for HDF5 data");
+      chunk_row_ = 0;
+    }
+    // Copy the rows that follow each other in the chunk at once.
+    const vector<unsigned int>& permutation = chunk_->permutation_;
+    const unsigned int row = permutation[chunk_row_];
+    int num_rows = 1;
+    while (i + num_rows < batch_size &&
+        chunk_row_ + num_rows < permutation.size() &&
+        permutation[chunk_row_ + num_rows] == row + num_rows) {
+      ++num_rows;
+    }
+    for (int j = 0; j < top.size(); ++j) {
+      const int data_dim = top[j]->count(1);
+      CHECK_EQ(chunk_->blobs_[j]->count(1), data_dim)
+          << "The shape of " << this->layer_param_.top(j)
+          << " differs between files.";
+      Dtype* top_data =
+          gpu ? top[j]->mutable_gpu_data() : top[j]->mutable_cpu_data();
+      caffe_copy(num_rows * data_dim,
+          chunk_->blobs_[j]->cpu_data() + row * data_dim,
+          top_data + i * data_dim);
+    }
+    i += num_rows;
+    chunk_row_ += num_rows;
+  }
+}
+
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+  if (this->layer_param_.hdf5_data_param().chunk_size() > 0) {
+    ForwardStream(top, false);
+    return;
+  }
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
   for (int i = 0; i < batch_size; ++i, ++current_row_) {
     if (current_row_ == hdf_blobs_[0]->shape(0)) {
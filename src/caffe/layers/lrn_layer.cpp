@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
@@ -80,6 +82,10 @@ void LRNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     scale_.Reshape(num_, channels_, height_, width_);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
+    // The CPU kernels only need scale_ and a plane of scratch; the helper
+    // layers serve the GPU, and their blobs are not allocated until used.
+    scale_.Reshape(num_, channels_, height_, width_);
+    plane_buffer_.Reshape(1, 2, height_, width_);
     split_layer_->Reshape(bottom, split_top_vec_);
     square_layer_->Reshape(square_bottom_vec_, square_top_vec_);
     pool_layer_->Reshape(square_top_vec_, pool_top_vec_);
@@ -97,58 +103,158 @@ void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     CrossChannelForward_cpu(bottom, top);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelForward(bottom, top);
+    WithinChannelForward_cpu(bottom, top);
     break;
   default:
     LOG(FATAL) << "Unknown normalization region.";
   }
 }
 
+// The number of spatial positions the cross channel kernels work on at a
+// time, small enough for the running sums of a block to stay in cache.
+static const int kLRNBlock = 256;
+
+// y = x^-beta, from square roots for the common beta of 0.75.
+template <typename Dtype>
+static void PowNegBeta(const int n, const Dtype* x, const Dtype beta,
+    Dtype* y) {
+  if (beta == Dtype(0.75)) {
+    for (int i = 0; i < n; ++i) {
+      const Dtype root = std::sqrt(x[i]);
+      y[i] = 1 / (root * std::sqrt(root));
+    }
+  } else {
+    caffe_powx(n, x, -beta, y);
+  }
+}
+
+// accum += alpha * top_diff * top_data / scale
+template <typename Dtype>
+static void AccumulateRatio(const int n, const Dtype alpha,
+    const Dtype* top_diff, const Dtype* top_data, const Dtype* scale,
+    Dtype* accum) {
+  for (int i = 0; i < n; ++i) {
+    accum[i] += alpha * top_diff[i] * top_data[i] / scale[i];
+  }
+}
+
+// Sum a height x width plane over the size x size windows centered on each
+// position and clipped to the plane, along the rows into rows and then down
+// the columns into out.
+template <typename Dtype>
+static void WindowSum(const Dtype* in, const int height, const int width,
+    const int pre_pad, Dtype* rows, Dtype* out) {
+  for (int h = 0; h < height; ++h) {
+    const Dtype* in_row = in + h * width;
+    Dtype* row = rows + h * width;
+    Dtype sum = 0;
+    for (int w = 0; w <= std::min(pre_pad, width - 1); ++w) {
+      sum += in_row[w];
+    }
+    for (int w = 0; w < width; ++w) {
+      row[w] = sum;
+      if (w + pre_pad + 1 < width) {
+        sum += in_row[w + pre_pad + 1];
+      }
+      if (w - pre_pad >= 0) {
+        sum -= in_row[w - pre_pad];
+      }
+    }
+  }
+  caffe_copy(width, rows, out);
+  for (int h = 1; h <= std::min(pre_pad, height - 1); ++h) {
+    caffe_axpy(width, Dtype(1), rows + h * width, out);
+  }
+  for (int h = 1; h < height; ++h) {
+    // Rows outside the plane are clamped to it and weighted by zero.
+    const int head = h + pre_pad;
+    const int tail = h - pre_pad - 1;
+    const Dtype head_weight = head < height ? 1 : 0;
+    const Dtype tail_weight = tail >= 0 ? 1 : 0;
+    const Dtype* head_row = rows + std::min(head, height - 1) * width;
+    const Dtype* tail_row = rows + std::max(tail, 0) * width;
+    const Dtype* prev = out + (h - 1) * width;
+    Dtype* cur = out + h * width;
+    for (int w = 0; w < width; ++w) {
+      cur[w] = prev[w] + head_weight * head_row[w] - tail_weight * tail_row[w];
+    }
+  }
+}
+
 template <typename Dtype>
 void LRNLayer<Dtype>::CrossChannelForward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
+  const Dtype alpha_over_size = alpha_ / size_;
+  const int spatial = height_ * width_;
+  // Go through the images a block of positions at a time, sliding the sum of
+  // squares across the channels and writing the output as it goes.
   for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
-    }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
+    const Dtype* x = bottom_data + bottom[0]->offset(n);
+    Dtype* s = scale_data + scale_.offset(n);
+    Dtype* y = top_data + top[0]->offset(n);
+    for (int begin = 0; begin < spatial; begin += kLRNBlock) {
+      const int len = std::min(kLRNBlock, spatial - begin);
+      // The first channel sums the channels up to pre_pad_.
+      caffe_set(len, k_, s + begin);
+      for (int c = 0; c <= std::min(pre_pad_, channels_ - 1); ++c) {
+        const Dtype* x_c = x + c * spatial + begin;
+        for (int i = 0; i < len; ++i) {
+          s[begin + i] += alpha_over_size * x_c[i] * x_c[i];
+        }
+      }
+      for (int c = 0; c < channels_; ++c) {
+        Dtype* s_c = s + c * spatial + begin;
+        if (c > 0) {
+          // Add the head and subtract the tail; channels outside the image
+          // are clamped to it and weighted by zero.
+          const int head = c + pre_pad_;
+          const int tail = c - pre_pad_ - 1;
+          const Dtype head_alpha = head < channels_ ? alpha_over_size : 0;
+          const Dtype tail_alpha = tail >= 0 ? alpha_over_size : 0;
+          const Dtype* x_head =
+              x + std::min(head, channels_ - 1) * spatial + begin;
+          const Dtype* x_tail = x + std::max(tail, 0) * spatial + begin;
+          const Dtype* s_prev = s_c - spatial;
+          for (int i = 0; i < len; ++i) {
+            s_c[i] = s_prev[i] + head_alpha * x_head[i] * x_head[i]
+                - tail_alpha * x_tail[i] * x_tail[i];
+          }
+        }
+        Dtype* y_c = y + c * spatial + begin;
+        PowNegBeta(len, s_c, beta_, y_c);
+        caffe_mul(len, y_c, x + c * spatial + begin, y_c);
+      }
     }
   }
+}
 
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelForward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* scale_data = scale_.mutable_cpu_data();
+  Dtype* squares = plane_buffer_.mutable_cpu_data();
+  Dtype* rows = squares + plane_buffer_.offset(0, 1);
+  const Dtype alpha_over_area = alpha_ / (size_ * size_);
+  const int spatial = height_ * width_;
+  // Each plane is squared, summed over the windows and normalized while it
+  // is in cache.
+  for (int i = 0; i < num_ * channels_; ++i) {
+    const Dtype* x = bottom_data + i * spatial;
+    Dtype* s = scale_data + i * spatial;
+    Dtype* y = top_data + i * spatial;
+    caffe_sqr(spatial, x, squares);
+    WindowSum(squares, height_, width_, pre_pad_, rows, s);
+    for (int j = 0; j < spatial; ++j) {
+      s[j] = 1 + alpha_over_area * s[j];
+    }
+    PowNegBeta(spatial, s, beta_, y);
+    caffe_mul(spatial, y, x, y);
+  }
 }
 
 template <typename Dtype>
@@ -169,7 +275,7 @@ void LRNLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     CrossChannelBackward_cpu(top, propagate_down, bottom);
     break;
   case LRNParameter_NormRegion_WITHIN_CHANNEL:
-    WithinChannelBackward(top, propagate_down, bottom);
+    WithinChannelBackward_cpu(top, propagate_down, bottom);
     break;
   default:
     LOG(FATAL) << "Unknown normalization region.";
@@ -185,48 +291,80 @@ void LRNLayer<Dtype>::CrossChannelBackward_cpu(
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const Dtype* scale_data = scale_.cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Blob<Dtype> padded_ratio(1, channels_ + size_ - 1, height_, width_);
-  Blob<Dtype> accum_ratio(1, 1, height_, width_);
-  Dtype* padded_ratio_data = padded_ratio.mutable_cpu_data();
-  Dtype* accum_ratio_data = accum_ratio.mutable_cpu_data();
-  // We hack a little bit by using the diff() to store an additional result
-  Dtype* accum_ratio_times_bottom = accum_ratio.mutable_cpu_diff();
-  caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
   Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
-
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
-
-  // go through individual data
-  int inverse_pre_pad = size_ - (size_ + 1) / 2;
+  const int spatial = height_ * width_;
+  // The sum of diff_i * y_i / s_i over the window of each channel, slid
+  // across the channels a block of positions at a time as in the forward.
+  Dtype accum_ratio[kLRNBlock];
+  Dtype scale_power[kLRNBlock];
   for (int n = 0; n < num_; ++n) {
-    int block_offset = scale_.offset(n);
-    // first, compute diff_i * y_i / s_i
-    caffe_mul<Dtype>(channels_ * height_ * width_,
-        top_diff + block_offset, top_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    caffe_div<Dtype>(channels_ * height_ * width_,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad),
-        scale_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    // Now, compute the accumulated ratios and the bottom diff
-    caffe_set(accum_ratio.count(), Dtype(0), accum_ratio_data);
-    for (int c = 0; c < size_ - 1; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+    const int block_offset = scale_.offset(n);
+    const Dtype* dy = top_diff + block_offset;
+    const Dtype* y = top_data + block_offset;
+    const Dtype* s = scale_data + block_offset;
+    const Dtype* x = bottom_data + block_offset;
+    Dtype* dx = bottom_diff + block_offset;
+    for (int begin = 0; begin < spatial; begin += kLRNBlock) {
+      const int len = std::min(kLRNBlock, spatial - begin);
+      caffe_set(len, Dtype(0), accum_ratio);
+      for (int c = 0; c < std::min(pre_pad_, channels_); ++c) {
+        const int offset = c * spatial + begin;
+        AccumulateRatio(len, Dtype(1), dy + offset, y + offset, s + offset,
+            accum_ratio);
+      }
+      for (int c = 0; c < channels_; ++c) {
+        const int head = (c + pre_pad_) * spatial + begin;
+        if (c + pre_pad_ < channels_) {
+          AccumulateRatio(len, Dtype(1), dy + head, y + head, s + head,
+              accum_ratio);
+        }
+        // compute bottom diff
+        const int offset = c * spatial + begin;
+        PowNegBeta(len, s + offset, beta_, scale_power);
+        for (int i = 0; i < len; ++i) {
+          dx[offset + i] = dy[offset + i] * scale_power[i]
+              - cache_ratio_value * x[offset + i] * accum_ratio[i];
+        }
+        const int tail = (c - pre_pad_) * spatial + begin;
+        if (c - pre_pad_ >= 0) {
+          AccumulateRatio(len, Dtype(-1), dy + tail, y + tail, s + tail,
+              accum_ratio);
+        }
+      }
     }
-    for (int c = 0; c < channels_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c + size_ - 1),
-          accum_ratio_data);
-      // compute bottom diff
-      caffe_mul<Dtype>(height_ * width_,
-          bottom_data + top[0]->offset(n, c),
-          accum_ratio_data, accum_ratio_times_bottom);
-      caffe_axpy<Dtype>(height_ * width_, -cache_ratio_value,
-          accum_ratio_times_bottom, bottom_diff + top[0]->offset(n, c));
-      caffe_axpy<Dtype>(height_ * width_, -1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
+  }
+}
+
+template <typename Dtype>
+void LRNLayer<Dtype>::WithinChannelBackward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!propagate_down[0]) {
+    return;
+  }
+  const Dtype* top_diff = top[0]->cpu_diff();
+  const Dtype* top_data = top[0]->cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* scale_data = scale_.cpu_data();
+  Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
+  Dtype* ratio = plane_buffer_.mutable_cpu_data();
+  Dtype* rows = ratio + plane_buffer_.offset(0, 1);
+  const Dtype cache_ratio_value = 2. * alpha_ * beta_ / (size_ * size_);
+  const int spatial = height_ * width_;
+  for (int i = 0; i < num_ * channels_; ++i) {
+    const Dtype* dy = top_diff + i * spatial;
+    const Dtype* y = top_data + i * spatial;
+    const Dtype* s = scale_data + i * spatial;
+    const Dtype* x = bottom_data + i * spatial;
+    Dtype* dx = bottom_diff + i * spatial;
+    // The windowed sum of diff_i * y_i / s_i goes into the bottom diff, and
+    // the row sums are reused for s_i^-beta once they are done with.
+    caffe_set(spatial, Dtype(0), ratio);
+    AccumulateRatio(spatial, Dtype(1), dy, y, s, ratio);
+    WindowSum(ratio, height_, width_, pre_pad_, rows, dx);
+    PowNegBeta(spatial, s, beta_, rows);
+    for (int j = 0; j < spatial; ++j) {
+      dx[j] = dy[j] * rows[j] - cache_ratio_value * x[j] * dx[j];
     }
   }
 }
@@ -10,6 +10,17 @@
 
 namespace caffe {
 
+// As in LSTMUnitLayer, so that the FUSED engine computes the same values.
+template <typename Dtype>
+inline Dtype sigmoid(Dtype x) {
+  return 1. / (1. + exp(-x));
+}
+
+template <typename Dtype>
+inline Dtype tanh(Dtype x) {
+  return 2. * sigmoid(2. * x) - 1.;
+}
+
 template <typename Dtype>
 void LSTMLayer<Dtype>::RecurrentInputBlobNames(vector<string>* names) const {
   names->resize(2);
@@ -238,6 +249,206 @@ void LSTMLayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int gate_dim = 4 * hidden_dim;
+  const int input_dim = bottom[0]->count(2);
+  vector<int> shape(3);
+  shape[0] = T;
+  shape[1] = N;
+  shape[2] = gate_dim;
+  gates_.Reshape(shape);
+  shape[2] = hidden_dim;
+  cell_.Reshape(shape);
+  h_conted_.Reshape(shape);
+  shape.resize(1);
+  shape[0] = T * N;
+  if (bias_multiplier_.count() != T * N) {
+    bias_multiplier_.Reshape(shape);
+    caffe_set(T * N, Dtype(1), bias_multiplier_.mutable_cpu_data());
+  }
+  const Dtype* cont = bottom[1]->cpu_data();
+  const Dtype* W_xc = this->blobs_[0]->cpu_data();
+  const Dtype* b_c = this->blobs_[1]->cpu_data();
+  const Dtype* W_hc = this->blobs_.back()->cpu_data();
+  Dtype* gates = gates_.mutable_cpu_data();
+
+  // Transform all timesteps of x at once.
+  //     gates := W_xc * x + b_c
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, T * N, gate_dim, input_dim,
+      Dtype(1), bottom[0]->cpu_data(), W_xc, Dtype(0), gates);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T * N, gate_dim, 1,
+      Dtype(1), bias_multiplier_.cpu_data(), b_c, Dtype(1), gates);
+  if (this->static_input_) {
+    //     W_xc_x_static := W_xc_static * x_static
+    shape.resize(2);
+    shape[0] = N;
+    shape[1] = gate_dim;
+    static_gates_.Reshape(shape);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, gate_dim,
+        bottom[2]->count(1), Dtype(1), bottom[2]->cpu_data(),
+        this->blobs_[2]->cpu_data(), Dtype(0),
+        static_gates_.mutable_cpu_data());
+  }
+
+  const Dtype* h_prev = this->recur_input_blobs_[0]->cpu_data();
+  const Dtype* c_prev = this->recur_input_blobs_[1]->cpu_data();
+  Dtype* h = top[0]->mutable_cpu_data();
+  Dtype* c = cell_.mutable_cpu_data();
+  Dtype* h_conted = h_conted_.mutable_cpu_data();
+  for (int t = 0; t < T; ++t) {
+    //     h_conted_{t-1} := cont_t * h_{t-1}
+    for (int n = 0; n < N; ++n) {
+      caffe_cpu_scale(hidden_dim, cont[n], h_prev + n * hidden_dim,
+          h_conted + n * hidden_dim);
+    }
+    //     gate_input_t := W_hc * h_conted_{t-1} + W_xc * x_t + b_c
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, gate_dim, hidden_dim,
+        Dtype(1), h_conted, W_hc, Dtype(1), gates);
+    if (this->static_input_) {
+      caffe_axpy(N * gate_dim, Dtype(1), static_gates_.cpu_data(), gates);
+    }
+    // The LSTMUnit nonlinearity, keeping the activated gates for Backward.
+    for (int n = 0; n < N; ++n) {
+      Dtype* X = gates + n * gate_dim;
+      for (int d = 0; d < hidden_dim; ++d) {
+        const Dtype i = sigmoid(X[d]);
+        const Dtype f = (cont[n] == 0) ? 0 :
+            (cont[n] * sigmoid(X[1 * hidden_dim + d]));
+        const Dtype o = sigmoid(X[2 * hidden_dim + d]);
+        const Dtype g = tanh(X[3 * hidden_dim + d]);
+        const int index = n * hidden_dim + d;
+        const Dtype c_t = f * c_prev[index] + i * g;
+        c[index] = c_t;
+        h[index] = o * tanh(c_t);
+        X[d] = i;
+        X[1 * hidden_dim + d] = f;
+        X[2 * hidden_dim + d] = o;
+        X[3 * hidden_dim + d] = g;
+      }
+    }
+    h_prev = h;
+    c_prev = c;
+    cont += N;
+    gates += N * gate_dim;
+    h += N * hidden_dim;
+    c += N * hidden_dim;
+    h_conted += N * hidden_dim;
+  }
+  caffe_copy(N * hidden_dim, h_prev,
+      this->recur_output_blobs_[0]->mutable_cpu_data());
+  caffe_copy(N * hidden_dim, c_prev,
+      this->recur_output_blobs_[1]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int hidden_dim = this->layer_param_.recurrent_param().num_output();
+  const int gate_dim = 4 * hidden_dim;
+  const int input_dim = bottom[0]->count(2);
+  vector<int> shape(3);
+  shape[0] = 2;
+  shape[1] = N;
+  shape[2] = hidden_dim;
+  state_diff_.Reshape(shape);
+  // No gradient comes from beyond the last timestep.
+  Dtype* h_next_diff = state_diff_.mutable_cpu_data();
+  Dtype* c_next_diff = h_next_diff + N * hidden_dim;
+  caffe_set(state_diff_.count(), Dtype(0), h_next_diff);
+  const Dtype* W_hc = this->blobs_.back()->cpu_data();
+
+  for (int t = T - 1; t >= 0; --t) {
+    const Dtype* cont = bottom[1]->cpu_data() + t * N;
+    const Dtype* gates = gates_.cpu_data() + t * N * gate_dim;
+    const Dtype* c = cell_.cpu_data() + t * N * hidden_dim;
+    const Dtype* c_prev = t ? c - N * hidden_dim :
+        this->recur_input_blobs_[1]->cpu_data();
+    const Dtype* h_diff = top[0]->cpu_diff() + t * N * hidden_dim;
+    Dtype* gates_diff = gates_.mutable_cpu_diff() + t * N * gate_dim;
+    Dtype* h_conted_diff = h_conted_.mutable_cpu_diff() + t * N * hidden_dim;
+    for (int n = 0; n < N; ++n) {
+      const Dtype* X = gates + n * gate_dim;
+      Dtype* X_diff = gates_diff + n * gate_dim;
+      for (int d = 0; d < hidden_dim; ++d) {
+        const int index = n * hidden_dim + d;
+        const Dtype i = X[d];
+        const Dtype f = X[1 * hidden_dim + d];
+        const Dtype o = X[2 * hidden_dim + d];
+        const Dtype g = X[3 * hidden_dim + d];
+        const Dtype tanh_c = tanh(c[index]);
+        const Dtype h_t_diff = h_diff[index] + h_next_diff[index];
+        const Dtype c_term_diff =
+            c_next_diff[index] + h_t_diff * o * (1 - tanh_c * tanh_c);
+        c_next_diff[index] = c_term_diff * f;
+        X_diff[d] = c_term_diff * g * i * (1 - i);
+        X_diff[1 * hidden_dim + d] =
+            c_term_diff * c_prev[index] * f * (1 - f);
+        X_diff[2 * hidden_dim + d] = h_t_diff * tanh_c * o * (1 - o);
+        X_diff[3 * hidden_dim + d] = c_term_diff * i * (1 - g * g);
+      }
+    }
+    //     h_{t-1} diff := cont_t * W_hc^T * gate_input_t diff
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, hidden_dim, gate_dim,
+        Dtype(1), gates_diff, W_hc, Dtype(0), h_conted_diff);
+    for (int n = 0; n < N; ++n) {
+      caffe_cpu_scale(hidden_dim, cont[n], h_conted_diff + n * hidden_dim,
+          h_next_diff + n * hidden_dim);
+    }
+  }
+
+  // The gradients w.r.t. the parameters and inputs, over all timesteps at
+  // once.
+  const Dtype* gates_diff = gates_.cpu_diff();
+  if (this->param_propagate_down(0)) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, input_dim,
+        T * N, Dtype(1), gates_diff, bottom[0]->cpu_data(), Dtype(1),
+        this->blobs_[0]->mutable_cpu_diff());
+  }
+  if (this->param_propagate_down(1)) {
+    caffe_cpu_gemv<Dtype>(CblasTrans, T * N, gate_dim, Dtype(1), gates_diff,
+        bias_multiplier_.cpu_data(), Dtype(1),
+        this->blobs_[1]->mutable_cpu_diff());
+  }
+  const int W_hc_index = this->blobs_.size() - 1;
+  if (this->param_propagate_down(W_hc_index)) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, hidden_dim,
+        T * N, Dtype(1), gates_diff, h_conted_.cpu_data(), Dtype(1),
+        this->blobs_[W_hc_index]->mutable_cpu_diff());
+  }
+  if (propagate_down[0]) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T * N, input_dim,
+        gate_dim, Dtype(1), gates_diff, this->blobs_[0]->cpu_data(), Dtype(0),
+        bottom[0]->mutable_cpu_diff());
+  }
+  if (this->static_input_) {
+    // The static input adds to the gate inputs of every timestep.
+    const int static_dim = bottom[2]->count(1);
+    Dtype* static_diff = static_gates_.mutable_cpu_diff();
+    caffe_copy(N * gate_dim, gates_diff, static_diff);
+    for (int t = 1; t < T; ++t) {
+      caffe_axpy(N * gate_dim, Dtype(1), gates_diff + t * N * gate_dim,
+          static_diff);
+    }
+    if (this->param_propagate_down(2)) {
+      caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, static_dim,
+          N, Dtype(1), static_diff, bottom[2]->cpu_data(), Dtype(1),
+          this->blobs_[2]->mutable_cpu_diff());
+    }
+    if (propagate_down[2]) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, static_dim,
+          gate_dim, Dtype(1), static_diff, this->blobs_[2]->cpu_data(),
+          Dtype(0), bottom[2]->mutable_cpu_diff());
+    }
+  }
+}
+
 INSTANTIATE_CLASS(LSTMLayer);
 REGISTER_LAYER_CLASS(LSTM);
 
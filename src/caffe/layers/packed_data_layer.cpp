@@ -0,0 +1,132 @@
+#include <vector>
+
+#include "caffe/layers/packed_data_layer.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void PackedDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const PackedDataParameter& param = this->layer_param_.packed_data_param();
+  const int batch_size = param.batch_size();
+  CHECK_GT(batch_size, 0) << "Positive batch size required";
+  LOG(INFO) << "Opening packed tensor file " << param.source();
+  file_.Open(param.source());
+  CHECK_GT(file_.num_records(), 0) << "No records in " << param.source();
+  LOG(INFO) << "Number of records: " << file_.num_records();
+
+  const bool transform = this->layer_param_.has_transform_param();
+  tensors_.resize(top.size());
+  can_map_.resize(top.size());
+  own_data_.resize(top.size());
+  mapped_data_.resize(top.size());
+  for (int i = 0; i < top.size(); ++i) {
+    tensors_[i] = file_.FindTensor(this->layer_param_.top(i));
+    CHECK_GE(tensors_[i], 0) << "No tensor " << this->layer_param_.top(i)
+        << " in " << param.source();
+    const PackedTensor& tensor = file_.tensor(tensors_[i]);
+    vector<int> top_shape(1, batch_size);
+    top_shape.insert(top_shape.end(), tensor.shape.begin(),
+        tensor.shape.end());
+    if (i == 0 && transform) {
+      CHECK_EQ(tensor.shape.size(), 3)
+          << "Transformed items must have 3 axes (channels, height, width).";
+      transformer_.reset(new DataTransformer<Dtype>(
+          this->layer_param_.transform_param(), this->phase_));
+      transformer_->InitRand();
+      item_.Reshape(1, tensor.shape[0], tensor.shape[1], tensor.shape[2]);
+      const int crop_size = this->layer_param_.transform_param().crop_size();
+      if (crop_size) {
+        top_shape[2] = crop_size;
+        top_shape[3] = crop_size;
+      }
+      transformed_item_.Reshape(1, top_shape[1], top_shape[2], top_shape[3]);
+    }
+    can_map_[i] = tensor.type == packed_type<Dtype>() && !(i == 0 && transform);
+    top[i]->Reshape(top_shape);
+    own_data_[i] = top[i]->data();
+    mapped_data_[i].reset(new SyncedMemory(top[i]->count() * sizeof(Dtype)));
+  }
+
+  order_.resize(file_.num_records());
+  for (uint64_t i = 0; i < order_.size(); ++i) {
+    order_[i] = i;
+  }
+  if (param.shuffle()) {
+    shuffle(order_.begin(), order_.end());
+  }
+  position_ = 0;
+  batch_.resize(batch_size);
+  mapped_ = false;
+  NextBatch();
+}
+
+template <typename Dtype>
+void PackedDataLayer<Dtype>::NextBatch() {
+  for (int i = 0; i < batch_.size(); ++i, ++position_) {
+    if (position_ == order_.size()) {
+      DLOG(INFO) << "Restarting data prefetching from start.";
+      if (this->layer_param_.packed_data_param().shuffle()) {
+        shuffle(order_.begin(), order_.end());
+      }
+      position_ = 0;
+    }
+    batch_[i] = order_[position_];
+  }
+  contiguous_ = batch_.back() - batch_.front() == batch_.size() - 1 &&
+      !this->layer_param_.packed_data_param().shuffle();
+  for (int i = 0; i < tensors_.size(); ++i) {
+    if (contiguous_) {
+      file_.WillNeed(tensors_[i], batch_.front(), batch_.size());
+    } else {
+      for (int j = 0; j < batch_.size(); ++j) {
+        file_.WillNeed(tensors_[i], batch_[j], 1);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PackedDataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const int batch_size = batch_.size();
+  // The previous batch is done with: release its pages before any top points
+  // into the map again, as they may share some with this batch.
+  if (mapped_) {
+    for (int i = 0; i < top.size(); ++i) {
+      if (can_map_[i]) {
+        file_.DontNeed(tensors_[i], mapped_record_, batch_size);
+      }
+    }
+    mapped_ = false;
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    const int tensor = tensors_[i];
+    if (contiguous_ && can_map_[i]) {
+      mapped_data_[i]->set_cpu_data(file_.item(tensor, batch_.front()));
+      top[i]->ShareDataMemory(mapped_data_[i]);
+      mapped_ = true;
+      mapped_record_ = batch_.front();
+      continue;
+    }
+    top[i]->ShareDataMemory(own_data_[i]);
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    const int item_count = top[i]->count(1);
+    for (int j = 0; j < batch_size; ++j) {
+      if (i == 0 && transformer_) {
+        file_.Read(tensor, batch_[j], item_.mutable_cpu_data());
+        transformed_item_.set_cpu_data(top_data + j * item_count);
+        transformer_->Transform(&item_, &transformed_item_);
+      } else {
+        file_.Read(tensor, batch_[j], top_data + j * item_count);
+      }
+    }
+  }
+  NextBatch();
+}
+
+INSTANTIATE_CLASS(PackedDataLayer);
+REGISTER_LAYER_CLASS(PackedData);
+
+}  // namespace caffe
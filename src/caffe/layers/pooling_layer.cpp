@@ -1,9 +1,13 @@
+#include <boost/bind.hpp>
+#include <stdint.h>
+
 #include <algorithm>
 #include <cfloat>
 #include <vector>
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -80,6 +84,7 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
       << "corresponding to (num, channels, height, width)";
+  num_ = bottom[0]->num();
   channels_ = bottom[0]->channels();
   height_ = bottom[0]->height();
   width_ = bottom[0]->width();
@@ -122,110 +127,299 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
-// TODO(Yangqing): Is there a faster way to do pooling in the channel-first
-// case?
+// The fewest bottom values worth a task of their own when splitting the
+// planes of a batch across ThreadPool::Global().
+static const int kPoolingTaskSize = 16384;
+
+// The outputs in [*begin, *end) along an axis pool windows that lie inside
+// the input, so that they need no clipping.
+static void InteriorRange(int input, int kernel, int stride, int pad,
+    int pooled, int* begin, int* end) {
+  *begin = min((pad + stride - 1) / stride, pooled);
+  *end = input + pad >= kernel ?
+      min((input + pad - kernel) / stride + 1, pooled) : 0;
+  *end = max(*end, *begin);
+}
+
+// Max pool count windows of a row of outputs, stride_w apart, that lie inside
+// a plane of the given width. in points to the first window, at index base in
+// the plane. KH, KW and SW fix the window at compile time when nonzero, which
+// unrolls it, and without MASK the loop is free of branches.
+template <typename Dtype, int KH, int KW, int SW, bool MASK>
+static void MaxPoolWindows(const Dtype* in, int base, int width,
+    int kernel_h, int kernel_w, int stride_w, int count, Dtype* out,
+    int* mask) {
+  const int kh = KH ? KH : kernel_h;
+  const int kw = KW ? KW : kernel_w;
+  const int sw = SW ? SW : stride_w;
+  for (int i = 0; i < count; ++i) {
+    const Dtype* window = in + i * sw;
+    Dtype value = -FLT_MAX;
+    int max_index = -1;
+    for (int h = 0; h < kh; ++h) {
+      for (int w = 0; w < kw; ++w) {
+        const Dtype v = window[h * width + w];
+        if (MASK) {
+          if (v > value) {
+            value = v;
+            max_index = base + i * sw + h * width + w;
+          }
+        } else {
+          value = v > value ? v : value;
+        }
+      }
+    }
+    out[i] = value;
+    if (MASK) {
+      mask[i] = max_index;
+    }
+  }
+}
+
+template <typename Dtype, bool MASK>
+static void MaxPoolRow(const Dtype* in, int base, int width, int kernel_h,
+    int kernel_w, int stride_w, int count, Dtype* out, int* mask) {
+  if (kernel_h == 2 && kernel_w == 2 && stride_w == 2) {
+    MaxPoolWindows<Dtype, 2, 2, 2, MASK>(in, base, width, kernel_h, kernel_w,
+        stride_w, count, out, mask);
+  } else if (kernel_h == 3 && kernel_w == 3 && stride_w == 2) {
+    MaxPoolWindows<Dtype, 3, 3, 2, MASK>(in, base, width, kernel_h, kernel_w,
+        stride_w, count, out, mask);
+  } else {
+    MaxPoolWindows<Dtype, 0, 0, 0, MASK>(in, base, width, kernel_h, kernel_w,
+        stride_w, count, out, mask);
+  }
+}
+
+// Average pool count windows of a row of outputs that lie inside the plane,
+// as MaxPoolWindows.
+template <typename Dtype, int KH, int KW, int SW>
+static void AvePoolWindows(const Dtype* in, int width, int kernel_h,
+    int kernel_w, int stride_w, int count, Dtype* out) {
+  const int kh = KH ? KH : kernel_h;
+  const int kw = KW ? KW : kernel_w;
+  const int sw = SW ? SW : stride_w;
+  const int pool_size = kh * kw;
+  for (int i = 0; i < count; ++i) {
+    const Dtype* window = in + i * sw;
+    Dtype sum = 0;
+    for (int h = 0; h < kh; ++h) {
+      for (int w = 0; w < kw; ++w) {
+        sum += window[h * width + w];
+      }
+    }
+    out[i] = sum / pool_size;
+  }
+}
+
+template <typename Dtype>
+static void AvePoolRow(const Dtype* in, int width, int kernel_h,
+    int kernel_w, int stride_w, int count, Dtype* out) {
+  if (kernel_h == 2 && kernel_w == 2 && stride_w == 2) {
+    AvePoolWindows<Dtype, 2, 2, 2>(in, width, kernel_h, kernel_w, stride_w,
+        count, out);
+  } else if (kernel_h == 3 && kernel_w == 3 && stride_w == 2) {
+    AvePoolWindows<Dtype, 3, 3, 2>(in, width, kernel_h, kernel_w, stride_w,
+        count, out);
+  } else {
+    AvePoolWindows<Dtype, 0, 0, 0>(in, width, kernel_h, kernel_w, stride_w,
+        count, out);
+  }
+}
+
+template <typename Dtype>
+int PoolingLayer<Dtype>::NumTasks() const {
+  const int num_planes = num_ * channels_;
+  const int num_tasks = num_planes * height_ * width_ / kPoolingTaskSize;
+  return max(1, min(num_tasks, num_planes));
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::ForwardPlane(const Dtype* bottom_data,
+    Dtype* top_data, int* mask, Dtype* top_mask) {
+  const bool max_pool = this->layer_param_.pooling_param().pool() ==
+      PoolingParameter_PoolMethod_MAX;
+  // The outputs whose windows lie inside the image go through the row
+  // kernels, and those on the border are clipped one at a time. A top mask
+  // takes the latter path throughout.
+  int ph_begin, ph_end, pw_begin, pw_end;
+  InteriorRange(height_, kernel_h_, stride_h_, pad_h_, pooled_height_,
+      &ph_begin, &ph_end);
+  InteriorRange(width_, kernel_w_, stride_w_, pad_w_, pooled_width_,
+      &pw_begin, &pw_end);
+  if (top_mask) {
+    pw_begin = pw_end = 0;
+  }
+  for (int ph = 0; ph < pooled_height_; ++ph) {
+    const bool interior_row = ph >= ph_begin && ph < ph_end;
+    for (int pw = 0; pw < pooled_width_; ++pw) {
+      int hstart = ph * stride_h_ - pad_h_;
+      int wstart = pw * stride_w_ - pad_w_;
+      const int pool_index = ph * pooled_width_ + pw;
+      if (interior_row && pw == pw_begin && pw_end > pw_begin) {
+        const int base = hstart * width_ + wstart;
+        const int count = pw_end - pw_begin;
+        if (!max_pool) {
+          AvePoolRow(bottom_data + base, width_, kernel_h_, kernel_w_,
+              stride_w_, count, top_data + pool_index);
+        } else if (mask) {
+          MaxPoolRow<Dtype, true>(bottom_data + base, base, width_,
+              kernel_h_, kernel_w_, stride_w_, count, top_data + pool_index,
+              mask + pool_index);
+        } else {
+          MaxPoolRow<Dtype, false>(bottom_data + base, base, width_,
+              kernel_h_, kernel_w_, stride_w_, count, top_data + pool_index,
+              NULL);
+        }
+        pw = pw_end - 1;
+        continue;
+      }
+      if (max_pool) {
+        const int hend = min(hstart + kernel_h_, height_);
+        const int wend = min(wstart + kernel_w_, width_);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        Dtype value = -FLT_MAX;
+        int max_index = -1;
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            const int index = h * width_ + w;
+            if (bottom_data[index] > value) {
+              value = bottom_data[index];
+              max_index = index;
+            }
+          }
+        }
+        top_data[pool_index] = value;
+        if (top_mask) {
+          top_mask[pool_index] = static_cast<Dtype>(max_index);
+        } else if (mask) {
+          mask[pool_index] = max_index;
+        }
+      } else {
+        int hend = min(hstart + kernel_h_, height_ + pad_h_);
+        int wend = min(wstart + kernel_w_, width_ + pad_w_);
+        const int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, height_);
+        wend = min(wend, width_);
+        Dtype sum = 0;
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            sum += bottom_data[h * width_ + w];
+          }
+        }
+        top_data[pool_index] = sum / pool_size;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::ForwardPlanes(const Dtype* bottom_data,
+    Dtype* top_data, int* mask, Dtype* top_mask, int num_tasks, int task,
+    int slot) {
+  const int num_planes = num_ * channels_;
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
+  const int end = (task + 1) * static_cast<int64_t>(num_planes) / num_tasks;
+  for (int i = task * static_cast<int64_t>(num_planes) / num_tasks; i < end;
+       ++i) {
+    ForwardPlane(bottom_data + i * bottom_dim, top_data + i * top_dim,
+        mask ? mask + i * top_dim : NULL,
+        top_mask ? top_mask + i * top_dim : NULL);
+  }
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
+  int* mask = NULL;
   Dtype* top_mask = NULL;
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
+    // Nothing consumes the mask at test time, so max_idx_ is left alone;
+    // Backward_cpu recomputes it if it is called anyway.
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
-    } else {
+    } else if (this->phase_ != TEST) {
       mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
+    break;
+  case PoolingParameter_PoolMethod_STOCHASTIC:
+    NOT_IMPLEMENTED;
+    break;
+  default:
+    LOG(FATAL) << "Unknown pooling method.";
+  }
+  // The (n, c) planes are pooled independently, a range of them per task.
+  const int num_tasks = NumTasks();
+  ThreadPool::Global().Run(num_tasks, boost::bind(
+      &PoolingLayer<Dtype>::ForwardPlanes, this, bottom_data, top_data, mask,
+      top_mask, num_tasks, _1, _2));
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::BackwardPlane(const Dtype* top_diff,
+    const int* mask, const Dtype* top_mask, Dtype* bottom_diff) {
+  caffe_set(height_ * width_, Dtype(0), bottom_diff);
+  switch (this->layer_param_.pooling_param().pool()) {
+  case PoolingParameter_PoolMethod_MAX:
+    for (int index = 0; index < pooled_height_ * pooled_width_; ++index) {
+      const int bottom_index =
+          top_mask ? static_cast<int>(top_mask[index]) : mask[index];
+      bottom_diff[bottom_index] += top_diff[index];
     }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
+    break;
+  case PoolingParameter_PoolMethod_AVE:
+    for (int ph = 0; ph < pooled_height_; ++ph) {
+      for (int pw = 0; pw < pooled_width_; ++pw) {
+        int hstart = ph * stride_h_ - pad_h_;
+        int wstart = pw * stride_w_ - pad_w_;
+        int hend = min(hstart + kernel_h_, height_ + pad_h_);
+        int wend = min(wstart + kernel_w_, width_ + pad_w_);
+        int pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, height_);
+        wend = min(wend, width_);
+        const Dtype diff = top_diff[ph * pooled_width_ + pw] / pool_size;
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            bottom_diff[h * width_ + w] += diff;
           }
         }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
       }
     }
     break;
-  case PoolingParameter_PoolMethod_STOCHASTIC:
-    NOT_IMPLEMENTED;
-    break;
   default:
     LOG(FATAL) << "Unknown pooling method.";
   }
 }
 
+template <typename Dtype>
+void PoolingLayer<Dtype>::BackwardPlanes(const Dtype* top_diff,
+    const int* mask, const Dtype* top_mask, Dtype* bottom_diff, int num_tasks,
+    int task, int slot) {
+  const int num_planes = num_ * channels_;
+  const int bottom_dim = height_ * width_;
+  const int top_dim = pooled_height_ * pooled_width_;
+  const int end = (task + 1) * static_cast<int64_t>(num_planes) / num_tasks;
+  for (int i = task * static_cast<int64_t>(num_planes) / num_tasks; i < end;
+       ++i) {
+    BackwardPlane(top_diff + i * top_dim, mask ? mask + i * top_dim : NULL,
+        top_mask ? top_mask + i * top_dim : NULL,
+        bottom_diff + i * bottom_dim);
+  }
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
@@ -234,69 +428,29 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more codes.
-  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
-  const int* mask = NULL;  // suppress warnings about uninitialized variables
+  const int* mask = NULL;
   const Dtype* top_mask = NULL;
+  const int num_tasks = NumTasks();
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // The main loop
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
-      mask = max_idx_.cpu_data();
-    }
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
-            bottom_diff[bottom_index] += top_diff[index];
-          }
-        }
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
+      if (this->phase_ == TEST) {
+        // The forward pass skipped the mask: pool again to compute it, into
+        // a scratch top so that the output is left as it is.
+        scratch_top_.ReshapeLike(*top[0]);
+        ThreadPool::Global().Run(num_tasks, boost::bind(
+            &PoolingLayer<Dtype>::ForwardPlanes, this, bottom[0]->cpu_data(),
+            scratch_top_.mutable_cpu_data(), max_idx_.mutable_cpu_data(),
+            static_cast<Dtype*>(NULL), num_tasks, _1, _2));
       }
+      mask = max_idx_.cpu_data();
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    // The main loop
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                bottom_diff[h * width_ + w] +=
-                  top_diff[ph * pooled_width_ + pw] / pool_size;
-              }
-            }
-          }
-        }
-        // offset
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-      }
-    }
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -304,9 +458,11 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   default:
     LOG(FATAL) << "Unknown pooling method.";
   }
+  ThreadPool::Global().Run(num_tasks, boost::bind(
+      &PoolingLayer<Dtype>::BackwardPlanes, this, top_diff, mask, top_mask,
+      bottom_diff, num_tasks, _1, _2));
 }
 
-
 #ifdef CPU_ONLY
 STUB_GPU(PoolingLayer);
 #endif
@@ -28,6 +28,8 @@ void RecurrentLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // If expose_hidden is set, we take as input and produce as output
   // the hidden state blobs at the first and last timesteps.
   expose_hidden_ = this->layer_param_.recurrent_param().expose_hidden();
+  fused_ = this->layer_param_.recurrent_param().engine() ==
+      RecurrentParameter_Engine_FUSED;
 
   // Get (recurrent) input/output names.
   vector<string> output_names;
@@ -190,19 +192,25 @@ void RecurrentLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       << "bottom[1] must have exactly 2 axes -- (#timesteps, #streams)";
   CHECK_EQ(T_, bottom[1]->shape(0));
   CHECK_EQ(N_, bottom[1]->shape(1));
-  x_input_blob_->ReshapeLike(*bottom[0]);
-  vector<int> cont_shape = bottom[1]->shape();
-  cont_input_blob_->Reshape(cont_shape);
-  if (static_input_) {
-    x_static_input_blob_->ReshapeLike(*bottom[2]);
-  }
-  vector<BlobShape> recur_input_shapes;
-  RecurrentInputShapes(&recur_input_shapes);
-  CHECK_EQ(recur_input_shapes.size(), recur_input_blobs_.size());
-  for (int i = 0; i < recur_input_shapes.size(); ++i) {
-    recur_input_blobs_[i]->Reshape(recur_input_shapes[i]);
+  // Streaming calls Reshape before every Forward with the same shapes, for
+  // which the unrolled net is already shaped.
+  const bool reshape = x_input_blob_->shape() != bottom[0]->shape() ||
+      (static_input_ && x_static_input_blob_->shape() != bottom[2]->shape());
+  if (reshape) {
+    x_input_blob_->ReshapeLike(*bottom[0]);
+    vector<int> cont_shape = bottom[1]->shape();
+    cont_input_blob_->Reshape(cont_shape);
+    if (static_input_) {
+      x_static_input_blob_->ReshapeLike(*bottom[2]);
+    }
+    vector<BlobShape> recur_input_shapes;
+    RecurrentInputShapes(&recur_input_shapes);
+    CHECK_EQ(recur_input_shapes.size(), recur_input_blobs_.size());
+    for (int i = 0; i < recur_input_shapes.size(); ++i) {
+      recur_input_blobs_[i]->Reshape(recur_input_shapes[i]);
+    }
+    unrolled_net_->Reshape();
   }
-  unrolled_net_->Reshape();
   x_input_blob_->ShareData(*bottom[0]);
   x_input_blob_->ShareDiff(*bottom[0]);
   cont_input_blob_->ShareData(*bottom[1]);
@@ -241,6 +249,54 @@ void RecurrentLayer<Dtype>::Reset() {
   }
 }
 
+template <typename Dtype>
+int RecurrentLayer<Dtype>::StreamStateCount() const {
+  CHECK(!expose_hidden_) << "The hidden state is not carried over when "
+      << "expose_hidden is set.";
+  int count = 0;
+  for (int i = 0; i < recur_output_blobs_.size(); ++i) {
+    count += recur_output_blobs_[i]->count(2);
+  }
+  return count;
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::ResetStream(int n) {
+  Blob<Dtype> state(vector<int>(1, StreamStateCount()));
+  caffe_set(state.count(), Dtype(0), state.mutable_cpu_data());
+  SetStreamState(n, state);
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::GetStreamState(int n, Blob<Dtype>* state) const {
+  CHECK_GE(n, 0);
+  CHECK_LT(n, N_);
+  vector<int> shape(1, StreamStateCount());
+  state->Reshape(shape);
+  Dtype* state_data = state->mutable_cpu_data();
+  for (int i = 0; i < recur_output_blobs_.size(); ++i) {
+    const int count = recur_output_blobs_[i]->count(2);
+    caffe_copy(count, recur_output_blobs_[i]->cpu_data() + n * count,
+               state_data);
+    state_data += count;
+  }
+}
+
+template <typename Dtype>
+void RecurrentLayer<Dtype>::SetStreamState(int n, const Blob<Dtype>& state) {
+  CHECK_GE(n, 0);
+  CHECK_LT(n, N_);
+  CHECK_EQ(StreamStateCount(), state.count())
+      << "The state is not of a stream of this layer.";
+  const Dtype* state_data = state.cpu_data();
+  for (int i = 0; i < recur_output_blobs_.size(); ++i) {
+    const int count = recur_output_blobs_[i]->count(2);
+    caffe_copy(count, state_data,
+               recur_output_blobs_[i]->mutable_cpu_data() + n * count);
+    state_data += count;
+  }
+}
+
 template <typename Dtype>
 void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -263,7 +319,11 @@ void RecurrentLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
   }
 
-  unrolled_net_->ForwardTo(last_layer_index_);
+  if (fused_) {
+    FusedForward_cpu(bottom, top);
+  } else {
+    unrolled_net_->ForwardTo(last_layer_index_);
+  }
 
   if (expose_hidden_) {
     const int top_offset = output_blobs_.size();
@@ -277,6 +337,11 @@ template <typename Dtype>
 void RecurrentLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
   CHECK(!propagate_down[1]) << "Cannot backpropagate to sequence indicators.";
+  // On GPU, where Forward ran the unrolled net, so must Backward.
+  if (fused_ && Caffe::mode() == Caffe::CPU) {
+    FusedBackward_cpu(top, propagate_down, bottom);
+    return;
+  }
 
   // TODO: skip backpropagation to inputs and parameters inside the unrolled
   // net according to propagate_down[0] and propagate_down[2]. For now just
@@ -230,6 +230,193 @@ void RNNLayer<Dtype>::FillUnrolledNet(NetParameter* net_param) const {
   net_param->add_layer()->CopyFrom(output_concat_layer);
 }
 
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedForward_cpu(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int num_output = this->layer_param_.recurrent_param().num_output();
+  const int input_dim = bottom[0]->count(2);
+  const int s = this->static_input_;
+  vector<int> shape(3);
+  shape[0] = T;
+  shape[1] = N;
+  shape[2] = num_output;
+  hidden_.Reshape(shape);
+  h_conted_.Reshape(shape);
+  shape.resize(1);
+  shape[0] = T * N;
+  if (bias_multiplier_.count() != T * N) {
+    bias_multiplier_.Reshape(shape);
+    caffe_set(T * N, Dtype(1), bias_multiplier_.mutable_cpu_data());
+  }
+  const Dtype* cont = bottom[1]->cpu_data();
+  const Dtype* W_hh = this->blobs_[2 + s]->cpu_data();
+  Dtype* hidden = hidden_.mutable_cpu_data();
+
+  // Transform all timesteps of x at once.
+  //     W_xh_x = W_xh * x + b_h
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, T * N, num_output,
+      input_dim, Dtype(1), bottom[0]->cpu_data(), this->blobs_[0]->cpu_data(),
+      Dtype(0), hidden);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T * N, num_output, 1,
+      Dtype(1), bias_multiplier_.cpu_data(), this->blobs_[1]->cpu_data(),
+      Dtype(1), hidden);
+  if (this->static_input_) {
+    //     W_xh_x_static = W_xh_static * x_static
+    shape.resize(2);
+    shape[0] = N;
+    shape[1] = num_output;
+    static_hidden_.Reshape(shape);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, num_output,
+        bottom[2]->count(1), Dtype(1), bottom[2]->cpu_data(),
+        this->blobs_[2]->cpu_data(), Dtype(0),
+        static_hidden_.mutable_cpu_data());
+  }
+
+  const Dtype* h_prev = this->recur_input_blobs_[0]->cpu_data();
+  Dtype* h_conted = h_conted_.mutable_cpu_data();
+  for (int t = 0; t < T; ++t) {
+    //     h_conted_{t-1} := cont_t * h_{t-1}
+    for (int n = 0; n < N; ++n) {
+      caffe_cpu_scale(num_output, cont[n], h_prev + n * num_output,
+          h_conted + n * num_output);
+    }
+    //     h_t := \tanh( W_hh * h_conted_{t-1} + W_xh * x_t + b_h )
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, num_output,
+        num_output, Dtype(1), h_conted, W_hh, Dtype(1), hidden);
+    if (this->static_input_) {
+      caffe_axpy(N * num_output, Dtype(1), static_hidden_.cpu_data(), hidden);
+    }
+    for (int i = 0; i < N * num_output; ++i) {
+      hidden[i] = tanh(hidden[i]);
+    }
+    h_prev = hidden;
+    cont += N;
+    hidden += N * num_output;
+    h_conted += N * num_output;
+  }
+  caffe_copy(N * num_output, h_prev,
+      this->recur_output_blobs_[0]->mutable_cpu_data());
+
+  // The outputs of all timesteps at once.
+  //     o := \tanh( W_ho * h + b_o )
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, T * N, num_output,
+      num_output, Dtype(1), hidden_.cpu_data(),
+      this->blobs_[3 + s]->cpu_data(), Dtype(0), top_data);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T * N, num_output, 1,
+      Dtype(1), bias_multiplier_.cpu_data(), this->blobs_[4 + s]->cpu_data(),
+      Dtype(1), top_data);
+  for (int i = 0; i < top[0]->count(); ++i) {
+    top_data[i] = tanh(top_data[i]);
+  }
+}
+
+template <typename Dtype>
+void RNNLayer<Dtype>::FusedBackward_cpu(const vector<Blob<Dtype>*>& top,
+    const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  const int T = this->T_;
+  const int N = this->N_;
+  const int num_output = this->layer_param_.recurrent_param().num_output();
+  const int input_dim = bottom[0]->count(2);
+  const int s = this->static_input_;
+  const int W_hh_index = 2 + s;
+  const int W_ho_index = 3 + s;
+  const int b_o_index = 4 + s;
+
+  // Through the output tanh, then W_ho, for all timesteps at once.
+  output_diff_.ReshapeLike(*top[0]);
+  Dtype* output_diff = output_diff_.mutable_cpu_data();
+  const Dtype* top_data = top[0]->cpu_data();
+  const Dtype* top_diff = top[0]->cpu_diff();
+  for (int i = 0; i < top[0]->count(); ++i) {
+    output_diff[i] = top_diff[i] * (1 - top_data[i] * top_data[i]);
+  }
+  if (this->param_propagate_down(W_ho_index)) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, num_output, num_output,
+        T * N, Dtype(1), output_diff, hidden_.cpu_data(), Dtype(1),
+        this->blobs_[W_ho_index]->mutable_cpu_diff());
+  }
+  if (this->param_propagate_down(b_o_index)) {
+    caffe_cpu_gemv<Dtype>(CblasTrans, T * N, num_output, Dtype(1),
+        output_diff, bias_multiplier_.cpu_data(), Dtype(1),
+        this->blobs_[b_o_index]->mutable_cpu_diff());
+  }
+  Dtype* hidden_diff = hidden_.mutable_cpu_diff();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T * N, num_output,
+      num_output, Dtype(1), output_diff, this->blobs_[W_ho_index]->cpu_data(),
+      Dtype(0), hidden_diff);
+
+  // Back in time through the hidden state; hidden_diff becomes the gradient
+  // w.r.t. the input to the hidden tanh.
+  vector<int> shape(2);
+  shape[0] = N;
+  shape[1] = num_output;
+  h_diff_.Reshape(shape);
+  Dtype* h_next_diff = h_diff_.mutable_cpu_data();
+  caffe_set(N * num_output, Dtype(0), h_next_diff);
+  const Dtype* W_hh = this->blobs_[W_hh_index]->cpu_data();
+  for (int t = T - 1; t >= 0; --t) {
+    const Dtype* cont = bottom[1]->cpu_data() + t * N;
+    const Dtype* hidden = hidden_.cpu_data() + t * N * num_output;
+    Dtype* pre_diff = hidden_diff + t * N * num_output;
+    Dtype* h_conted_diff = h_conted_.mutable_cpu_diff() + t * N * num_output;
+    for (int i = 0; i < N * num_output; ++i) {
+      pre_diff[i] = (pre_diff[i] + h_next_diff[i]) *
+          (1 - hidden[i] * hidden[i]);
+    }
+    //     h_{t-1} diff := cont_t * W_hh^T * h_neuron_input_t diff
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, num_output,
+        num_output, Dtype(1), pre_diff, W_hh, Dtype(0), h_conted_diff);
+    for (int n = 0; n < N; ++n) {
+      caffe_cpu_scale(num_output, cont[n], h_conted_diff + n * num_output,
+          h_next_diff + n * num_output);
+    }
+  }
+
+  if (this->param_propagate_down(W_hh_index)) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, num_output, num_output,
+        T * N, Dtype(1), hidden_diff, h_conted_.cpu_data(), Dtype(1),
+        this->blobs_[W_hh_index]->mutable_cpu_diff());
+  }
+  if (this->param_propagate_down(0)) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, num_output, input_dim,
+        T * N, Dtype(1), hidden_diff, bottom[0]->cpu_data(), Dtype(1),
+        this->blobs_[0]->mutable_cpu_diff());
+  }
+  if (this->param_propagate_down(1)) {
+    caffe_cpu_gemv<Dtype>(CblasTrans, T * N, num_output, Dtype(1),
+        hidden_diff, bias_multiplier_.cpu_data(), Dtype(1),
+        this->blobs_[1]->mutable_cpu_diff());
+  }
+  if (propagate_down[0]) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T * N, input_dim,
+        num_output, Dtype(1), hidden_diff, this->blobs_[0]->cpu_data(),
+        Dtype(0), bottom[0]->mutable_cpu_diff());
+  }
+  if (this->static_input_) {
+    // The static input adds to the hidden input of every timestep.
+    const int static_dim = bottom[2]->count(1);
+    Dtype* static_diff = static_hidden_.mutable_cpu_diff();
+    caffe_copy(N * num_output, hidden_diff, static_diff);
+    for (int t = 1; t < T; ++t) {
+      caffe_axpy(N * num_output, Dtype(1), hidden_diff + t * N * num_output,
+          static_diff);
+    }
+    if (this->param_propagate_down(2)) {
+      caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, num_output, static_dim,
+          N, Dtype(1), static_diff, bottom[2]->cpu_data(), Dtype(1),
+          this->blobs_[2]->mutable_cpu_diff());
+    }
+    if (propagate_down[2]) {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, static_dim,
+          num_output, Dtype(1), static_diff, this->blobs_[2]->cpu_data(),
+          Dtype(0), bottom[2]->mutable_cpu_diff());
+    }
+  }
+}
+
 INSTANTIATE_CLASS(RNNLayer);
 REGISTER_LAYER_CLASS(RNN);
 
@@ -0,0 +1,121 @@
+#include <boost/bind.hpp>
+#include <vector>
+
+#include "caffe/layers/threaded_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void ThreadedConvolutionLayer<Dtype>::PrepareColBuffers(int num_threads) {
+  while (col_buffers_.size() < num_threads) {
+    col_buffers_.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+  }
+  // Buffers are allocated on first use, so idle threads cost no memory.
+  const vector<int> col_shape(1, this->col_buffer_count());
+  for (int i = 0; i < col_buffers_.size(); ++i) {
+    col_buffers_[i]->Reshape(col_shape);
+  }
+}
+
+template <typename Dtype>
+void ThreadedConvolutionLayer<Dtype>::ForwardImage(const Dtype* bottom_data,
+    const Dtype* weight, Dtype* top_data, int n, int slot) {
+  Dtype* col_buff = this->is_1x1_ ? NULL :
+      col_buffers_[slot]->mutable_cpu_data();
+  this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+      top_data + n * this->top_dim_, col_buff, false);
+  if (this->bias_term_) {
+    const Dtype* bias = this->blobs_[1]->cpu_data();
+    this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+  }
+}
+
+template <typename Dtype>
+void ThreadedConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ThreadPool& pool = ThreadPool::Global();
+  PrepareColBuffers(pool.num_threads());
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (this->bias_term_) {
+    // Sync the shared blobs before the threads read them.
+    this->blobs_[1]->cpu_data();
+  }
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    pool.Run(this->num_, boost::bind(
+        &ThreadedConvolutionLayer<Dtype>::ForwardImage, this, bottom_data,
+        weight, top_data, _1, _2));
+  }
+}
+
+template <typename Dtype>
+void ThreadedConvolutionLayer<Dtype>::BackwardImage(const Dtype* top_diff,
+    const Dtype* bottom_data, const Dtype* weight, Dtype* bottom_diff,
+    bool propagate_down, int n, int slot) {
+  Dtype* col_buff = this->is_1x1_ ? NULL :
+      col_buffers_[slot]->mutable_cpu_data();
+  // gradient w.r.t. weight, accumulated in the thread's own buffer.
+  if (this->param_propagate_down_[0]) {
+    this->weight_cpu_gemm(bottom_data + n * this->bottom_dim_,
+        top_diff + n * this->top_dim_,
+        weight_diff_buffers_[slot]->mutable_cpu_data(), col_buff);
+  }
+  // gradient w.r.t. bottom data, if necessary.
+  if (propagate_down) {
+    this->backward_cpu_gemm(top_diff + n * this->top_dim_, weight,
+        bottom_diff + n * this->bottom_dim_, col_buff);
+  }
+}
+
+template <typename Dtype>
+void ThreadedConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  ThreadPool& pool = ThreadPool::Global();
+  PrepareColBuffers(pool.num_threads());
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+  if (this->param_propagate_down_[0]) {
+    while (weight_diff_buffers_.size() < pool.num_threads()) {
+      weight_diff_buffers_.push_back(
+          shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+    }
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    const Dtype* top_diff = top[i]->cpu_diff();
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
+    // Bias gradient, if necessary.
+    if (this->bias_term_ && this->param_propagate_down_[1]) {
+      Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+      for (int n = 0; n < this->num_; ++n) {
+        this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+      }
+    }
+    if (this->param_propagate_down_[0] || propagate_down[i]) {
+      if (this->param_propagate_down_[0]) {
+        for (int j = 0; j < weight_diff_buffers_.size(); ++j) {
+          weight_diff_buffers_[j]->ReshapeLike(*this->blobs_[0]);
+          caffe_set(weight_diff_buffers_[j]->count(), Dtype(0),
+              weight_diff_buffers_[j]->mutable_cpu_data());
+        }
+      }
+      pool.Run(this->num_, boost::bind(
+          &ThreadedConvolutionLayer<Dtype>::BackwardImage, this, top_diff,
+          bottom_data, weight, bottom_diff, propagate_down[i], _1, _2));
+      if (this->param_propagate_down_[0]) {
+        for (int j = 0; j < weight_diff_buffers_.size(); ++j) {
+          caffe_axpy(this->blobs_[0]->count(), Dtype(1),
+              weight_diff_buffers_[j]->cpu_data(), weight_diff);
+        }
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(ThreadedConvolutionLayer);
+
+}  // namespace caffe
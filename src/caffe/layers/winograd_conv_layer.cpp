@@ -0,0 +1,421 @@
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Transform matrices of F(2x2, 3x3) and F(4x4, 3x3), from A. Lavin and
+// S. Gray, "Fast Algorithms for Convolutional Neural Networks".
+const double kBT2[4 * 4] = {
+  1,  0, -1,  0,
+  0,  1,  1,  0,
+  0, -1,  1,  0,
+  0,  1,  0, -1 };
+const double kG2[4 * 3] = {
+  1,    0,   0,
+  0.5,  0.5, 0.5,
+  0.5, -0.5, 0.5,
+  0,    0,   1 };
+const double kAT2[2 * 4] = {
+  1, 1,  1,  0,
+  0, 1, -1, -1 };
+
+const double kBT4[6 * 6] = {
+  4,  0, -5,  0, 1, 0,
+  0, -4, -4,  1, 1, 0,
+  0,  4, -4, -1, 1, 0,
+  0, -2, -1,  2, 1, 0,
+  0,  2, -1, -2, 1, 0,
+  0,  4,  0, -5, 0, 1 };
+const double kG4[6 * 3] = {
+  1. / 4,   0,        0,
+  -1. / 6,  -1. / 6,  -1. / 6,
+  -1. / 6,  1. / 6,   -1. / 6,
+  1. / 24,  1. / 12,  1. / 6,
+  1. / 24,  -1. / 12, 1. / 6,
+  0,        0,        1 };
+const double kAT4[4 * 6] = {
+  1, 1,  1, 1,  1, 0,
+  0, 1, -1, 2, -2, 0,
+  0, 1,  1, 4,  4, 0,
+  0, 1, -1, 8, -8, 1 };
+
+const int kMaxAlpha = 6;
+
+template <typename Dtype>
+void CopyMatrix(const double* src, int rows, int cols, vector<Dtype>* dst,
+    vector<Dtype>* dst_transposed) {
+  dst->resize(rows * cols);
+  dst_transposed->resize(rows * cols);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      (*dst)[r * cols + c] = src[r * cols + c];
+      (*dst_transposed)[c * rows + r] = src[r * cols + c];
+    }
+  }
+}
+
+// out = L x L^T, with L rows x cols and x cols x cols.
+template <typename Dtype>
+void Sandwich(const Dtype* L, int rows, int cols, const Dtype* x,
+    Dtype* out) {
+  Dtype lx[kMaxAlpha * kMaxAlpha];
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      Dtype sum = 0;
+      for (int k = 0; k < cols; ++k) {
+        sum += L[r * cols + k] * x[k * cols + c];
+      }
+      lx[r * cols + c] = sum;
+    }
+  }
+  for (int r = 0; r < rows; ++r) {
+    for (int s = 0; s < rows; ++s) {
+      Dtype sum = 0;
+      for (int k = 0; k < cols; ++k) {
+        sum += lx[r * cols + k] * L[s * cols + k];
+      }
+      out[r * rows + s] = sum;
+    }
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::LayerSetUp(bottom, top);
+  tile_ = this->layer_param_.convolution_param().winograd_tile();
+  CHECK(tile_ == 2 || tile_ == 4) << "winograd_tile must be 2 or 4.";
+  alpha_ = tile_ + 2;
+  if (tile_ == 2) {
+    CopyMatrix(kBT2, alpha_, alpha_, &bt_, &b_);
+    CopyMatrix(kG2, alpha_, 3, &g_, &gt_);
+    CopyMatrix(kAT2, tile_, alpha_, &at_, &a_);
+  } else {
+    CopyMatrix(kBT4, alpha_, alpha_, &bt_, &b_);
+    CopyMatrix(kG4, alpha_, 3, &g_, &gt_);
+    CopyMatrix(kAT4, tile_, alpha_, &at_, &a_);
+  }
+  weight_tracker_.Reset();
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  use_winograd_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_;
+  for (int i = 0; i < this->num_spatial_axes_; ++i) {
+    use_winograd_ &= this->kernel_shape_.cpu_data()[i] == 3 &&
+        this->stride_.cpu_data()[i] == 1 &&
+        this->dilation_.cpu_data()[i] == 1;
+  }
+  if (!use_winograd_) {
+    return;
+  }
+  in_per_group_ = this->channels_ / this->group_;
+  out_per_group_ = this->num_output_ / this->group_;
+  tiles_h_ = (this->output_shape_[0] + tile_ - 1) / tile_;
+  tiles_w_ = (this->output_shape_[1] + tile_ - 1) / tile_;
+  num_tiles_ = tiles_h_ * tiles_w_;
+  const int positions = alpha_ * alpha_;
+  transformed_weights_.Reshape(1, this->group_ * positions, out_per_group_,
+      in_per_group_);
+  v_buffer_.Reshape(1, positions, in_per_group_, num_tiles_);
+  m_buffer_.Reshape(1, positions, out_per_group_, num_tiles_);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformWeights() {
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (!weight_tracker_.Changed(weights)) {
+    return;
+  }
+  const int positions = alpha_ * alpha_;
+  const Dtype* weight = weights.cpu_data();
+  Dtype* u = transformed_weights_.mutable_cpu_data();
+  Dtype transformed[kMaxAlpha * kMaxAlpha];
+  for (int g = 0; g < this->group_; ++g) {
+    for (int o = 0; o < out_per_group_; ++o) {
+      for (int c = 0; c < in_per_group_; ++c) {
+        const Dtype* filter =
+            weight + ((g * out_per_group_ + o) * in_per_group_ + c) * 9;
+        Sandwich(g_.data(), alpha_, 3, filter, transformed);
+        for (int p = 0; p < positions; ++p) {
+          u[((g * positions + p) * out_per_group_ + o) * in_per_group_ + c] =
+              transformed[p];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformInput(const Dtype* input,
+    Dtype* v) {
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int positions = alpha_ * alpha_;
+  Dtype d[kMaxAlpha * kMaxAlpha];
+  Dtype transformed[kMaxAlpha * kMaxAlpha];
+  for (int c = 0; c < in_per_group_; ++c) {
+    const Dtype* channel = input + c * height * width;
+    for (int th = 0; th < tiles_h_; ++th) {
+      for (int tw = 0; tw < tiles_w_; ++tw) {
+        const int h0 = th * tile_ - pad_h;
+        const int w0 = tw * tile_ - pad_w;
+        for (int i = 0; i < alpha_; ++i) {
+          for (int j = 0; j < alpha_; ++j) {
+            const int h = h0 + i;
+            const int w = w0 + j;
+            d[i * alpha_ + j] = (h >= 0 && h < height && w >= 0 && w < width) ?
+                channel[h * width + w] : Dtype(0);
+          }
+        }
+        Sandwich(bt_.data(), alpha_, alpha_, d, transformed);
+        const int t = th * tiles_w_ + tw;
+        for (int p = 0; p < positions; ++p) {
+          v[(p * in_per_group_ + c) * num_tiles_ + t] = transformed[p];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformOutput(const Dtype* m,
+    const Dtype* bias, Dtype* output) {
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int positions = alpha_ * alpha_;
+  Dtype tile[kMaxAlpha * kMaxAlpha];
+  Dtype y[kMaxAlpha * kMaxAlpha];
+  for (int o = 0; o < out_per_group_; ++o) {
+    Dtype* channel = output + o * output_h * output_w;
+    const Dtype bias_value = bias ? bias[o] : Dtype(0);
+    for (int th = 0; th < tiles_h_; ++th) {
+      for (int tw = 0; tw < tiles_w_; ++tw) {
+        const int t = th * tiles_w_ + tw;
+        for (int p = 0; p < positions; ++p) {
+          tile[p] = m[(p * out_per_group_ + o) * num_tiles_ + t];
+        }
+        Sandwich(at_.data(), tile_, alpha_, tile, y);
+        for (int i = 0; i < tile_ && th * tile_ + i < output_h; ++i) {
+          for (int j = 0; j < tile_ && tw * tile_ + j < output_w; ++j) {
+            channel[(th * tile_ + i) * output_w + tw * tile_ + j] =
+                this->fused_relu(y[i * tile_ + j] + bias_value);
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformOutputDiff(
+    const Dtype* top_diff, Dtype* m) {
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int positions = alpha_ * alpha_;
+  Dtype dy[kMaxAlpha * kMaxAlpha];
+  Dtype transformed[kMaxAlpha * kMaxAlpha];
+  for (int o = 0; o < out_per_group_; ++o) {
+    const Dtype* channel = top_diff + o * output_h * output_w;
+    for (int th = 0; th < tiles_h_; ++th) {
+      for (int tw = 0; tw < tiles_w_; ++tw) {
+        for (int i = 0; i < tile_; ++i) {
+          for (int j = 0; j < tile_; ++j) {
+            const int h = th * tile_ + i;
+            const int w = tw * tile_ + j;
+            dy[i * tile_ + j] = (h < output_h && w < output_w) ?
+                channel[h * output_w + w] : Dtype(0);
+          }
+        }
+        Sandwich(a_.data(), alpha_, tile_, dy, transformed);
+        const int t = th * tiles_w_ + tw;
+        for (int p = 0; p < positions; ++p) {
+          m[(p * out_per_group_ + o) * num_tiles_ + t] = transformed[p];
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::TransformInputDiff(const Dtype* v,
+    Dtype* bottom_diff) {
+  const int height = this->conv_input_shape_.cpu_data()[1];
+  const int width = this->conv_input_shape_.cpu_data()[2];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int positions = alpha_ * alpha_;
+  Dtype dv[kMaxAlpha * kMaxAlpha];
+  Dtype dd[kMaxAlpha * kMaxAlpha];
+  for (int c = 0; c < in_per_group_; ++c) {
+    Dtype* channel = bottom_diff + c * height * width;
+    for (int th = 0; th < tiles_h_; ++th) {
+      for (int tw = 0; tw < tiles_w_; ++tw) {
+        const int t = th * tiles_w_ + tw;
+        for (int p = 0; p < positions; ++p) {
+          dv[p] = v[(p * in_per_group_ + c) * num_tiles_ + t];
+        }
+        Sandwich(b_.data(), alpha_, alpha_, dv, dd);
+        // Input tiles overlap, so their gradients add up.
+        const int h0 = th * tile_ - pad_h;
+        const int w0 = tw * tile_ - pad_w;
+        for (int i = 0; i < alpha_; ++i) {
+          const int h = h0 + i;
+          if (h < 0 || h >= height) {
+            continue;
+          }
+          for (int j = 0; j < alpha_; ++j) {
+            const int w = w0 + j;
+            if (w >= 0 && w < width) {
+              channel[h * width + w] += dd[i * alpha_ + j];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  TransformWeights();
+  const int positions = alpha_ * alpha_;
+  const int in_group_dim = this->bottom_dim_ / this->group_;
+  const int out_group_dim = this->top_dim_ / this->group_;
+  const Dtype* u = transformed_weights_.cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  Dtype* v = v_buffer_.mutable_cpu_data();
+  Dtype* m = m_buffer_.mutable_cpu_data();
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      for (int g = 0; g < this->group_; ++g) {
+        TransformInput(bottom_data + n * this->bottom_dim_ + g * in_group_dim,
+            v);
+        // One GEMM per transformed position reduces over input channels.
+        for (int p = 0; p < positions; ++p) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, out_per_group_,
+              num_tiles_, in_per_group_, (Dtype)1.,
+              u + (g * positions + p) * out_per_group_ * in_per_group_,
+              v + p * in_per_group_ * num_tiles_, (Dtype)0.,
+              m + p * out_per_group_ * num_tiles_);
+        }
+        TransformOutput(m, bias ? bias + g * out_per_group_ : NULL,
+            top_data + n * this->top_dim_ + g * out_group_dim);
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Backward_cpu(
+    const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Backward_cpu(top, propagate_down, bottom);
+    return;
+  }
+  TransformWeights();
+  const int positions = alpha_ * alpha_;
+  const int in_group_dim = this->bottom_dim_ / this->group_;
+  const int out_group_dim = this->top_dim_ / this->group_;
+  const Dtype* u = transformed_weights_.cpu_data();
+  Dtype* v = v_buffer_.mutable_cpu_data();
+  Dtype* m = m_buffer_.mutable_cpu_data();
+  const bool weight_propagate_down = this->param_propagate_down_[0];
+  Dtype* du = NULL;
+  if (weight_propagate_down) {
+    transformed_weight_diff_.ReshapeLike(transformed_weights_);
+    du = transformed_weight_diff_.mutable_cpu_data();
+    caffe_set(transformed_weight_diff_.count(), Dtype(0), du);
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    const Dtype* top_diff = top[i]->cpu_diff();
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    // Bias gradient, if necessary.
+    if (this->bias_term_ && this->param_propagate_down_[1]) {
+      Dtype* bias_diff = this->blobs_[1]->mutable_cpu_diff();
+      for (int n = 0; n < this->num_; ++n) {
+        this->backward_cpu_bias(bias_diff, top_diff + n * this->top_dim_);
+      }
+    }
+    if (!weight_propagate_down && !propagate_down[i]) {
+      continue;
+    }
+    Dtype* bottom_diff = propagate_down[i] ? bottom[i]->mutable_cpu_diff() :
+        NULL;
+    if (bottom_diff) {
+      caffe_set(bottom[i]->count(), Dtype(0), bottom_diff);
+    }
+    for (int n = 0; n < this->num_; ++n) {
+      for (int g = 0; g < this->group_; ++g) {
+        TransformOutputDiff(
+            top_diff + n * this->top_dim_ + g * out_group_dim, m);
+        if (weight_propagate_down) {
+          TransformInput(
+              bottom_data + n * this->bottom_dim_ + g * in_group_dim, v);
+          for (int p = 0; p < positions; ++p) {
+            caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, out_per_group_,
+                in_per_group_, num_tiles_, (Dtype)1.,
+                m + p * out_per_group_ * num_tiles_,
+                v + p * in_per_group_ * num_tiles_, (Dtype)1.,
+                du + (g * positions + p) * out_per_group_ * in_per_group_);
+          }
+        }
+        if (bottom_diff) {
+          for (int p = 0; p < positions; ++p) {
+            caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, in_per_group_,
+                num_tiles_, out_per_group_, (Dtype)1.,
+                u + (g * positions + p) * out_per_group_ * in_per_group_,
+                m + p * out_per_group_ * num_tiles_, (Dtype)0.,
+                v + p * in_per_group_ * num_tiles_);
+          }
+          TransformInputDiff(v,
+              bottom_diff + n * this->bottom_dim_ + g * in_group_dim);
+        }
+      }
+    }
+  }
+  if (weight_propagate_down) {
+    // Back from the transformed domain: since U = G g G^T, dg = G^T dU G.
+    Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+    Dtype tile[kMaxAlpha * kMaxAlpha];
+    Dtype dg[3 * 3];
+    for (int g = 0; g < this->group_; ++g) {
+      for (int o = 0; o < out_per_group_; ++o) {
+        for (int c = 0; c < in_per_group_; ++c) {
+          for (int p = 0; p < positions; ++p) {
+            tile[p] = du[((g * positions + p) * out_per_group_ + o) *
+                in_per_group_ + c];
+          }
+          Sandwich(gt_.data(), 3, alpha_, tile, dg);
+          Dtype* filter_diff = weight_diff +
+              ((g * out_per_group_ + o) * in_per_group_ + c) * 9;
+          for (int k = 0; k < 9; ++k) {
+            filter_diff[k] += dg[k];
+          }
+        }
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
@@ -1,6 +1,8 @@
 #include <algorithm>
+#include <cmath>
 #include <map>
 #include <set>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -9,9 +11,12 @@
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_conv_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/graph_optimizer.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -49,9 +54,21 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
-  // Create a copy of filtered_param with splits added where necessary.
+  // Run the enabled graph optimizer passes.
+  NetParameter optimized_param;
+  OptimizeGraph(filtered_param, &optimized_param);
+  // Create a copy of optimized_param with splits added where necessary.
   NetParameter param;
-  InsertSplits(filtered_param, &param);
+  InsertSplits(optimized_param, &param);
+  fusion_layers_.clear();
+  if (param.fuse_convolution()) {
+    if (phase_ == TEST && !param.force_backward()) {
+      PlanConvolutionFusion(&param);
+    } else {
+      LOG(WARNING) << "Ignoring fuse_convolution: it only applies to TEST "
+                   << "phase nets without force_backward.";
+    }
+  }
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
   map<string, int> blob_name_to_idx;
@@ -270,10 +287,507 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  SetUpConvolutionFusion();
   debug_info_ = param.debug_info();
+  optimize_memory_ = param.optimize_memory();
+  if (optimize_memory_ && (phase_ != TEST || param.force_backward())) {
+    LOG(WARNING) << "Ignoring optimize_memory: it only applies to TEST phase "
+                 << "nets without force_backward.";
+    optimize_memory_ = false;
+  }
+  if (optimize_memory_) {
+    OptimizeMemory(true);
+  }
+  segment_begin_.clear();
+  recompute_time_ = 0;
+  if (param.has_checkpoint_param()) {
+    if (phase_ == TRAIN) {
+      PlanCheckpoints(param.checkpoint_param());
+    } else {
+      LOG(WARNING) << "Ignoring checkpoint_param: it only applies to TRAIN "
+                   << "phase nets.";
+    }
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
 
+// Helper for Net::Init and Net::Reshape: share memory among top blobs whose
+// lifetimes, measured in layer indices from the first to the last layer that
+// touches them, do not overlap.
+template <typename Dtype>
+void Net<Dtype>::OptimizeMemory(bool log_plan) {
+  const int num_blobs = blobs_.size();
+  const int num_layers = layers_.size();
+  // Layers such as Split, Flatten and Reshape make their tops share memory
+  // with their bottoms; such blobs are grouped and planned as one.
+  vector<int> group(num_blobs);
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    group[blob_id] = blob_id;
+  }
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      const Blob<Dtype>* top = top_vecs_[layer_id][top_id];
+      for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+           ++bottom_id) {
+        const Blob<Dtype>* bottom = bottom_vecs_[layer_id][bottom_id];
+        // Empty blobs have no memory to compare, so they are skipped first.
+        if (top == bottom || top->count() == 0 || bottom->count() == 0) {
+          continue;
+        }
+        const bool shares_data = top->data() == bottom->data() ||
+            (bottom_id == 0 && layers_[layer_id]->TopsShareBottomData());
+        if (!shares_data) {
+          continue;
+        }
+        int top_group = top_id_vecs_[layer_id][top_id];
+        while (group[top_group] != top_group) { top_group = group[top_group]; }
+        int bottom_group = bottom_id_vecs_[layer_id][bottom_id];
+        while (group[bottom_group] != bottom_group) {
+          bottom_group = group[bottom_group];
+        }
+        group[std::max(top_group, bottom_group)] =
+            std::min(top_group, bottom_group);
+      }
+    }
+  }
+  // Lifetime and size of every group. Net outputs live past the last layer,
+  // and the tops of layers without bottoms (data and input layers, which may
+  // fill or replace their memory from outside) are never planned.
+  vector<int> first_use(num_blobs, num_layers);
+  vector<int> last_use(num_blobs, -1);
+  vector<size_t> group_bytes(num_blobs, 0);
+  vector<bool> pinned(num_blobs, false);
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    while (group[group[blob_id]] != group[blob_id]) {
+      group[blob_id] = group[group[blob_id]];
+    }
+  }
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int g = group[bottom_id_vecs_[layer_id][i]];
+      first_use[g] = std::min(first_use[g], layer_id);
+      last_use[g] = std::max(last_use[g], layer_id);
+    }
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int g = group[top_id_vecs_[layer_id][i]];
+      first_use[g] = std::min(first_use[g], layer_id);
+      last_use[g] = std::max(last_use[g], layer_id);
+      if (bottom_vecs_[layer_id].empty()) { pinned[g] = true; }
+    }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    last_use[group[net_output_blob_indices_[i]]] = num_layers;
+  }
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    pinned[group[net_input_blob_indices_[i]]] = true;
+  }
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const size_t bytes = blobs_[blob_id]->count() * sizeof(Dtype);
+    group_bytes[group[blob_id]] = std::max(group_bytes[group[blob_id]], bytes);
+  }
+  size_t unplanned_bytes = 0;
+  size_t pinned_bytes = 0;
+  vector<pair<int, int> > order;
+  for (int g = 0; g < num_blobs; ++g) {
+    if (group[g] != g || group_bytes[g] == 0) { continue; }
+    unplanned_bytes += group_bytes[g];
+    if (pinned[g]) {
+      pinned_bytes += group_bytes[g];
+    } else {
+      order.push_back(make_pair(first_use[g], g));
+    }
+  }
+  // Greedily assign groups, in order of first use, to the smallest buffer
+  // that is free by then and large enough, or else grow the largest free one.
+  std::sort(order.begin(), order.end());
+  vector<size_t> buffer_bytes;
+  vector<int> buffer_free_after;
+  vector<int> group_buffer(num_blobs, -1);
+  for (int i = 0; i < order.size(); ++i) {
+    const int g = order[i].second;
+    int best = -1;
+    for (int b = 0; b < buffer_bytes.size(); ++b) {
+      if (buffer_free_after[b] >= first_use[g]) { continue; }
+      if (best < 0) {
+        best = b;
+        continue;
+      }
+      const bool fits = buffer_bytes[b] >= group_bytes[g];
+      const bool best_fits = buffer_bytes[best] >= group_bytes[g];
+      if ((fits && (!best_fits || buffer_bytes[b] < buffer_bytes[best])) ||
+          (!fits && !best_fits && buffer_bytes[b] > buffer_bytes[best])) {
+        best = b;
+      }
+    }
+    if (best < 0) {
+      best = buffer_bytes.size();
+      buffer_bytes.push_back(0);
+      buffer_free_after.push_back(-1);
+    }
+    buffer_bytes[best] = std::max(buffer_bytes[best], group_bytes[g]);
+    buffer_free_after[best] = last_use[g];
+    group_buffer[g] = best;
+  }
+  activation_buffers_.clear();
+  size_t planned_bytes = pinned_bytes;
+  for (int b = 0; b < buffer_bytes.size(); ++b) {
+    activation_buffers_.push_back(
+        shared_ptr<SyncedMemory>(new SyncedMemory(buffer_bytes[b])));
+    planned_bytes += buffer_bytes[b];
+  }
+  int num_planned = 0;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    const int b = group_buffer[group[blob_id]];
+    if (b < 0 || blobs_[blob_id]->count() == 0) { continue; }
+    blobs_[blob_id]->ShareDataMemory(activation_buffers_[b]);
+    ++num_planned;
+  }
+  std::ostringstream plan;
+  plan << "Memory optimization: " << num_planned << " blobs in "
+       << activation_buffers_.size() << " shared buffers; memory required for "
+       << "data reduced from " << unplanned_bytes << " to " << planned_bytes;
+  if (log_plan) {
+    LOG_IF(INFO, Caffe::root_solver()) << plan.str();
+  } else {
+    VLOG(1) << plan.str();
+  }
+}
+
+// Helper for Net::Init: split the layers into segments and pick the blobs
+// that can be dropped after a segment's Forward and recomputed from the blobs
+// kept at the segment boundaries during Backward.
+template <typename Dtype>
+void Net<Dtype>::PlanCheckpoints(const CheckpointParameter& param) {
+  const int num_layers = layers_.size();
+  const int num_blobs = blobs_.size();
+  if (num_layers == 0) { return; }
+  set<string> checkpoint_layers(param.layer().begin(), param.layer().end());
+  for (set<string>::const_iterator it = checkpoint_layers.begin();
+       it != checkpoint_layers.end(); ++it) {
+    CHECK(layer_names_index_.count(*it))
+        << "Unknown checkpoint layer " << *it;
+  }
+  int segment_size = param.segment_size();
+  if (segment_size == 0 && checkpoint_layers.empty()) {
+    segment_size = static_cast<int>(std::ceil(std::sqrt(
+        static_cast<double>(num_layers))));
+  }
+  layer_segment_.resize(num_layers);
+  segment_begin_.assign(1, 0);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    layer_segment_[layer_id] = segment_begin_.size() - 1;
+    const bool segment_full = segment_size > 0 &&
+        layer_id + 1 - segment_begin_.back() == segment_size;
+    if ((segment_full || checkpoint_layers.count(layer_names_[layer_id])) &&
+        layer_id + 1 < num_layers) {
+      segment_begin_.push_back(layer_id + 1);
+    }
+  }
+  const int num_segments = segment_begin_.size();
+  // A blob can be dropped if all the layers touching it lie in one segment,
+  // other than the last one whose activations Backward needs right away, and
+  // it is produced by layers that can rerun. Net inputs and outputs are kept,
+  // as are blobs already sharing memory with another blob (Reshape, or the
+  // internal nets of Recurrent layers).
+  vector<int> blob_segment(num_blobs, -1);
+  vector<int> last_writer(num_blobs, -1);
+  vector<bool> releasable(num_blobs, true);
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    const int segment = layer_segment_[layer_id];
+    for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+      const int blob_id = bottom_id_vecs_[layer_id][i];
+      if (blob_segment[blob_id] != segment) { releasable[blob_id] = false; }
+    }
+    const bool can_rerun = !bottom_vecs_[layer_id].empty() &&
+        layers_[layer_id]->AllowRecompute();
+    for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+      const int blob_id = top_id_vecs_[layer_id][i];
+      if ((blob_segment[blob_id] >= 0 && blob_segment[blob_id] != segment) ||
+          !can_rerun) {
+        releasable[blob_id] = false;
+      }
+      blob_segment[blob_id] = segment;
+      last_writer[blob_id] = layer_id;
+    }
+  }
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (blob_segment[blob_id] < 0 ||
+        blob_segment[blob_id] == num_segments - 1 ||
+        blobs_[blob_id]->data().use_count() > 1) {
+      releasable[blob_id] = false;
+    }
+  }
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    releasable[net_input_blob_indices_[i]] = false;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    releasable[net_output_blob_indices_[i]] = false;
+  }
+  // A layer is rerun only if all of its tops are dropped, so that it never
+  // overwrites a kept blob, and only if each kept bottom still holds what the
+  // layer saw in Forward, i.e. is not modified in place later on. Layers that
+  // share their tops with bottom[0] keep it whenever they keep a top.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+      bool keep_tops = false;
+      for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+        keep_tops |= !releasable[top_id_vecs_[layer_id][i]];
+      }
+      for (int i = 0; i < bottom_id_vecs_[layer_id].size(); ++i) {
+        const int blob_id = bottom_id_vecs_[layer_id][i];
+        keep_tops |= !releasable[blob_id] && last_writer[blob_id] >= layer_id;
+      }
+      if (!keep_tops) { continue; }
+      for (int i = 0; i < top_id_vecs_[layer_id].size(); ++i) {
+        const int blob_id = top_id_vecs_[layer_id][i];
+        changed |= releasable[blob_id];
+        releasable[blob_id] = false;
+      }
+      if (layers_[layer_id]->TopsShareBottomData()) {
+        const int blob_id = bottom_id_vecs_[layer_id][0];
+        changed |= releasable[blob_id];
+        releasable[blob_id] = false;
+      }
+    }
+  }
+  segment_released_blobs_.assign(num_segments, vector<int>());
+  segment_recompute_layers_.assign(num_segments, vector<int>());
+  segment_released_.assign(num_segments, false);
+  int num_released = 0;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (releasable[blob_id]) {
+      segment_released_blobs_[blob_segment[blob_id]].push_back(blob_id);
+      ++num_released;
+    }
+  }
+  for (int layer_id = 0; layer_id < num_layers; ++layer_id) {
+    if (!top_id_vecs_[layer_id].empty() &&
+        releasable[top_id_vecs_[layer_id][0]]) {
+      segment_recompute_layers_[layer_segment_[layer_id]].push_back(layer_id);
+    }
+  }
+  size_t full_bytes, peak_bytes;
+  CheckpointMemory(&full_bytes, &peak_bytes);
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Activation recomputation: " << num_segments << " segments, "
+      << num_released << " of " << num_blobs << " blobs recomputed in "
+      << "Backward; memory required for data reduced from " << full_bytes
+      << " to " << peak_bytes;
+}
+
+template <typename Dtype>
+void Net<Dtype>::CheckpointMemory(size_t* full_bytes,
+    size_t* peak_bytes) const {
+  // Blobs that share the data of their bottom take no memory of their own.
+  const int num_blobs = blobs_.size();
+  vector<bool> owns_data(num_blobs, true);
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int i = 0; i < top_vecs_[layer_id].size(); ++i) {
+      const Blob<Dtype>* top = top_vecs_[layer_id][i];
+      bool shares_data = layers_[layer_id]->TopsShareBottomData();
+      for (int j = 0; j < bottom_vecs_[layer_id].size(); ++j) {
+        const Blob<Dtype>* bottom = bottom_vecs_[layer_id][j];
+        shares_data |= top != bottom && top->data() == bottom->data();
+      }
+      if (shares_data) { owns_data[top_id_vecs_[layer_id][i]] = false; }
+    }
+  }
+  *full_bytes = 0;
+  for (int blob_id = 0; blob_id < num_blobs; ++blob_id) {
+    if (owns_data[blob_id]) {
+      *full_bytes += blobs_[blob_id]->count() * sizeof(Dtype);
+    }
+  }
+  // All the droppable blobs are gone but those of the segment being run.
+  size_t released_bytes = 0;
+  size_t max_segment_bytes = 0;
+  for (int segment = 0; segment < segment_released_blobs_.size(); ++segment) {
+    size_t segment_bytes = 0;
+    for (int i = 0; i < segment_released_blobs_[segment].size(); ++i) {
+      const int blob_id = segment_released_blobs_[segment][i];
+      if (owns_data[blob_id]) {
+        segment_bytes += blobs_[blob_id]->count() * sizeof(Dtype);
+      }
+    }
+    released_bytes += segment_bytes;
+    max_segment_bytes = std::max(max_segment_bytes, segment_bytes);
+  }
+  *peak_bytes = *full_bytes - released_bytes + max_segment_bytes;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ReleaseSegment(const int segment) {
+  const vector<int>& blob_ids = segment_released_blobs_[segment];
+  if (blob_ids.empty()) { return; }
+  for (int i = 0; i < blob_ids.size(); ++i) {
+    blobs_[blob_ids[i]]->ReleaseData();
+  }
+  segment_released_[segment] = true;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RecomputeSegment(const int segment) {
+  Timer timer;
+  timer.Start();
+  const vector<int>& layer_ids = segment_recompute_layers_[segment];
+  for (int i = 0; i < layer_ids.size(); ++i) {
+    const int layer_id = layer_ids[i];
+    layers_[layer_id]->Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+  }
+  segment_released_[segment] = false;
+  recompute_time_ += timer.MilliSeconds();
+}
+
+// Helper for Net::Init: find each Convolution followed by a BatchNorm using
+// global statistics and optionally by a per-channel Scale and a ReLU, whose
+// intermediate results no other layer reads, and rename the tops of the
+// chain to its last one so that it computes in place like a single layer.
+template <typename Dtype>
+void Net<Dtype>::PlanConvolutionFusion(NetParameter* param) {
+  map<string, int> num_consumers;
+  for (int i = 0; i < param->layer_size(); ++i) {
+    for (int j = 0; j < param->layer(i).bottom_size(); ++j) {
+      ++num_consumers[param->layer(i).bottom(j)];
+    }
+  }
+  const char* const stages[] = { "BatchNorm", "Scale", "ReLU" };
+  for (int i = 0; i < param->layer_size(); ++i) {
+    const LayerParameter& conv = param->layer(i);
+    if (conv.type() != "Convolution" || conv.bottom_size() != 1 ||
+        conv.top_size() != 1 || conv.convolution_param().axis() != 1) {
+      continue;
+    }
+    vector<int> chain(1, i);
+    for (int stage = 0; stage < 3; ++stage) {
+      const int next_id = i + chain.size();
+      if (next_id >= param->layer_size() ||
+          param->layer(next_id).type() != stages[stage]) {
+        // The BatchNorm is required, the Scale and ReLU optional.
+        if (stage == 0) { break; }
+        continue;
+      }
+      const LayerParameter& next = param->layer(next_id);
+      const string& value = param->layer(chain.back()).top(0);
+      if (next.bottom_size() != 1 || next.top_size() != 1 ||
+          next.bottom(0) != value || next.loss_weight_size() > 0) {
+        break;
+      }
+      // A result kept out of place must not be read by any other layer.
+      if (next.top(0) != value && num_consumers[value] != 1) {
+        break;
+      }
+      if (stage == 0 && next.batch_norm_param().has_use_global_stats() &&
+          !next.batch_norm_param().use_global_stats()) {
+        break;
+      }
+      if (stage == 1 && (next.scale_param().axis() != 1 ||
+          next.scale_param().num_axes() != 1)) {
+        break;
+      }
+      chain.push_back(next_id);
+    }
+    const string top = param->layer(chain.back()).top(0);
+    if (chain.size() < 2 || conv.loss_weight_size() > 0 ||
+        conv.bottom(0) == top) {
+      continue;
+    }
+    for (int j = 0; j < chain.size(); ++j) {
+      LayerParameter* layer_param = param->mutable_layer(chain[j]);
+      if (j > 0) { layer_param->set_bottom(0, top); }
+      layer_param->set_top(0, top);
+    }
+    LOG_IF(INFO, Caffe::root_solver()) << "Fusing " << chain.size()
+        << " layers into convolution " << conv.name();
+    fusion_layers_.push_back(chain);
+    i = chain.back();
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::SetUpConvolutionFusion() {
+  layer_fusion_.assign(layers_.size(), -1);
+  fused_layers_.clear();
+  fusion_trackers_.clear();
+  for (int fusion = 0; fusion < fusion_layers_.size(); ++fusion) {
+    const vector<int>& chain = fusion_layers_[fusion];
+    const int conv_id = chain[0];
+    Layer<Dtype>* conv = layers_[conv_id].get();
+    // The fused layer always has a bias, into which the BatchNorm shift goes.
+    LayerParameter fused_param(conv->layer_param());
+    fused_param.mutable_convolution_param()->set_bias_term(true);
+    shared_ptr<Layer<Dtype> > fused =
+        LayerRegistry<Dtype>::CreateLayer(fused_param);
+    fused->blobs().push_back(shared_ptr<Blob<Dtype> >(
+        new Blob<Dtype>(conv->blobs()[0]->shape())));
+    fused->blobs().push_back(shared_ptr<Blob<Dtype> >(
+        new Blob<Dtype>(vector<int>(1, conv->blobs()[0]->shape(0)))));
+    const Layer<Dtype>* last = layers_[chain.back()].get();
+    if (string(last->type()) == "ReLU") {
+      static_cast<BaseConvolutionLayer<Dtype>*>(fused.get())->set_fused_relu(
+          true, last->layer_param().relu_param().negative_slope());
+    }
+    fused->SetUp(bottom_vecs_[conv_id], top_vecs_[conv_id]);
+    fused_layers_.push_back(fused);
+    fusion_trackers_.push_back(shared_ptr<BlobChangeTracker<Dtype> >(
+        new BlobChangeTracker<Dtype>()));
+    layer_fusion_[conv_id] = fusion;
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::FoldConvolution(const int fusion) {
+  const vector<int>& chain = fusion_layers_[fusion];
+  vector<Blob<Dtype>*> sources;
+  for (int i = 0; i < chain.size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs =
+        layers_[chain[i]]->blobs();
+    for (int j = 0; j < blobs.size(); ++j) {
+      sources.push_back(blobs[j].get());
+    }
+  }
+  if (!fusion_trackers_[fusion]->Changed(sources)) { return; }
+  // BatchNorm computes (x - mean) / sqrt(variance + eps) from its stored
+  // sums divided by the moving average factor, and Scale gamma * y + beta,
+  // so the chain is a * x + shift per channel.
+  Layer<Dtype>* conv = layers_[chain[0]].get();
+  Layer<Dtype>* bn = layers_[chain[1]].get();
+  Layer<Dtype>* scale = chain.size() > 2 &&
+      string(layers_[chain[2]]->type()) == "Scale" ?
+      layers_[chain[2]].get() : NULL;
+  const int num_output = conv->blobs()[0]->shape(0);
+  const int filter_dim = conv->blobs()[0]->count(1);
+  const Dtype* weight = conv->blobs()[0]->cpu_data();
+  const Dtype* bias = conv->blobs().size() > 1 ?
+      conv->blobs()[1]->cpu_data() : NULL;
+  const Dtype* mean = bn->blobs()[0]->cpu_data();
+  const Dtype* variance = bn->blobs()[1]->cpu_data();
+  const Dtype factor = bn->blobs()[2]->cpu_data()[0];
+  const Dtype scale_factor = factor == 0 ? 0 : 1 / factor;
+  const Dtype eps = bn->layer_param().batch_norm_param().eps();
+  const Dtype* gamma = scale ? scale->blobs()[0]->cpu_data() : NULL;
+  const Dtype* beta = scale && scale->blobs().size() > 1 ?
+      scale->blobs()[1]->cpu_data() : NULL;
+  Layer<Dtype>* fused = fused_layers_[fusion].get();
+  Dtype* fused_weight = fused->blobs()[0]->mutable_cpu_data();
+  Dtype* fused_bias = fused->blobs()[1]->mutable_cpu_data();
+  for (int o = 0; o < num_output; ++o) {
+    Dtype a = 1 / std::sqrt(variance[o] * scale_factor + eps);
+    Dtype shift = ((bias ? bias[o] : 0) - mean[o] * scale_factor) * a;
+    if (gamma) {
+      a *= gamma[o];
+      shift *= gamma[o];
+    }
+    if (beta) {
+      shift += beta[o];
+    }
+    caffe_cpu_scale(filter_dim, a, weight + o * filter_dim,
+        fused_weight + o * filter_dim);
+    fused_bias[o] = shift;
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::FilterNet(const NetParameter& param,
     NetParameter* param_filtered) {
@@ -469,6 +983,7 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     const int learnable_param_id = learnable_params_.size();
     learnable_params_.push_back(params_[net_param_id].get());
     learnable_param_ids_.push_back(learnable_param_id);
+    learnable_param_layer_indices_.push_back(make_pair(layer_id, param_id));
     has_params_lr_.push_back(param_spec->has_lr_mult());
     has_params_decay_.push_back(param_spec->has_decay_mult());
     params_lr_.push_back(param_spec->lr_mult());
@@ -509,6 +1024,8 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
     }
     const int learnable_param_id = learnable_param_ids_[owner_net_param_id];
     learnable_param_ids_.push_back(learnable_param_id);
+    // The sharing layer may write any row of the diff.
+    learnable_param_layer_indices_[learnable_param_id] = make_pair(-1, -1);
     if (param_spec->has_lr_mult()) {
       if (has_params_lr_[learnable_param_id]) {
         CHECK_EQ(param_spec->lr_mult(), params_lr_[learnable_param_id])
@@ -535,12 +1052,45 @@ template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
+  if (Caffe::mode() == Caffe::CPU) {
+    // A fused chain computes in place, so the layers after the convolution
+    // would find their top already computed; start from the convolution.
+    for (int fusion = 0; fusion < fusion_layers_.size(); ++fusion) {
+      const vector<int>& chain = fusion_layers_[fusion];
+      if (chain[0] < start && start <= chain.back()) {
+        start = chain[0];
+        break;
+      }
+    }
+  }
   Dtype loss = 0;
+  if (checkpointing() && segment_released_[layer_segment_[start]] &&
+      start > segment_begin_[layer_segment_[start]]) {
+    RecomputeSegment(layer_segment_[start]);
+  }
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
+    const int fusion = layer_fusion_[i];
+    if (fusion >= 0 && fusion_layers_[fusion].back() <= end &&
+        Caffe::mode() == Caffe::CPU) {
+      // Run the whole chain as its fused convolution.
+      FoldConvolution(fusion);
+      fused_layers_[fusion]->Forward(bottom_vecs_[i], top_vecs_[i]);
+      i = fusion_layers_[fusion].back();
+      if (debug_info_) { ForwardDebugInfo(i); }
+      continue;
+    }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
+    if (checkpointing()) {
+      // Drop the segment's activations once its last layer has run.
+      const int segment = layer_segment_[i];
+      if (segment + 1 < segment_begin_.size() &&
+          segment_begin_[segment + 1] == i + 1) {
+        ReleaseSegment(segment);
+      }
+    }
   }
   return loss;
 }
@@ -582,11 +1132,17 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
   for (int i = start; i >= end; --i) {
+    if (checkpointing() && segment_released_[layer_segment_[i]]) {
+      RecomputeSegment(layer_segment_[i]);
+    }
     if (layer_need_backward_[i]) {
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
       if (debug_info_) { BackwardDebugInfo(i); }
     }
+    if (checkpointing() && i == segment_begin_[layer_segment_[i]]) {
+      ReleaseSegment(layer_segment_[i]);
+    }
   }
 }
 
@@ -735,6 +1291,11 @@ void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
+  if (optimize_memory_) {
+    // Reshape runs on every change of input shape, so the plan is only
+    // logged verbosely.
+    OptimizeMemory(false);
+  }
 }
 
 template <typename Dtype>
@@ -795,6 +1356,7 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+  HDF5Lock lock;
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -857,6 +1419,7 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+  HDF5Lock lock;
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -912,10 +1475,32 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+const vector<int>* Net<Dtype>::param_diff_rows(int param_id) const {
+  const int layer_id = learnable_param_layer_indices_[param_id].first;
+  if (Caffe::mode() != Caffe::CPU || layer_id < 0) {
+    return NULL;
+  }
+  return layers_[layer_id]->param_diff_rows(
+      learnable_param_layer_indices_[param_id].second);
+}
+
 template <typename Dtype>
 void Net<Dtype>::Update() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
-    learnable_params_[i]->Update();
+    const vector<int>* rows = param_diff_rows(i);
+    if (!rows) {
+      learnable_params_[i]->Update();
+      continue;
+    }
+    Blob<Dtype>* blob = learnable_params_[i];
+    const int dim = blob->count(1);
+    const Dtype* diff = blob->cpu_diff();
+    Dtype* data = blob->mutable_cpu_data();
+    for (int j = 0; j < rows->size(); ++j) {
+      const int offset = (*rows)[j] * dim;
+      caffe_axpy(dim, Dtype(-1), diff + offset, data + offset);
+    }
   }
 }
 
@@ -923,6 +1508,17 @@ template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
     Blob<Dtype>* blob = learnable_params_[i];
+    const vector<int>* rows = param_diff_rows(i);
+    if (rows) {
+      // The other rows are still clear.
+      const int dim = blob->count(1);
+      Dtype* diff = blob->mutable_cpu_diff();
+      for (int j = 0; j < rows->size(); ++j) {
+        caffe_set(dim, Dtype(0), diff + (*rows)[j] * dim);
+      }
+      layers_[learnable_param_layer_indices_[i].first]->ClearParamDiffRows();
+      continue;
+    }
     switch (Caffe::mode()) {
     case Caffe::CPU:
       caffe_set(blob->count(), static_cast<Dtype>(0),
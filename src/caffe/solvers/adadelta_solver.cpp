@@ -1,3 +1,4 @@
+#include <utility>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
@@ -32,61 +33,51 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   size_t update_history_offset = net_params.size();
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    // compute square of gradient in update
-    caffe_powx(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // update history of gradients
-    caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) - momentum,
-        this->update_[param_id]->cpu_data(), momentum,
-        this->history_[param_id]->mutable_cpu_data());
-
-    // add delta to history to guard against dividing by zero later
-    caffe_set(net_params[param_id]->count(), delta,
-        this->temp_[param_id]->mutable_cpu_data());
-
-    caffe_add(net_params[param_id]->count(),
-        this->temp_[param_id]->cpu_data(),
-        this->history_[update_history_offset + param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
-
-    caffe_add(net_params[param_id]->count(),
-        this->temp_[param_id]->cpu_data(),
-        this->history_[param_id]->cpu_data(),
-        this->temp_[param_id]->mutable_cpu_data());
-
-    // divide history of updates by history of gradients
-    caffe_div(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(),
-        this->temp_[param_id]->cpu_data(),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // jointly compute the RMS of both for update and gradient history
-    caffe_powx(net_params[param_id]->count(),
-        this->update_[param_id]->cpu_data(), Dtype(0.5),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // compute the update
-    caffe_mul(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(),
-        this->update_[param_id]->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
-
-    // compute square of update
-    caffe_powx(net_params[param_id]->count(),
-        net_params[param_id]->cpu_diff(), Dtype(2),
-        this->update_[param_id]->mutable_cpu_data());
-
-    // update history of updates
-    caffe_cpu_axpby(net_params[param_id]->count(), Dtype(1) - momentum,
-        this->update_[param_id]->cpu_data(), momentum,
-        this->history_[update_history_offset + param_id]->mutable_cpu_data());
-
-    // apply learning rate
-    caffe_cpu_scale(net_params[param_id]->count(), local_rate,
-        net_params[param_id]->cpu_diff(),
-        net_params[param_id]->mutable_cpu_diff());
+    vector<pair<int, int> > ranges;
+    this->UpdateRanges(param_id, &ranges);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = this->history_[param_id]->mutable_cpu_data();
+    Dtype* update_history =
+        this->history_[update_history_offset + param_id]->mutable_cpu_data();
+    Dtype* update = this->update_[param_id]->mutable_cpu_data();
+    Dtype* temp = this->temp_[param_id]->mutable_cpu_data();
+    for (int r = 0; r < ranges.size(); ++r) {
+      const int offset = ranges[r].first;
+      const int count = ranges[r].second;
+      // compute square of gradient in update
+      caffe_powx(count, diff + offset, Dtype(2), update + offset);
+
+      // update history of gradients
+      caffe_cpu_axpby(count, Dtype(1) - momentum, update + offset, momentum,
+          history + offset);
+
+      // add delta to history to guard against dividing by zero later
+      caffe_set(count, delta, temp + offset);
+
+      caffe_add(count, temp + offset, update_history + offset,
+          update + offset);
+
+      caffe_add(count, temp + offset, history + offset, temp + offset);
+
+      // divide history of updates by history of gradients
+      caffe_div(count, update + offset, temp + offset, update + offset);
+
+      // jointly compute the RMS of both for update and gradient history
+      caffe_powx(count, update + offset, Dtype(0.5), update + offset);
+
+      // compute the update
+      caffe_mul(count, diff + offset, update + offset, diff + offset);
+
+      // compute square of update
+      caffe_powx(count, diff + offset, Dtype(2), update + offset);
+
+      // update history of updates
+      caffe_cpu_axpby(count, Dtype(1) - momentum, update + offset, momentum,
+          update_history + offset);
+
+      // apply learning rate
+      caffe_cpu_scale(count, local_rate, diff + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
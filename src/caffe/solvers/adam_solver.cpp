@@ -1,3 +1,4 @@
+#include <utility>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
@@ -39,42 +40,41 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   const int t = this->iter_ + 1;
   const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
       (Dtype(1.) - pow(beta1, t));
-  const int N = net_params[param_id]->count();
   const Dtype eps_hat = this->param_.delta();
 
   switch (Caffe::mode()) {
     case Caffe::CPU: {
-    // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
-    caffe_cpu_axpby(N, Dtype(1)-beta1,
-        net_params[param_id]->cpu_diff(), beta1,
-        val_m->mutable_cpu_data());
+    vector<pair<int, int> > ranges;
+    this->UpdateRanges(param_id, &ranges);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* m = val_m->mutable_cpu_data();
+    Dtype* v = val_v->mutable_cpu_data();
+    Dtype* temp = val_t->mutable_cpu_data();
+    for (int r = 0; r < ranges.size(); ++r) {
+      const int offset = ranges[r].first;
+      const int count = ranges[r].second;
+      // update m <- \beta_1 m_{t-1} + (1-\beta_1)g_t
+      caffe_cpu_axpby(count, Dtype(1)-beta1, diff + offset, beta1,
+          m + offset);
 
-    // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
-    caffe_mul(N,
-        net_params[param_id]->cpu_diff(),
-        net_params[param_id]->cpu_diff(),
-    val_t->mutable_cpu_data());
-    caffe_cpu_axpby(N, Dtype(1)-beta2,
-        val_t->cpu_data(), beta2,
-        val_v->mutable_cpu_data());
+      // update v <- \beta_2 m_{t-1} + (1-\beta_2)g_t^2
+      caffe_mul(count, diff + offset, diff + offset, temp + offset);
+      caffe_cpu_axpby(count, Dtype(1)-beta2, temp + offset, beta2,
+          v + offset);
 
-    // set update
-    caffe_powx(N,
-        val_v->cpu_data(), Dtype(0.5),
-        val_t->mutable_cpu_data());
-    caffe_add_scalar(N, eps_hat, val_t->mutable_cpu_data());
-    caffe_div(N,
-        val_m->cpu_data(),
-        val_t->cpu_data(),
-        val_t->mutable_cpu_data());
+      // set update
+      caffe_powx(count, v + offset, Dtype(0.5), temp + offset);
+      caffe_add_scalar(count, eps_hat, temp + offset);
+      caffe_div(count, m + offset, temp + offset, temp + offset);
 
-    caffe_cpu_scale(N, local_rate*correction,
-        val_t->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+      caffe_cpu_scale(count, local_rate*correction, temp + offset,
+          diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
 #ifndef CPU_ONLY
+    const int N = net_params[param_id]->count();
     adam_update_gpu(N, net_params[param_id]->mutable_gpu_diff(),
         val_m->mutable_gpu_data(), val_v->mutable_gpu_data(), beta1, beta2,
         eps_hat, local_rate*correction);
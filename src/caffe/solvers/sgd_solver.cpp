@@ -1,4 +1,5 @@
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
@@ -77,14 +78,40 @@ void SGDSolver<Dtype>::PreSolve() {
   }
 }
 
+template <typename Dtype>
+void SGDSolver<Dtype>::UpdateRanges(int param_id,
+    vector<pair<int, int> >* ranges) {
+  const Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  const vector<int>* rows = this->net_->param_diff_rows(param_id);
+  ranges->clear();
+  if (!rows) {
+    ranges->push_back(make_pair(0, param->count()));
+    return;
+  }
+  const int dim = param->count(1);
+  for (int i = 0; i < rows->size(); ++i) {
+    ranges->push_back(make_pair((*rows)[i] * dim, dim));
+  }
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::ClipGradients() {
   const Dtype clip_gradients = this->param_.clip_gradients();
   if (clip_gradients < 0) { return; }
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
   Dtype sumsq_diff = 0;
+  vector<pair<int, int> > ranges;
   for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+    if (!this->net_->param_diff_rows(i)) {
+      sumsq_diff += net_params[i]->sumsq_diff();
+      continue;
+    }
+    UpdateRanges(i, &ranges);
+    const Dtype* diff = net_params[i]->cpu_diff();
+    for (int r = 0; r < ranges.size(); ++r) {
+      const Dtype* range_diff = diff + ranges[r].first;
+      sumsq_diff += caffe_cpu_dot(ranges[r].second, range_diff, range_diff);
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -93,7 +120,15 @@ void SGDSolver<Dtype>::ClipGradients() {
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
     for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+      if (!this->net_->param_diff_rows(i)) {
+        net_params[i]->scale_diff(scale_factor);
+        continue;
+      }
+      UpdateRanges(i, &ranges);
+      Dtype* diff = net_params[i]->mutable_cpu_diff();
+      for (int r = 0; r < ranges.size(); ++r) {
+        caffe_scal(ranges[r].second, scale_factor, diff + ranges[r].first);
+      }
     }
   }
 }
@@ -123,8 +158,13 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
   const Dtype accum_normalization = Dtype(1.) / this->param_.iter_size();
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_scal(net_params[param_id]->count(), accum_normalization,
-        net_params[param_id]->mutable_cpu_diff());
+    vector<pair<int, int> > ranges;
+    UpdateRanges(param_id, &ranges);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    for (int r = 0; r < ranges.size(); ++r) {
+      caffe_scal(ranges[r].second, accum_normalization,
+          diff + ranges[r].first);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -152,20 +192,25 @@ void SGDSolver<Dtype>::Regularize(int param_id) {
   switch (Caffe::mode()) {
   case Caffe::CPU: {
     if (local_decay) {
+      vector<pair<int, int> > ranges;
+      UpdateRanges(param_id, &ranges);
+      const Dtype* data = net_params[param_id]->cpu_data();
+      Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+      Dtype* temp = temp_[param_id]->mutable_cpu_data();
       if (regularization_type == "L2") {
         // add weight decay
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            net_params[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        for (int r = 0; r < ranges.size(); ++r) {
+          const int offset = ranges[r].first;
+          caffe_axpy(ranges[r].second, local_decay, data + offset,
+              diff + offset);
+        }
       } else if (regularization_type == "L1") {
-        caffe_cpu_sign(net_params[param_id]->count(),
-            net_params[param_id]->cpu_data(),
-            temp_[param_id]->mutable_cpu_data());
-        caffe_axpy(net_params[param_id]->count(),
-            local_decay,
-            temp_[param_id]->cpu_data(),
-            net_params[param_id]->mutable_cpu_diff());
+        for (int r = 0; r < ranges.size(); ++r) {
+          const int offset = ranges[r].first;
+          caffe_cpu_sign(ranges[r].second, data + offset, temp + offset);
+          caffe_axpy(ranges[r].second, local_decay, temp + offset,
+              diff + offset);
+        }
       } else {
         LOG(FATAL) << "Unknown regularization type: " << regularization_type;
       }
@@ -218,12 +263,17 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   // Compute the update to history, then copy it to the parameter diff.
   switch (Caffe::mode()) {
   case Caffe::CPU: {
-    caffe_cpu_axpby(net_params[param_id]->count(), local_rate,
-              net_params[param_id]->cpu_diff(), momentum,
-              history_[param_id]->mutable_cpu_data());
-    caffe_copy(net_params[param_id]->count(),
-        history_[param_id]->cpu_data(),
-        net_params[param_id]->mutable_cpu_diff());
+    vector<pair<int, int> > ranges;
+    UpdateRanges(param_id, &ranges);
+    Dtype* diff = net_params[param_id]->mutable_cpu_diff();
+    Dtype* history = history_[param_id]->mutable_cpu_data();
+    for (int r = 0; r < ranges.size(); ++r) {
+      const int offset = ranges[r].first;
+      const int count = ranges[r].second;
+      caffe_cpu_axpby(count, local_rate, diff + offset, momentum,
+          history + offset);
+      caffe_copy(count, history + offset, diff + offset);
+    }
     break;
   }
   case Caffe::GPU: {
@@ -281,6 +331,7 @@ void SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
   string snapshot_filename =
       Solver<Dtype>::SnapshotFilename(".solverstate.h5");
   LOG(INFO) << "Snapshotting solver state to HDF5 file " << snapshot_filename;
+  HDF5Lock lock;
   hid_t file_hid = H5Fcreate(snapshot_filename.c_str(), H5F_ACC_TRUNC,
       H5P_DEFAULT, H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -323,6 +374,7 @@ void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
 
 template <typename Dtype>
 void SGDSolver<Dtype>::RestoreSolverStateFromHDF5(const string& state_file) {
+  HDF5Lock lock;
   hid_t file_hid = H5Fopen(state_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open solver state file " << state_file;
   this->iter_ = hdf5_load_int(file_hid, "iter");
@@ -0,0 +1,176 @@
+#include <boost/thread.hpp>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Loads batches filled with their index, taking load_ms for each, and
+// reports the available memory the test sets.
+template <typename Dtype>
+class CountingDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  CountingDataLayer(const LayerParameter& param, int load_ms)
+      : BasePrefetchingDataLayer<Dtype>(param),
+        available_(std::numeric_limits<size_t>::max()), load_ms_(load_ms),
+        loaded_(0) {}
+  virtual ~CountingDataLayer() { this->StopInternalThread(); }
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    vector<int> data_shape(2, 2);
+    vector<int> label_shape(1, 2);
+    top[0]->Reshape(data_shape);
+    top[1]->Reshape(label_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.Reshape(data_shape);
+      this->prefetch_[i]->label_.Reshape(label_shape);
+    }
+  }
+  virtual inline const char* type() const { return "Counting"; }
+
+  size_t available_;
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch) {
+    if (load_ms_) {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(load_ms_));
+    }
+    caffe_set(batch->data_.count(), Dtype(loaded_),
+        batch->data_.mutable_cpu_data());
+    caffe_set(batch->label_.count(), Dtype(loaded_),
+        batch->label_.mutable_cpu_data());
+    ++loaded_;
+  }
+  virtual size_t available_memory() const { return available_; }
+
+  const int load_ms_;
+  int loaded_;
+};
+
+template <typename Dtype>
+class BasePrefetchingDataLayerTest : public ::testing::Test {
+ protected:
+  BasePrefetchingDataLayerTest()
+      : blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+  }
+  virtual ~BasePrefetchingDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // Check that the next batch is the index-th one loaded.
+  void ForwardAndCheck(Layer<Dtype>* layer, int index) {
+    layer->Forward(blob_bottom_vec_, blob_top_vec_);
+    for (int i = 0; i < blob_top_data_->count(); ++i) {
+      EXPECT_EQ(index, blob_top_data_->cpu_data()[i]);
+    }
+    for (int i = 0; i < blob_top_label_->count(); ++i) {
+      EXPECT_EQ(index, blob_top_label_->cpu_data()[i]);
+    }
+  }
+
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(BasePrefetchingDataLayerTest, TestDtypes);
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestFixedPrefetch) {
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(2);
+  CountingDataLayer<TypeParam> layer(param, 0);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(2, layer.prefetch_count());
+  for (int iter = 0; iter < 10; ++iter) {
+    this->ForwardAndCheck(&layer, iter);
+  }
+  EXPECT_EQ(2, layer.prefetch_count());
+}
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestDefaultPrefetch) {
+  // Layers without a data_param keep their number of batches.
+  LayerParameter param;
+  CountingDataLayer<TypeParam> layer(param, 0);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(3, layer.prefetch_count());
+  for (int iter = 0; iter < 5; ++iter) {
+    this->ForwardAndCheck(&layer, iter);
+  }
+  EXPECT_EQ(3, layer.prefetch_count());
+}
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestSharedBatch) {
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(2);
+  CountingDataLayer<TypeParam> layer(param, 0);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  const TypeParam* previous_data = NULL;
+  for (int iter = 0; iter < 10; ++iter) {
+    this->ForwardAndCheck(&layer, iter);
+    // The tops point to the batch rather than holding a copy of it...
+    EXPECT_NE(previous_data, this->blob_top_data_->cpu_data());
+    previous_data = this->blob_top_data_->cpu_data();
+    // ...which is not loaded over while they do, however long they keep it.
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    for (int i = 0; i < this->blob_top_data_->count(); ++i) {
+      EXPECT_EQ(iter, this->blob_top_data_->cpu_data()[i]);
+    }
+    for (int i = 0; i < this->blob_top_label_->count(); ++i) {
+      EXPECT_EQ(iter, this->blob_top_label_->cpu_data()[i]);
+    }
+  }
+  EXPECT_EQ(2, layer.prefetch_count());
+}
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestAdaptivePrefetchGrows) {
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(1);
+  param.mutable_data_param()->set_max_prefetch(3);
+  param.mutable_data_param()->set_min_free_memory_mb(1);
+  // Loading is slower than consuming, so every Forward waits.
+  CountingDataLayer<TypeParam> layer(param, 5);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(1, layer.prefetch_count());
+  for (int iter = 0; iter < 10; ++iter) {
+    this->ForwardAndCheck(&layer, iter);
+  }
+  EXPECT_EQ(3, layer.prefetch_count());
+  EXPECT_GT(layer.prefetch_waits(), 0);
+  EXPECT_GT(layer.prefetch_wait_time(), 0);
+}
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestAdaptivePrefetchShrinks) {
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(1);
+  param.mutable_data_param()->set_max_prefetch(3);
+  param.mutable_data_param()->set_min_free_memory_mb(1);
+  CountingDataLayer<TypeParam> layer(param, 5);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  int iter = 0;
+  for (; iter < 10; ++iter) {
+    this->ForwardAndCheck(&layer, iter);
+  }
+  EXPECT_EQ(3, layer.prefetch_count());
+  // Under memory pressure the extra batches are dropped, without losing any
+  // loaded data, once the available memory is read again.
+  layer.available_ = 0;
+  for (; iter < 40; ++iter) {
+    this->ForwardAndCheck(&layer, iter);
+  }
+  EXPECT_EQ(1, layer.prefetch_count());
+}
+
+}  // namespace caffe
@@ -5,6 +5,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/util/blob_change_tracker.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -112,6 +113,31 @@ TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   EXPECT_FALSE(this->blob_->ShapeEquals(blob_proto));
 }
 
+TYPED_TEST(BlobSimpleTest, TestChangeTracker) {
+  BlobChangeTracker<TypeParam> tracker;
+  Blob<TypeParam>* blob = this->blob_preshaped_;
+  EXPECT_TRUE(tracker.Changed(*blob));
+  EXPECT_FALSE(tracker.Changed(*blob));
+  // Reading does not change the data, while a mutable pointer may.
+  blob->cpu_data();
+  EXPECT_FALSE(tracker.Changed(*blob));
+  TypeParam* data = blob->mutable_cpu_data();
+  data[0] = 1;
+  EXPECT_TRUE(tracker.Changed(*blob));
+  EXPECT_FALSE(tracker.Changed(*blob));
+  // Writing through a pointer obtained earlier changes the values only.
+  data[0] = 2;
+  EXPECT_TRUE(tracker.Changed(*blob));
+  EXPECT_FALSE(tracker.Changed(*blob));
+  // So does sharing the data of another blob.
+  Blob<TypeParam> other(blob->shape());
+  blob->ShareData(other);
+  EXPECT_TRUE(tracker.Changed(*blob));
+  EXPECT_FALSE(tracker.Changed(*blob));
+  tracker.Reset();
+  EXPECT_TRUE(tracker.Changed(*blob));
+}
+
 template <typename TypeParam>
 class BlobMathTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
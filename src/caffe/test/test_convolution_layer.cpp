@@ -1,3 +1,6 @@
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -5,7 +8,16 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/layers/autotuned_conv_layer.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/layers/fft_conv_layer.hpp"
+#include "caffe/layers/threaded_conv_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/tuning_cache.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -811,6 +823,594 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+// Check Forward and Backward of a CPU convolution engine against the CAFFE
+// engine with equal weights.
+template <typename Dtype>
+void CheckAgainstCaffeEngine(Layer<Dtype>* layer,
+    const LayerParameter& layer_param, Blob<Dtype>* bottom, Dtype tolerance) {
+  ConvolutionLayer<Dtype> ref_layer(layer_param);
+  Blob<Dtype> ref_bottom;
+  Blob<Dtype> ref_top;
+  Blob<Dtype> top;
+  ref_bottom.CopyFrom(*bottom, false, true);
+  vector<Blob<Dtype>*> ref_bottom_vec(1, &ref_bottom);
+  vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+  vector<Blob<Dtype>*> bottom_vec(1, bottom);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  ref_layer.SetUp(ref_bottom_vec, ref_top_vec);
+  layer->SetUp(bottom_vec, top_vec);
+  ASSERT_EQ(ref_layer.blobs().size(), layer->blobs().size());
+  for (int i = 0; i < layer->blobs().size(); ++i) {
+    layer->blobs()[i]->CopyFrom(*ref_layer.blobs()[i]);
+  }
+  ref_layer.Forward(ref_bottom_vec, ref_top_vec);
+  layer->Forward(bottom_vec, top_vec);
+  ASSERT_EQ(ref_top.count(), top.count());
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(ref_top.cpu_data()[i], top.cpu_data()[i], tolerance);
+  }
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&ref_top);
+  caffe_copy(ref_top.count(), ref_top.cpu_data(), ref_top.mutable_cpu_diff());
+  top.CopyFrom(ref_top, true);
+  vector<bool> propagate_down(1, true);
+  ref_layer.Backward(ref_top_vec, propagate_down, ref_bottom_vec);
+  layer->Backward(top_vec, propagate_down, bottom_vec);
+  for (int i = 0; i < bottom->count(); ++i) {
+    EXPECT_NEAR(ref_bottom.cpu_diff()[i], bottom->cpu_diff()[i], tolerance);
+  }
+  for (int j = 0; j < layer->blobs().size(); ++j) {
+    const Blob<Dtype>& ref_param = *ref_layer.blobs()[j];
+    const Blob<Dtype>& param = *layer->blobs()[j];
+    for (int i = 0; i < param.count(); ++i) {
+      EXPECT_NEAR(ref_param.cpu_diff()[i], param.cpu_diff()[i], tolerance);
+    }
+  }
+}
+
+template <typename Dtype>
+class ThreadedConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  ThreadedConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(5, 3, 6, 4)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    ThreadPool::SetGlobalThreads(3);
+  }
+
+  virtual ~ThreadedConvolutionLayerTest() {
+    ThreadPool::SetGlobalThreads(0);
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ThreadedConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(ThreadedConvolutionLayerTest, TestAgainstCaffe) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ThreadedConvolutionLayer<TypeParam> layer(layer_param);
+  CheckAgainstCaffeEngine(&layer, layer_param, this->blob_bottom_,
+      TypeParam(1e-4));
+}
+
+TYPED_TEST(ThreadedConvolutionLayerTest, Test1x1AgainstCaffe) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ThreadedConvolutionLayer<TypeParam> layer(layer_param);
+  CheckAgainstCaffeEngine(&layer, layer_param, this->blob_bottom_,
+      TypeParam(1e-4));
+}
+
+TYPED_TEST(ThreadedConvolutionLayerTest, TestGroupAgainstCaffe) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  ThreadedConvolutionLayer<TypeParam> layer(layer_param);
+  CheckAgainstCaffeEngine(&layer, layer_param, this->blob_bottom_,
+      TypeParam(1e-4));
+}
+
+TYPED_TEST(ThreadedConvolutionLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ThreadedConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+template <typename Dtype>
+class DirectConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  DirectConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 9, 7)) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+  }
+
+  virtual ~DirectConvolutionLayerTest() { delete blob_bottom_; }
+
+  void Check(const LayerParameter& layer_param) {
+    DirectConvolutionLayer<Dtype> layer(layer_param);
+    CheckAgainstCaffeEngine(&layer, layer_param, blob_bottom_, Dtype(1e-4));
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+};
+
+TYPED_TEST_CASE(DirectConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(DirectConvolutionLayerTest, Test3x3) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  // Not a multiple of the block size.
+  convolution_param->set_num_output(11);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestStrideAndRectangularKernel) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->set_kernel_h(5);
+  convolution_param->set_kernel_w(3);
+  convolution_param->set_stride_h(2);
+  convolution_param->set_stride_w(3);
+  convolution_param->set_pad_h(2);
+  convolution_param->set_pad_w(1);
+  convolution_param->set_num_output(8);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestGroup) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(9);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  this->Check(layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, Test1x1) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(1);
+  convolution_param->set_num_output(16);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestRepacksChangedWeights) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(8);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  DirectConvolutionLayer<Dtype> layer(layer_param);
+  Blob<Dtype> top;
+  Blob<Dtype> first_top;
+  vector<Blob<Dtype>*> bottom_vec(1, this->blob_bottom_);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  layer.SetUp(bottom_vec, top_vec);
+  layer.Forward(bottom_vec, top_vec);
+  first_top.CopyFrom(top, false, true);
+  // Without a bias, doubling the weights doubles the output.
+  caffe_scal(layer.blobs()[0]->count(), Dtype(2),
+      layer.blobs()[0]->mutable_cpu_data());
+  layer.Forward(bottom_vec, top_vec);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(2 * first_top.cpu_data()[i], top.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestDilatedFallsBack) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_dilation(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(layer_param);
+}
+
+template <typename Dtype>
+class WinogradConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  WinogradConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 9, 7)) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+  }
+
+  virtual ~WinogradConvolutionLayerTest() { delete blob_bottom_; }
+
+  void Check(const LayerParameter& layer_param) {
+    WinogradConvolutionLayer<Dtype> layer(layer_param);
+    CheckAgainstCaffeEngine(&layer, layer_param, blob_bottom_, Dtype(1e-3));
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+};
+
+TYPED_TEST_CASE(WinogradConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestTile2) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  convolution_param->set_winograd_tile(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(layer_param);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestTile4) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  convolution_param->set_winograd_tile(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(layer_param);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestNoPadGroup) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(9);
+  convolution_param->set_group(3);
+  convolution_param->set_winograd_tile(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  this->Check(layer_param);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestStrideFallsBack) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(layer_param);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestWeightChange) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> bottom_vec(1, this->blob_bottom_);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, top_vec);
+  layer.Forward(bottom_vec, top_vec);
+  // Doubling the weights must double the output, not reuse the cached
+  // transformed filters.
+  Blob<Dtype> first;
+  first.CopyFrom(top, false, true);
+  caffe_scal(layer.blobs()[0]->count(), Dtype(2),
+      layer.blobs()[0]->mutable_cpu_data());
+  layer.Forward(bottom_vec, top_vec);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(2 * first.cpu_data()[i], top.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestStaleWeightPointer) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> bottom_vec(1, this->blob_bottom_);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, top_vec);
+  // Like a numpy view from pycaffe, the pointer is taken before Forward and
+  // written after it.
+  Dtype* weights = layer.blobs()[0]->mutable_cpu_data();
+  layer.Forward(bottom_vec, top_vec);
+  Blob<Dtype> first;
+  first.CopyFrom(top, false, true);
+  caffe_scal(layer.blobs()[0]->count(), Dtype(2), weights);
+  layer.Forward(bottom_vec, top_vec);
+  for (int i = 0; i < top.count(); ++i) {
+    EXPECT_NEAR(2 * first.cpu_data()[i], top.cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> bottom_vec(1, this->blob_bottom_);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, bottom_vec, top_vec);
+}
+
+template <typename Dtype>
+class FFTConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  FFTConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 9, 7)) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+  }
+
+  virtual ~FFTConvolutionLayerTest() { delete blob_bottom_; }
+
+  void Check(LayerParameter* layer_param) {
+    layer_param->mutable_convolution_param()->set_engine(
+        ConvolutionParameter_Engine_FFT);
+    FFTConvolutionLayer<Dtype> layer(*layer_param);
+    CheckAgainstCaffeEngine(&layer, *layer_param, blob_bottom_, Dtype(1e-3));
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+};
+
+TYPED_TEST_CASE(FFTConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(FFTConvolutionLayerTest, Test7x7) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(7);
+  convolution_param->add_pad(3);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(&layer_param);
+}
+
+TYPED_TEST(FFTConvolutionLayerTest, TestStrideDilationAndRectangularKernel) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->set_kernel_h(3);
+  convolution_param->set_kernel_w(2);
+  convolution_param->set_stride_h(2);
+  convolution_param->set_stride_w(3);
+  convolution_param->set_pad_h(2);
+  convolution_param->set_pad_w(1);
+  convolution_param->add_dilation(2);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(&layer_param);
+}
+
+TYPED_TEST(FFTConvolutionLayerTest, TestGroup) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(5);
+  convolution_param->set_num_output(9);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  this->Check(&layer_param);
+}
+
+TYPED_TEST(FFTConvolutionLayerTest, TestSeveralTiles) {
+  // Large enough that the input is split into several tiles per axis.
+  this->blob_bottom_->Reshape(1, 3, 40, 37);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(5);
+  convolution_param->add_pad(1);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(&layer_param);
+}
+
+TYPED_TEST(FFTConvolutionLayerTest, TestDefaultEngine) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(4);
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  EXPECT_FALSE(dynamic_cast<FFTConvolutionLayer<Dtype>*>(layer.get()));
+  convolution_param->set_kernel_size(0, 7);
+  layer = LayerRegistry<Dtype>::CreateLayer(layer_param);
+#ifndef USE_CUDNN
+  EXPECT_TRUE(dynamic_cast<FFTConvolutionLayer<Dtype>*>(layer.get()));
+#endif
+}
+
+template <typename Dtype>
+class AutotunedConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  AutotunedConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 3, 8, 7)) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    MakeTempFilename(&cache_file_);
+    TuningCache::set_file("");
+  }
+
+  virtual ~AutotunedConvolutionLayerTest() {
+    TuningCache::set_file("");
+    std::remove(cache_file_.c_str());
+    delete blob_bottom_;
+  }
+
+  void MakeLayerParam(int kernel_size, LayerParameter* layer_param) {
+    layer_param->set_type("Convolution");
+    ConvolutionParameter* convolution_param =
+        layer_param->mutable_convolution_param();
+    convolution_param->add_kernel_size(kernel_size);
+    convolution_param->add_pad(kernel_size / 2);
+    convolution_param->set_num_output(4);
+    convolution_param->set_engine(ConvolutionParameter_Engine_AUTOTUNE);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+  }
+
+  int CacheLines() {
+    std::ifstream input(cache_file_.c_str());
+    string line;
+    int lines = 0;
+    while (std::getline(input, line)) {
+      ++lines;
+    }
+    return lines;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  string cache_file_;
+};
+
+TYPED_TEST_CASE(AutotunedConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(AutotunedConvolutionLayerTest, Test3x3AgainstCaffe) {
+  LayerParameter layer_param;
+  this->MakeLayerParam(3, &layer_param);
+  AutotunedConvolutionLayer<TypeParam> layer(layer_param);
+  CheckAgainstCaffeEngine(&layer, layer_param, this->blob_bottom_,
+      TypeParam(1e-3));
+}
+
+TYPED_TEST(AutotunedConvolutionLayerTest, Test7x7AgainstCaffe) {
+  LayerParameter layer_param;
+  this->MakeLayerParam(7, &layer_param);
+  AutotunedConvolutionLayer<TypeParam> layer(layer_param);
+  CheckAgainstCaffeEngine(&layer, layer_param, this->blob_bottom_,
+      TypeParam(1e-3));
+}
+
+TYPED_TEST(AutotunedConvolutionLayerTest, TestUsesCache) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  this->MakeLayerParam(3, &layer_param);
+  shared_ptr<Layer<Dtype> > layer =
+      LayerRegistry<Dtype>::CreateLayer(layer_param);
+  ASSERT_TRUE(dynamic_cast<AutotunedConvolutionLayer<Dtype>*>(layer.get()));
+  TuningCache::set_file(this->cache_file_);
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> bottom_vec(1, this->blob_bottom_);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  layer->SetUp(bottom_vec, top_vec);
+  const ConvolutionParameter_Engine engine =
+      static_cast<AutotunedConvolutionLayer<Dtype>*>(layer.get())->
+      selected_engine();
+  EXPECT_EQ(1, this->CacheLines());
+  // Reloading the file, as a later process would, a layer of the same
+  // shapes takes the engine from the cache instead of timing again.
+  TuningCache::set_file(this->cache_file_);
+  AutotunedConvolutionLayer<Dtype> cached_layer(layer_param);
+  cached_layer.SetUp(bottom_vec, top_vec);
+  EXPECT_EQ(engine, cached_layer.selected_engine());
+  EXPECT_EQ(1, this->CacheLines());
+  // A new shape is tuned and recorded.
+  this->blob_bottom_->Reshape(2, 3, 10, 7);
+  cached_layer.Reshape(bottom_vec, top_vec);
+  EXPECT_EQ(2, this->CacheLines());
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -1,4 +1,5 @@
 #ifdef USE_OPENCV
+#include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
 
@@ -28,7 +29,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
       : backend_(DataParameter_DB_LEVELDB),
         blob_top_data_(new Blob<Dtype>()),
         blob_top_label_(new Blob<Dtype>()),
-        seed_(1701) {}
+        seed_(1701), transform_threads_(1) {}
   virtual void SetUp() {
     filename_.reset(new string());
     MakeTempDir(filename_.get());
@@ -75,6 +76,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_transform_threads(transform_threads_);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -105,6 +107,115 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  void TestReadSharded() {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_reader_threads(2);
+
+    // The readers cover the keys 0 and 1, and 2 to 4, taking turns.
+    const int ranges[2][3] = {{0, 1, -1}, {2, 3, 4}};
+    const int range_sizes[2] = {2, 3};
+    int positions[2] = {0, 0};
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      for (int i = 0; i < 5; ++i) {
+        const int reader = (iter * 5 + i) % 2;
+        const int label = ranges[reader][positions[reader]];
+        positions[reader] = (positions[reader] + 1) % range_sizes[reader];
+        EXPECT_EQ(label, blob_top_label_->cpu_data()[i])
+            << "debug: iter " << iter << " i " << i;
+        for (int j = 0; j < 24; ++j) {
+          EXPECT_EQ(label, blob_top_data_->cpu_data()[i * 24 + j]);
+        }
+      }
+    }
+  }
+
+  // Check that the data layer outputs the items out of order, in the same
+  // order for the same seed, and, if window_size is set, every item as often
+  // in each window of window_size items.
+  void TestReadShuffled(const LayerParameter& param, int window_size) {
+    vector<int> labels;
+    for (int run = 0; run < 2; ++run) {
+      Caffe::set_random_seed(seed_);
+      DataLayer<Dtype> layer(param);
+      layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+      for (int iter = 0; iter < 8; ++iter) {
+        layer.Forward(blob_bottom_vec_, blob_top_vec_);
+        for (int i = 0; i < 5; ++i) {
+          const int label = blob_top_label_->cpu_data()[i];
+          for (int j = 0; j < 24; ++j) {
+            EXPECT_EQ(label, blob_top_data_->cpu_data()[i * 24 + j]);
+          }
+          if (run == 0) {
+            labels.push_back(label);
+          } else {
+            EXPECT_EQ(labels[iter * 5 + i], label)
+                << "debug: iter " << iter << " i " << i;
+          }
+        }
+      }
+    }
+    int num_in_order = 0;
+    for (int i = 0; i < labels.size(); ++i) {
+      num_in_order += labels[i] == i % 5;
+    }
+    EXPECT_LT(num_in_order, labels.size());
+    for (int i = 0; i < labels.size(); ++i) {
+      EXPECT_GE(labels[i], 0);
+      EXPECT_LT(labels[i], 5);
+    }
+    for (int start = 0; window_size && start + window_size <= labels.size();
+        start += window_size) {
+      vector<int> counts(5, 0);
+      for (int i = start; i < start + window_size; ++i) {
+        ++counts[labels[i]];
+      }
+      for (int label = 0; label < 5; ++label) {
+        EXPECT_EQ(window_size / 5, counts[label])
+            << "debug: start " << start << " label " << label;
+      }
+    }
+  }
+
+  void TestReadShuffleBuffer() {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_shuffle_buffer(3);
+    // Items can stay in the buffer for several epochs.
+    TestReadShuffled(param, 0);
+  }
+
+  void TestReadKeyIndex(int reader_threads) {
+    string key_index;
+    MakeTempFilename(&key_index);
+    std::ofstream file(key_index.c_str());
+    for (int i = 0; i < 5; ++i) {
+      file << i << std::endl;
+    }
+    file.close();
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_key_index(key_index);
+    data_param->set_reader_threads(reader_threads);
+    // Every epoch is a permutation of the keys.
+    TestReadShuffled(param, 5);
+  }
+
   void TestReshape(DataParameter_DB backend) {
     const int num_inputs = 5;
     // Save data of varying shapes.
@@ -180,6 +291,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_transform_threads(transform_threads_);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -231,6 +343,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_transform_threads(transform_threads_);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -286,6 +399,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_transform_threads(transform_threads_);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -345,6 +459,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
   vector<Blob<Dtype>*> blob_bottom_vec_;
   vector<Blob<Dtype>*> blob_top_vec_;
   int seed_;
+  int transform_threads_;
 };
 
 TYPED_TEST_CASE(DataLayerTest, TestDtypesAndDevices);
@@ -387,6 +502,53 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLevelDB) {
   this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
   this->TestReadCrop(TEST);
 }
+
+TYPED_TEST(DataLayerTest, TestReadThreadedLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->transform_threads_ = 3;
+  this->TestRead();
+}
+
+// Test that the random crops of several transform threads are consistent
+// when using Caffe::set_random_seed.
+TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededThreadedLevelDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->transform_threads_ = 3;
+  this->TestReadCropTrainSequenceSeeded();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShardedLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadSharded();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffleBufferLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadShuffleBuffer();
+}
+
+TYPED_TEST(DataLayerTest, TestReadKeyIndexLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadKeyIndex(1);
+}
+
+TYPED_TEST(DataLayerTest, TestReadKeyIndexShardedLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadKeyIndex(5);
+}
+
+TYPED_TEST(DataLayerTest, TestReadKeyIndexUnevenlyShardedLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  // The 5 keys do not split evenly between the readers.
+  this->TestReadKeyIndex(2);
+}
 #endif  // USE_LEVELDB
 
 #ifdef USE_LMDB
@@ -428,6 +590,53 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLMDB) {
   this->TestReadCrop(TEST);
 }
 
+TYPED_TEST(DataLayerTest, TestReadThreadedLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->transform_threads_ = 3;
+  this->TestRead();
+}
+
+// Test that the random crops of several transform threads are consistent
+// when using Caffe::set_random_seed.
+TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededThreadedLMDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->transform_threads_ = 3;
+  this->TestReadCropTrainSequenceSeeded();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShardedLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadSharded();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffleBufferLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadShuffleBuffer();
+}
+
+TYPED_TEST(DataLayerTest, TestReadKeyIndexLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadKeyIndex(1);
+}
+
+TYPED_TEST(DataLayerTest, TestReadKeyIndexShardedLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadKeyIndex(5);
+}
+
+TYPED_TEST(DataLayerTest, TestReadKeyIndexUnevenlyShardedLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  // The 5 keys do not split evenly between the readers.
+  this->TestReadKeyIndex(2);
+}
+
 #endif  // USE_LMDB
 }  // namespace caffe
 #endif  // USE_OPENCV
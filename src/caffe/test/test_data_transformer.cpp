@@ -340,5 +340,65 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestWideRows) {
+  TransformationParameter transform_param;
+  // Rows long enough to be transformed in blocks and a remainder.
+  const int channels = 2;
+  const int height = 3;
+  const int width = 37;
+  const int size = channels * height * width;
+  const TypeParam scale = 0.25;
+
+  string mean_file;
+  MakeTempFilename(&mean_file);
+  BlobProto blob_mean;
+  blob_mean.set_num(1);
+  blob_mean.set_channels(channels);
+  blob_mean.set_height(height);
+  blob_mean.set_width(width);
+  for (int j = 0; j < size; ++j) {
+    blob_mean.add_data(j * 0.5);
+  }
+  WriteProtoToBinaryFile(blob_mean, mean_file);
+
+  transform_param.set_mean_file(mean_file);
+  transform_param.set_scale(scale);
+  transform_param.set_mirror(true);
+  Datum datum;
+  datum.set_channels(channels);
+  datum.set_height(height);
+  datum.set_width(width);
+  for (int j = 0; j < size; ++j) {
+    datum.mutable_data()->push_back(static_cast<uint8_t>((j * 7) % 256));
+  }
+  Datum float_datum = datum;
+  float_datum.clear_data();
+  for (int j = 0; j < size; ++j) {
+    float_datum.add_float_data((j * 7) % 256);
+  }
+  Blob<TypeParam> blob(1, channels, height, width);
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  Caffe::set_random_seed(this->seed_);
+  transformer.InitRand();
+  int num_mirrored = 0;
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    for (int i = 0; i < 2; ++i) {
+      transformer.Transform(i ? float_datum : datum, &blob);
+      // Each row is either transformed as is or mirrored.
+      const bool mirrored = blob.cpu_data()[0] != 0;
+      num_mirrored += mirrored;
+      for (int j = 0; j < size; ++j) {
+        const int w = j % width;
+        const int k = mirrored ? j - w + width - 1 - w : j;
+        const TypeParam expected =
+            (TypeParam((k * 7) % 256) - TypeParam(k * 0.5)) * scale;
+        EXPECT_EQ(expected, blob.cpu_data()[j]);
+      }
+    }
+  }
+  EXPECT_GT(num_mirrored, 0);
+  EXPECT_LT(num_mirrored, 2 * this->num_iter_);
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
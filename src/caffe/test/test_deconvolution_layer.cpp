@@ -6,6 +6,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/deconv_layer.hpp"
+#include "caffe/layers/fft_deconv_layer.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -301,4 +302,92 @@ TYPED_TEST(DeconvolutionLayerTest, TestGradient3D) {
       this->blob_top_vec_);
 }
 
+template <typename Dtype>
+class FFTDeconvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  FFTDeconvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 6, 6, 4)) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+  }
+
+  virtual ~FFTDeconvolutionLayerTest() { delete blob_bottom_; }
+
+  // Check Forward and Backward against DeconvolutionLayer with equal weights.
+  void Check(LayerParameter* layer_param) {
+    layer_param->mutable_convolution_param()->set_engine(
+        ConvolutionParameter_Engine_FFT);
+    DeconvolutionLayer<Dtype> ref_layer(*layer_param);
+    FFTDeconvolutionLayer<Dtype> layer(*layer_param);
+    Blob<Dtype> ref_bottom, ref_top, top;
+    ref_bottom.CopyFrom(*blob_bottom_, false, true);
+    vector<Blob<Dtype>*> ref_bottom_vec(1, &ref_bottom);
+    vector<Blob<Dtype>*> ref_top_vec(1, &ref_top);
+    vector<Blob<Dtype>*> bottom_vec(1, blob_bottom_);
+    vector<Blob<Dtype>*> top_vec(1, &top);
+    ref_layer.SetUp(ref_bottom_vec, ref_top_vec);
+    layer.SetUp(bottom_vec, top_vec);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      layer.blobs()[i]->CopyFrom(*ref_layer.blobs()[i]);
+    }
+    ref_layer.Forward(ref_bottom_vec, ref_top_vec);
+    layer.Forward(bottom_vec, top_vec);
+    ASSERT_EQ(ref_top.count(), top.count());
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_NEAR(ref_top.cpu_data()[i], top.cpu_data()[i], 1e-3);
+    }
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&ref_top);
+    caffe_copy(ref_top.count(), ref_top.cpu_data(),
+        ref_top.mutable_cpu_diff());
+    top.CopyFrom(ref_top, true);
+    vector<bool> propagate_down(1, true);
+    ref_layer.Backward(ref_top_vec, propagate_down, ref_bottom_vec);
+    layer.Backward(top_vec, propagate_down, bottom_vec);
+    for (int i = 0; i < ref_bottom.count(); ++i) {
+      EXPECT_NEAR(ref_bottom.cpu_diff()[i], blob_bottom_->cpu_diff()[i],
+          1e-3);
+    }
+    for (int j = 0; j < layer.blobs().size(); ++j) {
+      for (int i = 0; i < layer.blobs()[j]->count(); ++i) {
+        EXPECT_NEAR(ref_layer.blobs()[j]->cpu_diff()[i],
+            layer.blobs()[j]->cpu_diff()[i], 1e-3);
+      }
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+};
+
+TYPED_TEST_CASE(FFTDeconvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(FFTDeconvolutionLayerTest, TestUpsampling) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(8);
+  convolution_param->add_stride(4);
+  convolution_param->add_pad(2);
+  convolution_param->set_num_output(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  this->Check(&layer_param);
+}
+
+TYPED_TEST(FFTDeconvolutionLayerTest, TestGroup) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(9);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->set_bias_term(false);
+  this->Check(&layer_param);
+}
+
 }  // namespace caffe
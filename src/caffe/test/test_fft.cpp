@@ -0,0 +1,61 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/fft.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class FFTTest : public ::testing::Test {};
+
+TYPED_TEST_CASE(FFTTest, TestDtypes);
+
+TYPED_TEST(FFTTest, TestFFTSize) {
+  EXPECT_EQ(1, fft_size(1));
+  EXPECT_EQ(8, fft_size(5));
+  EXPECT_EQ(16, fft_size(16));
+  EXPECT_EQ(32, fft_size(17));
+}
+
+TYPED_TEST(FFTTest, TestAgainstDFT) {
+  const int height = 4;
+  const int width = 8;
+  vector<TypeParam> re(height * width), im(height * width);
+  for (int i = 0; i < height * width; ++i) {
+    re[i] = std::sin(0.3 * i) + 0.1 * i;
+    im[i] = std::cos(0.7 * i);
+  }
+  vector<TypeParam> out_re(re), out_im(im);
+  fft_2d_cpu(height, width, out_re.data(), out_im.data(), false);
+  for (int u = 0; u < height; ++u) {
+    for (int v = 0; v < width; ++v) {
+      double sum_re = 0, sum_im = 0;
+      for (int h = 0; h < height; ++h) {
+        for (int w = 0; w < width; ++w) {
+          const double angle = -2 * M_PI *
+              (static_cast<double>(u * h) / height +
+               static_cast<double>(v * w) / width);
+          const double x_re = re[h * width + w];
+          const double x_im = im[h * width + w];
+          sum_re += x_re * std::cos(angle) - x_im * std::sin(angle);
+          sum_im += x_re * std::sin(angle) + x_im * std::cos(angle);
+        }
+      }
+      EXPECT_NEAR(sum_re, out_re[u * width + v], 1e-4);
+      EXPECT_NEAR(sum_im, out_im[u * width + v], 1e-4);
+    }
+  }
+  // The inverse undoes the forward transform.
+  fft_2d_cpu(height, width, out_re.data(), out_im.data(), true);
+  for (int i = 0; i < height * width; ++i) {
+    EXPECT_NEAR(re[i], out_re[i], 1e-5);
+    EXPECT_NEAR(im[i], out_im[i], 1e-5);
+  }
+}
+
+}  // namespace caffe
@@ -11,6 +11,7 @@
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/solver_factory.hpp"
 #include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -1262,4 +1263,102 @@ TYPED_TEST(RMSPropSolverTest, TestSnapshotShare) {
   }
 }
 
+template <typename Dtype>
+class SparseUpdateSolverTest : public CPUDeviceTest<Dtype> {
+ protected:
+  // Trains an Embed layer with and without sparse_update on a batch that only
+  // uses some of its rows, and checks that those rows are updated as with
+  // dense updates while the others are left as initialized.
+  void TestSparseUpdate(const string& type, Dtype momentum) {
+    const int kInputDim = 10;
+    const int kNumIters = 3;
+    shared_ptr<Solver<Dtype> > solvers[2];
+    for (int sparse = 0; sparse < 2; ++sparse) {
+      SolverParameter param;
+      param.set_type(type);
+      param.set_base_lr(0.1);
+      param.set_lr_policy("fixed");
+      param.set_momentum(momentum);
+      param.set_weight_decay(0.1);
+      param.set_iter_size(2);
+      param.set_solver_mode(SolverParameter_SolverMode_CPU);
+      param.set_snapshot_after_train(false);
+      ostringstream proto;
+      proto <<
+          "name: 'SparseEmbedNet' "
+          "layer { name: 'data' type: 'Input' top: 'data' top: 'target' "
+          "  input_param { shape { dim: 4 } shape { dim: 4 dim: 3 } } } "
+          "layer { name: 'embed' type: 'Embed' bottom: 'data' top: 'embed' "
+          "  embed_param { num_output: 3 input_dim: " << kInputDim << " "
+          "    sparse_update: " << (sparse ? "true" : "false") << " "
+          "    weight_filler { type: 'gaussian' std: 1 } "
+          "    bias_filler { type: 'constant' value: 0.5 } } } "
+          "layer { name: 'loss' type: 'EuclideanLoss' bottom: 'embed' "
+          "  bottom: 'target' } ";
+      CHECK(google::protobuf::TextFormat::ParseFromString(proto.str(),
+          param.mutable_net_param()));
+      Caffe::set_random_seed(1701);
+      solvers[sparse].reset(SolverRegistry<Dtype>::CreateSolver(param));
+      const vector<Blob<Dtype>*>& inputs = solvers[sparse]->net()->
+          input_blobs();
+      // Rows 1, 3 and 7, one of them twice.
+      const Dtype indices[] = {1, 3, 7, 3};
+      caffe_copy(4, indices, inputs[0]->mutable_cpu_data());
+      for (int i = 0; i < inputs[1]->count(); ++i) {
+        inputs[1]->mutable_cpu_data()[i] = Dtype(i % 5) / 5;
+      }
+    }
+    Blob<Dtype> initial;
+    initial.CopyFrom(*solvers[1]->net()->learnable_params()[0], false, true);
+    solvers[0]->Step(kNumIters);
+    solvers[1]->Step(kNumIters);
+    const Blob<Dtype>& dense = *solvers[0]->net()->learnable_params()[0];
+    const Blob<Dtype>& sparse = *solvers[1]->net()->learnable_params()[0];
+    for (int k = 0; k < kInputDim; ++k) {
+      const bool used = k == 1 || k == 3 || k == 7;
+      for (int n = 0; n < 3; ++n) {
+        const Dtype expected = used ? dense.data_at(k, n, 0, 0) :
+            initial.data_at(k, n, 0, 0);
+        EXPECT_NEAR(expected, sparse.data_at(k, n, 0, 0), 1e-5)
+            << type << ": row " << k;
+        if (used) {
+          EXPECT_NE(initial.data_at(k, n, 0, 0), sparse.data_at(k, n, 0, 0));
+        }
+      }
+    }
+    // The dense bias is updated in both.
+    const Blob<Dtype>& dense_bias = *solvers[0]->net()->learnable_params()[1];
+    const Blob<Dtype>& sparse_bias = *solvers[1]->net()->learnable_params()[1];
+    for (int n = 0; n < 3; ++n) {
+      EXPECT_NEAR(dense_bias.cpu_data()[n], sparse_bias.cpu_data()[n], 1e-5);
+    }
+  }
+};
+
+TYPED_TEST_CASE(SparseUpdateSolverTest, TestDtypes);
+
+TYPED_TEST(SparseUpdateSolverTest, TestSGD) {
+  this->TestSparseUpdate("SGD", 0.9);
+}
+
+TYPED_TEST(SparseUpdateSolverTest, TestNesterov) {
+  this->TestSparseUpdate("Nesterov", 0.9);
+}
+
+TYPED_TEST(SparseUpdateSolverTest, TestAdaGrad) {
+  this->TestSparseUpdate("AdaGrad", 0);
+}
+
+TYPED_TEST(SparseUpdateSolverTest, TestRMSProp) {
+  this->TestSparseUpdate("RMSProp", 0);
+}
+
+TYPED_TEST(SparseUpdateSolverTest, TestAdaDelta) {
+  this->TestSparseUpdate("AdaDelta", 0.95);
+}
+
+TYPED_TEST(SparseUpdateSolverTest, TestAdam) {
+  this->TestSparseUpdate("Adam", 0.9);
+}
+
 }  // namespace caffe
@@ -0,0 +1,571 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/graph_optimizer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class GraphOptimizerTest : public ::testing::Test {
+ protected:
+  void RunOptimizerTest(const string& input_param_string,
+      const string& output_param_string, const string& expected_report) {
+    // Test that OptimizeGraph called on the proto specified by
+    // input_param_string results in the proto specified by
+    // output_param_string, reporting expected_report for its only pass.
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    vector<string> report;
+    OptimizeGraph(input_param, &actual_output_param, &report);
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+    ASSERT_EQ(1, report.size());
+    EXPECT_EQ(expected_report, report[0]);
+    // Also test idempotence.
+    NetParameter double_optimized_param;
+    OptimizeGraph(actual_output_param, &double_optimized_param);
+    EXPECT_EQ(actual_output_param.DebugString(),
+        double_optimized_param.DebugString());
+  }
+};
+
+TEST_F(GraphOptimizerTest, TestNoPasses) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'flatten' "
+      "  type: 'Flatten' "
+      "  bottom: 'data' "
+      "  top: 'flatten' "
+      "  flatten_param { axis: 1 end_axis: 1 } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'flatten' "
+      "  top: 'relu' "
+      "} ";
+  NetParameter input_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(input_proto,
+      &input_param));
+  NetParameter output_param;
+  vector<string> report;
+  OptimizeGraph(input_param, &output_param, &report);
+  EXPECT_EQ(input_param.DebugString(), output_param.DebugString());
+  EXPECT_EQ(0, report.size());
+}
+
+TEST_F(GraphOptimizerTest, TestEliminateDeadLayers) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { eliminate_dead_layers: true } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod1' "
+      "} "
+      "layer { "
+      "  name: 'innerprod2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'innerprod2' "
+      "  top: 'innerprod2' "
+      "} "
+      "layer { "
+      "  name: 'silence' "
+      "  type: 'Silence' "
+      "  bottom: 'innerprod2' "
+      "  bottom: 'label' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { eliminate_dead_layers: true } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod1' "
+      "} "
+      "layer { "
+      "  name: 'silence' "
+      "  type: 'Silence' "
+      "  bottom: 'label' "
+      "} ";
+  this->RunOptimizerTest(input_proto, expected_output_proto,
+      "EliminateDeadLayers removed 2: innerprod2, relu2");
+}
+
+TEST_F(GraphOptimizerTest, TestEliminateDeadLayersOutputs) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { eliminate_dead_layers: true output: 'prob' } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'innerprod' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod' "
+      "} "
+      "layer { "
+      "  name: 'prob' "
+      "  type: 'Softmax' "
+      "  bottom: 'innerprod' "
+      "  top: 'prob' "
+      "} "
+      "layer { "
+      "  name: 'accuracy' "
+      "  type: 'Accuracy' "
+      "  bottom: 'innerprod' "
+      "  bottom: 'label' "
+      "  top: 'accuracy' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'SoftmaxWithLoss' "
+      "  bottom: 'innerprod' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { eliminate_dead_layers: true output: 'prob' } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "} "
+      "layer { "
+      "  name: 'innerprod' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod' "
+      "} "
+      "layer { "
+      "  name: 'prob' "
+      "  type: 'Softmax' "
+      "  bottom: 'innerprod' "
+      "  top: 'prob' "
+      "} "
+      "layer { "
+      "  name: 'loss' "
+      "  type: 'SoftmaxWithLoss' "
+      "  bottom: 'innerprod' "
+      "  bottom: 'label' "
+      "  top: 'loss' "
+      "} ";
+  this->RunOptimizerTest(input_proto, expected_output_proto,
+      "EliminateDeadLayers removed 1: accuracy");
+}
+
+TEST_F(GraphOptimizerTest, TestConvertInPlace) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { convert_in_place: true } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'relu0' "
+      "  type: 'ReLU' "
+      "  bottom: 'data' "
+      "  top: 'relu0' "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'relu0' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'bn1' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv1' "
+      "  top: 'bn1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'bn1' "
+      "  top: 'relu1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'relu1' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'sigmoid2' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'conv2' "
+      "  top: 'sigmoid2' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'conv2' "
+      "  bottom: 'sigmoid2' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'relu3' "
+      "  type: 'ReLU' "
+      "  bottom: 'sum' "
+      "  top: 'relu3' "
+      "} ";
+  // relu0 reads an input, sigmoid2 a blob sum also reads, and relu3 computes
+  // an output.
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { convert_in_place: true } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'relu0' "
+      "  type: 'ReLU' "
+      "  bottom: 'data' "
+      "  top: 'relu0' "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'relu0' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'bn1' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'conv2' "
+      "  type: 'Convolution' "
+      "  bottom: 'conv1' "
+      "  top: 'conv2' "
+      "} "
+      "layer { "
+      "  name: 'sigmoid2' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'conv2' "
+      "  top: 'sigmoid2' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'conv2' "
+      "  bottom: 'sigmoid2' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'relu3' "
+      "  type: 'ReLU' "
+      "  bottom: 'sum' "
+      "  top: 'relu3' "
+      "} ";
+  this->RunOptimizerTest(input_proto, expected_output_proto,
+      "ConvertInPlace removed 2: bn1, relu1");
+}
+
+TEST_F(GraphOptimizerTest, TestRemoveIdentityLayers) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { remove_identity_layers: true } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'split' "
+      "  type: 'Split' "
+      "  bottom: 'data' "
+      "  top: 'split1' "
+      "  top: 'split2' "
+      "} "
+      "layer { "
+      "  name: 'flatten' "
+      "  type: 'Flatten' "
+      "  bottom: 'split1' "
+      "  top: 'flatten' "
+      "  flatten_param { axis: 2 end_axis: 2 } "
+      "} "
+      "layer { "
+      "  name: 'reshape' "
+      "  type: 'Reshape' "
+      "  bottom: 'flatten' "
+      "  top: 'reshape' "
+      "  reshape_param { shape { dim: 0 dim: 0 } axis: 1 num_axes: 2 } "
+      "} "
+      "layer { "
+      "  name: 'flatten_all' "
+      "  type: 'Flatten' "
+      "  bottom: 'split2' "
+      "  top: 'flatten_all' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'reshape' "
+      "  top: 'innerprod1' "
+      "} "
+      "layer { "
+      "  name: 'innerprod2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'flatten_all' "
+      "  top: 'innerprod2' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { remove_identity_layers: true } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Data' "
+      "  top: 'data' "
+      "} "
+      "layer { "
+      "  name: 'flatten_all' "
+      "  type: 'Flatten' "
+      "  bottom: 'data' "
+      "  top: 'flatten_all' "
+      "} "
+      "layer { "
+      "  name: 'innerprod1' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'data' "
+      "  top: 'innerprod1' "
+      "} "
+      "layer { "
+      "  name: 'innerprod2' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'flatten_all' "
+      "  top: 'innerprod2' "
+      "} ";
+  this->RunOptimizerTest(input_proto, expected_output_proto,
+      "RemoveIdentityLayers removed 3: split, flatten, reshape");
+}
+
+TEST_F(GraphOptimizerTest, TestFoldConstants) {
+  const string& input_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { fold_constants: true } "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 } } "
+      "} "
+      "layer { "
+      "  name: 'const' "
+      "  type: 'DummyData' "
+      "  top: 'const' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 } "
+      "    data_filler { type: 'constant' value: 3 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'power' "
+      "  type: 'Power' "
+      "  bottom: 'const' "
+      "  top: 'power' "
+      "  power_param { power: 2 shift: -1 } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'data' "
+      "  bottom: 'power' "
+      "  top: 'sum' "
+      "} ";
+  const string& expected_output_proto =
+      "name: 'TestNetwork' "
+      "graph_optimizer_param { fold_constants: true } "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 } } "
+      "} "
+      "layer { "
+      "  name: 'power_power_folded' "
+      "  type: 'Parameter' "
+      "  top: 'power' "
+      "  param { lr_mult: 0 decay_mult: 0 } "
+      "  blobs { "
+      "    double_data: 4 double_data: 4 double_data: 4 "
+      "    double_data: 4 double_data: 4 double_data: 4 "
+      "    shape { dim: 2 dim: 3 } "
+      "  } "
+      "  parameter_param { shape { dim: 2 dim: 3 } } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'data' "
+      "  bottom: 'power' "
+      "  top: 'sum' "
+      "} ";
+  this->RunOptimizerTest(input_proto, expected_output_proto,
+      "FoldConstants removed 2: const, power");
+}
+
+TEST_F(GraphOptimizerTest, TestNetOutputsKept) {
+  const string& proto =
+      "name: 'TestNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 4 } } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 3 "
+      "    kernel_size: 3 "
+      "    pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv' "
+      "  top: 'relu' "
+      "} "
+      "layer { "
+      "  name: 'reshape' "
+      "  type: 'Reshape' "
+      "  bottom: 'relu' "
+      "  top: 'reshape' "
+      "  reshape_param { shape { } num_axes: 0 } "
+      "} "
+      "layer { "
+      "  name: 'const' "
+      "  type: 'DummyData' "
+      "  top: 'const' "
+      "  dummy_data_param { "
+      "    shape { dim: 2 dim: 3 dim: 4 dim: 4 } "
+      "    data_filler { type: 'constant' value: 0.5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'scaled' "
+      "  type: 'Power' "
+      "  bottom: 'const' "
+      "  top: 'scaled' "
+      "  power_param { scale: 3 } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'reshape' "
+      "  bottom: 'scaled' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'unused' "
+      "  type: 'Sigmoid' "
+      "  bottom: 'data' "
+      "  top: 'unused' "
+      "} "
+      "layer { "
+      "  name: 'silence' "
+      "  type: 'Silence' "
+      "  bottom: 'unused' "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<float> ref_net(param);
+  GraphOptimizerParameter* optimizer_param =
+      param.mutable_graph_optimizer_param();
+  optimizer_param->set_eliminate_dead_layers(true);
+  optimizer_param->set_convert_in_place(true);
+  optimizer_param->set_remove_identity_layers(true);
+  optimizer_param->set_fold_constants(true);
+  Net<float> net(param);
+  // data, conv, relu, the folded scaled and sum.
+  EXPECT_EQ(5, net.layers().size());
+  NetParameter weights;
+  ref_net.ToProto(&weights);
+  net.CopyTrainedLayersFrom(weights);
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<float> filler(filler_param);
+  filler.Fill(ref_net.input_blobs()[0]);
+  net.input_blobs()[0]->CopyFrom(*ref_net.input_blobs()[0]);
+  const vector<Blob<float>*>& ref_outputs = ref_net.Forward();
+  const vector<Blob<float>*>& outputs = net.Forward();
+  ASSERT_EQ(1, ref_outputs.size());
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ("sum", net.blob_names()[net.output_blob_indices()[0]]);
+  ASSERT_EQ(ref_outputs[0]->count(), outputs[0]->count());
+  for (int i = 0; i < outputs[0]->count(); ++i) {
+    EXPECT_NEAR(ref_outputs[0]->cpu_data()[i], outputs[0]->cpu_data()[i],
+        1e-6);
+  }
+}
+
+}  // namespace caffe
@@ -42,6 +42,92 @@ class HDF5DataLayerTest : public MultiDeviceTest<TypeParam> {
     delete filename;
   }
 
+  // Read the sample data, streaming it in chunks of chunk_size rows if set.
+  void TestRead(int chunk_size) {
+    // Create LayerParameter with the known parameters.
+    // The data file we are reading has 10 rows and 8 columns,
+    // with values from 0 to 10*8 reshaped in row-major order.
+    LayerParameter param;
+    param.add_top("data");
+    param.add_top("label");
+    param.add_top("label2");
+
+    HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+    int batch_size = 5;
+    hdf5_data_param->set_batch_size(batch_size);
+    hdf5_data_param->set_source(*(this->filename));
+    hdf5_data_param->set_chunk_size(chunk_size);
+    int num_cols = 8;
+    int height = 6;
+    int width = 5;
+
+    // Test that the layer setup got the correct parameters.
+    HDF5DataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(this->blob_top_data_->num(), batch_size);
+    EXPECT_EQ(this->blob_top_data_->channels(), num_cols);
+    EXPECT_EQ(this->blob_top_data_->height(), height);
+    EXPECT_EQ(this->blob_top_data_->width(), width);
+
+    EXPECT_EQ(this->blob_top_label_->num_axes(), 2);
+    EXPECT_EQ(this->blob_top_label_->shape(0), batch_size);
+    EXPECT_EQ(this->blob_top_label_->shape(1), 1);
+
+    EXPECT_EQ(this->blob_top_label2_->num_axes(), 2);
+    EXPECT_EQ(this->blob_top_label2_->shape(0), batch_size);
+    EXPECT_EQ(this->blob_top_label2_->shape(1), 1);
+
+    // Setting up again starts over from the first file, which the streaming
+    // thread, once started, does not.
+    if (!chunk_size) {
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    }
+
+    // Go through the data 10 times (5 batches).
+    const int data_size = num_cols * height * width;
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+      // On even iterations, we're reading the first half of the data.
+      // On odd iterations, we're reading the second half of the data.
+      // NB: label is 1-indexed
+      int label_offset = 1 + ((iter % 2 == 0) ? 0 : batch_size);
+      int label2_offset = 1 + label_offset;
+      int data_offset = (iter % 2 == 0) ? 0 : batch_size * data_size;
+
+      // Every two iterations we are reading the second file,
+      // which has the same labels, but data is offset by total data size,
+      // which is 2400 (see generate_sample_data).
+      int file_offset = (iter % 4 < 2) ? 0 : 2400;
+
+      for (int i = 0; i < batch_size; ++i) {
+        EXPECT_EQ(
+          label_offset + i,
+          this->blob_top_label_->cpu_data()[i]);
+        EXPECT_EQ(
+          label2_offset + i,
+          this->blob_top_label2_->cpu_data()[i]);
+      }
+      for (int i = 0; i < batch_size; ++i) {
+        for (int j = 0; j < num_cols; ++j) {
+          for (int h = 0; h < height; ++h) {
+            for (int w = 0; w < width; ++w) {
+              int idx = (
+                i * num_cols * height * width +
+                j * height * width +
+                h * width + w);
+              EXPECT_EQ(
+                file_offset + data_offset + idx,
+                this->blob_top_data_->cpu_data()[idx])
+                << "debug: i " << i << " j " << j
+                << " iter " << iter;
+            }
+          }
+        }
+      }
+    }
+  }
+
   string* filename;
   Blob<Dtype>* const blob_top_data_;
   Blob<Dtype>* const blob_top_label_;
@@ -53,84 +139,68 @@ class HDF5DataLayerTest : public MultiDeviceTest<TypeParam> {
 TYPED_TEST_CASE(HDF5DataLayerTest, TestDtypesAndDevices);
 
 TYPED_TEST(HDF5DataLayerTest, TestRead) {
+  this->TestRead(0);
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestReadStream) {
+  // Windows that divide neither the batches nor the files.
+  this->TestRead(3);
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestReadStreamShuffle) {
   typedef typename TypeParam::Dtype Dtype;
-  // Create LayerParameter with the known parameters.
-  // The data file we are reading has 10 rows and 8 columns,
-  // with values from 0 to 10*8 reshaped in row-major order.
+  Caffe::set_random_seed(1701);
   LayerParameter param;
   param.add_top("data");
   param.add_top("label");
   param.add_top("label2");
-
   HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
-  int batch_size = 5;
+  const int batch_size = 5;
   hdf5_data_param->set_batch_size(batch_size);
   hdf5_data_param->set_source(*(this->filename));
-  int num_cols = 8;
-  int height = 6;
-  int width = 5;
-
-  // Test that the layer setup got the correct parameters.
+  hdf5_data_param->set_chunk_size(4);
+  hdf5_data_param->set_shuffle(true);
   HDF5DataLayer<Dtype> layer(param);
   layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
-  EXPECT_EQ(this->blob_top_data_->num(), batch_size);
-  EXPECT_EQ(this->blob_top_data_->channels(), num_cols);
-  EXPECT_EQ(this->blob_top_data_->height(), height);
-  EXPECT_EQ(this->blob_top_data_->width(), width);
-
-  EXPECT_EQ(this->blob_top_label_->num_axes(), 2);
-  EXPECT_EQ(this->blob_top_label_->shape(0), batch_size);
-  EXPECT_EQ(this->blob_top_label_->shape(1), 1);
-
-  EXPECT_EQ(this->blob_top_label2_->num_axes(), 2);
-  EXPECT_EQ(this->blob_top_label2_->shape(0), batch_size);
-  EXPECT_EQ(this->blob_top_label2_->shape(1), 1);
 
-  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
-
-  // Go through the data 10 times (5 batches).
-  const int data_size = num_cols * height * width;
-  for (int iter = 0; iter < 10; ++iter) {
-    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
-
-    // On even iterations, we're reading the first half of the data.
-    // On odd iterations, we're reading the second half of the data.
-    // NB: label is 1-indexed
-    int label_offset = 1 + ((iter % 2 == 0) ? 0 : batch_size);
-    int label2_offset = 1 + label_offset;
-    int data_offset = (iter % 2 == 0) ? 0 : batch_size * data_size;
-
-    // Every two iterations we are reading the second file,
-    // which has the same labels, but data is offset by total data size,
-    // which is 2400 (see generate_sample_data).
-    int file_offset = (iter % 4 < 2) ? 0 : 2400;
-
-    for (int i = 0; i < batch_size; ++i) {
-      EXPECT_EQ(
-        label_offset + i,
-        this->blob_top_label_->cpu_data()[i]);
-      EXPECT_EQ(
-        label2_offset + i,
-        this->blob_top_label2_->cpu_data()[i]);
-    }
-    for (int i = 0; i < batch_size; ++i) {
-      for (int j = 0; j < num_cols; ++j) {
-        for (int h = 0; h < height; ++h) {
-          for (int w = 0; w < width; ++w) {
-            int idx = (
-              i * num_cols * height * width +
-              j * height * width +
-              h * width + w);
-            EXPECT_EQ(
-              file_offset + data_offset + idx,
-              this->blob_top_data_->cpu_data()[idx])
-              << "debug: i " << i << " j " << j
-              << " iter " << iter;
+  // Each epoch outputs the 10 rows of one file, then those of the other, in
+  // a random order.
+  const int num_rows = 10;
+  const int data_size = 8 * 6 * 5;
+  int num_in_order = 0;
+  for (int epoch = 0; epoch < 3; ++epoch) {
+    vector<int> files;
+    for (int file = 0; file < 2; ++file) {
+      vector<int> counts(num_rows, 0);
+      for (int iter = 0; iter < num_rows / batch_size; ++iter) {
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        for (int i = 0; i < batch_size; ++i) {
+          const int row = this->blob_top_label_->cpu_data()[i] - 1;
+          ASSERT_GE(row, 0);
+          ASSERT_LT(row, num_rows);
+          ++counts[row];
+          num_in_order += row == iter * batch_size + i;
+          // The second file has its data offset by 2400.
+          const int offset =
+              this->blob_top_data_->cpu_data()[i * data_size] - row * data_size;
+          EXPECT_TRUE(offset == 0 || offset == 2400);
+          if (iter == 0 && i == 0) {
+            files.push_back(offset);
+          }
+          EXPECT_EQ(files.back(), offset);
+          for (int j = 0; j < data_size; ++j) {
+            EXPECT_EQ(offset + row * data_size + j,
+                this->blob_top_data_->cpu_data()[i * data_size + j]);
           }
         }
       }
+      for (int row = 0; row < num_rows; ++row) {
+        EXPECT_EQ(1, counts[row]);
+      }
     }
+    EXPECT_NE(files[0], files[1]);
   }
+  EXPECT_LT(num_in_order, 3 * 2 * num_rows);
 }
 
 }  // namespace caffe
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <cstdlib>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_memory_pool.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostMemoryPoolTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    was_enabled_ = HostMemoryPool::enabled();
+    HostMemoryPool::set_enabled(true);
+    HostMemoryPool::set_max_cached_bytes(0);
+    HostMemoryPool::Trim();
+    HostMemoryPool::ResetStats();
+  }
+  virtual void TearDown() {
+    HostMemoryPool::set_enabled(was_enabled_);
+    HostMemoryPool::set_max_cached_bytes(0);
+    HostMemoryPool::Trim();
+  }
+
+  bool was_enabled_;
+};
+
+TEST_F(HostMemoryPoolTest, TestSizeClass) {
+  EXPECT_EQ(HostMemoryPool::SizeClass(1), 64);
+  EXPECT_EQ(HostMemoryPool::SizeClass(64), 64);
+  EXPECT_EQ(HostMemoryPool::SizeClass(65), 80);
+  EXPECT_EQ(HostMemoryPool::SizeClass(1000), 1024);
+  EXPECT_EQ(HostMemoryPool::SizeClass(1025), 1280);
+  for (size_t size = 1; size < 100000; size += 37) {
+    const size_t size_class = HostMemoryPool::SizeClass(size);
+    EXPECT_GE(size_class, size);
+    EXPECT_LE(size_class, size + size / 4 + 64);
+  }
+}
+
+TEST_F(HostMemoryPoolTest, TestAlignment) {
+  for (size_t size = 1; size < 5000; size += 333) {
+    void* ptr = HostMemoryPool::Allocate(size);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % HostMemoryPool::kAlignment,
+              0);
+    EXPECT_TRUE(HostMemoryPool::Free(ptr));
+  }
+}
+
+TEST_F(HostMemoryPoolTest, TestReuse) {
+  void* first = HostMemoryPool::Allocate(1000);
+  HostMemoryPool::Stats stats = HostMemoryPool::stats();
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.hits, 0);
+  EXPECT_EQ(stats.bytes_in_use, 1024);
+  EXPECT_TRUE(HostMemoryPool::Free(first));
+  stats = HostMemoryPool::stats();
+  EXPECT_EQ(stats.bytes_in_use, 0);
+  EXPECT_EQ(stats.bytes_cached, 1024);
+  // A different size in the same class is served from the cache.
+  void* second = HostMemoryPool::Allocate(990);
+  EXPECT_EQ(first, second);
+  stats = HostMemoryPool::stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.bytes_cached, 0);
+  EXPECT_EQ(stats.peak_bytes_held, 1024);
+  EXPECT_TRUE(HostMemoryPool::Free(second));
+}
+
+TEST_F(HostMemoryPoolTest, TestForeignPointer) {
+  void* ptr = malloc(16);
+  EXPECT_FALSE(HostMemoryPool::Free(ptr));
+  free(ptr);
+}
+
+TEST_F(HostMemoryPoolTest, TestMaxCachedBytes) {
+  HostMemoryPool::set_max_cached_bytes(1024);
+  void* a = HostMemoryPool::Allocate(1024);
+  void* b = HostMemoryPool::Allocate(1024);
+  EXPECT_TRUE(HostMemoryPool::Free(a));
+  EXPECT_TRUE(HostMemoryPool::Free(b));
+  EXPECT_EQ(HostMemoryPool::stats().bytes_cached, 1024);
+  HostMemoryPool::Trim();
+  EXPECT_EQ(HostMemoryPool::stats().bytes_cached, 0);
+}
+
+TEST_F(HostMemoryPoolTest, TestDisableKeepsLiveBlocks) {
+  void* ptr = HostMemoryPool::Allocate(100);
+  HostMemoryPool::set_enabled(false);
+  // Blocks handed out before the pool was disabled are still returned to it.
+  EXPECT_TRUE(HostMemoryPool::Free(ptr));
+  EXPECT_EQ(HostMemoryPool::stats().bytes_in_use, 0);
+  EXPECT_EQ(HostMemoryPool::stats().bytes_cached, 0);
+}
+
+TEST_F(HostMemoryPoolTest, TestSyncedMemoryReuse) {
+  void* first;
+  {
+    SyncedMemory mem(4000);
+    first = mem.mutable_cpu_data();
+    caffe_memset(mem.size(), 1, first);
+  }
+  SyncedMemory mem(3900);
+  EXPECT_EQ(mem.mutable_cpu_data(), first);
+  EXPECT_EQ(HostMemoryPool::stats().hits, 1);
+  // Reused blocks are zeroed like fresh ones.
+  const char* data = static_cast<const char*>(mem.cpu_data());
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ(data[i], 0);
+  }
+}
+
+}  // namespace caffe
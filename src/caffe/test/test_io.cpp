@@ -320,6 +320,77 @@ TEST_F(IOTest, TestDecodeDatumToCVMat) {
   EXPECT_EQ(cv_img.cols, 480);
 }
 
+TEST_F(IOTest, TestDecodeDatumToCVMatScaled) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  Datum datum;
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  // The image may be decoded smaller, but never below the minimum size.
+  cv::Mat cv_img = DecodeDatumToCVMat(datum, true, 100, 150);
+  EXPECT_EQ(cv_img.channels(), 3);
+  EXPECT_GE(cv_img.rows, 100);
+  EXPECT_GE(cv_img.cols, 150);
+  EXPECT_LE(cv_img.rows, 360);
+  EXPECT_EQ(cv_img.rows * 480, cv_img.cols * 360);
+  cv_img = DecodeDatumToCVMat(datum, false, 100, 150);
+  EXPECT_EQ(cv_img.channels(), 1);
+  EXPECT_GE(cv_img.rows, 100);
+  EXPECT_GE(cv_img.cols, 150);
+  // Sizes larger than half the image leave it full size.
+  cv_img = DecodeDatumToCVMat(datum, true, 181, 1);
+  EXPECT_EQ(cv_img.rows, 360);
+  EXPECT_EQ(cv_img.cols, 480);
+}
+
+// Inserts an EXIF segment rotating the image by 90 degrees after the SOI
+// marker of a JPEG.
+void AddEXIFRotation(Datum* datum) {
+  const char exif[] = {
+      '\xFF', '\xE1', 0, 34,                    // APP1 and its length
+      'E', 'x', 'i', 'f', 0, 0,
+      'M', 'M', 0, 42, 0, 0, 0, 8,              // TIFF header
+      0, 1,                                     // one IFD entry
+      1, 18, 0, 3, 0, 0, 0, 1, 0, 6, 0, 0,      // Orientation = 6
+      0, 0, 0, 0};
+  string data = datum->data();
+  data.insert(2, exif, sizeof(exif));
+  datum->set_data(data);
+}
+
+TEST_F(IOTest, TestDecodeDatumToCVMatScaledOrientation) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  Datum datum;
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  AddEXIFRotation(&datum);
+  // A scaled decode is oriented like the full size one.
+  cv::Mat full = DecodeDatumToCVMat(datum, true);
+  cv::Mat scaled = DecodeDatumToCVMat(datum, true, 100, 100);
+  EXPECT_EQ(scaled.rows * full.cols, scaled.cols * full.rows);
+  full = DecodeDatumToCVMat(datum, false);
+  scaled = DecodeDatumToCVMat(datum, false, 100, 100);
+  EXPECT_EQ(scaled.rows * full.cols, scaled.cols * full.rows);
+  full = DecodeDatumToCVMatNative(datum);
+  scaled = DecodeDatumToCVMatNative(datum, 100, 100);
+  EXPECT_EQ(scaled.rows * full.cols, scaled.cols * full.rows);
+}
+
+TEST_F(IOTest, TestDecodeDatumToCVMatNativeScaledGray) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat_gray.jpg";
+  Datum datum;
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  cv::Mat cv_img = DecodeDatumToCVMatNative(datum, 50, 50);
+  EXPECT_EQ(cv_img.channels(), 1);
+  EXPECT_GE(cv_img.rows, 50);
+  EXPECT_GE(cv_img.cols, 50);
+}
+
+TEST_F(IOTest, TestReadImageToCVMatScaledResized) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  cv::Mat cv_img = ReadImageToCVMat(filename, 100, 100, true, 100, 100);
+  EXPECT_EQ(cv_img.channels(), 3);
+  EXPECT_EQ(cv_img.rows, 100);
+  EXPECT_EQ(cv_img.cols, 100);
+}
+
 TEST_F(IOTest, TestDecodeDatumToCVMatContent) {
   string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
   Datum datum;
@@ -0,0 +1,146 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/util/mapped_datum.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class MappedDatumTest : public ::testing::Test {
+ protected:
+  MappedDatumTest() {
+    datum_.set_channels(2);
+    datum_.set_height(3);
+    datum_.set_width(4);
+    datum_.set_label(7);
+    string data(2 * 3 * 4, 0);
+    for (int i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<char>(i * 5);
+    }
+    datum_.set_data(data);
+    datum_.SerializeToString(&serialized_);
+  }
+
+  void ExpectSameFields(const Datum& datum) {
+    EXPECT_EQ(datum_.channels(), datum.channels());
+    EXPECT_EQ(datum_.height(), datum.height());
+    EXPECT_EQ(datum_.width(), datum.width());
+    EXPECT_EQ(datum_.label(), datum.label());
+    EXPECT_EQ(datum_.encoded(), datum.encoded());
+  }
+
+  Datum datum_;
+  string serialized_;
+};
+
+TEST_F(MappedDatumTest, TestParseMapped) {
+  MappedDatum mapped;
+  ASSERT_TRUE(mapped.Parse(serialized_.data(), serialized_.size(), true));
+  EXPECT_TRUE(mapped.is_mapped());
+  ExpectSameFields(mapped.datum());
+  EXPECT_EQ(0, mapped.datum().data().size());
+  // The data bytes are those of the serialized value, not a copy.
+  EXPECT_GE(mapped.data(), serialized_.data());
+  EXPECT_LE(mapped.data() + mapped.data_size(),
+      serialized_.data() + serialized_.size());
+  EXPECT_EQ(datum_.data(), string(mapped.data(), mapped.data_size()));
+}
+
+TEST_F(MappedDatumTest, TestParseCopied) {
+  MappedDatum mapped;
+  ASSERT_TRUE(mapped.Parse(serialized_.data(), serialized_.size(), false));
+  EXPECT_FALSE(mapped.is_mapped());
+  ExpectSameFields(mapped.datum());
+  EXPECT_EQ(mapped.datum().data().data(), mapped.data());
+  EXPECT_EQ(datum_.data(), string(mapped.data(), mapped.data_size()));
+}
+
+TEST_F(MappedDatumTest, TestParseFloatData) {
+  Datum datum;
+  datum.set_channels(1);
+  datum.set_height(1);
+  datum.set_width(3);
+  datum.add_float_data(0.5);
+  datum.add_float_data(-1);
+  datum.add_float_data(2);
+  string serialized;
+  datum.SerializeToString(&serialized);
+  MappedDatum mapped;
+  ASSERT_TRUE(mapped.Parse(serialized.data(), serialized.size(), true));
+  EXPECT_FALSE(mapped.is_mapped());
+  EXPECT_EQ(0, mapped.data_size());
+  ASSERT_EQ(3, mapped.datum().float_data_size());
+  EXPECT_EQ(0.5, mapped.datum().float_data(0));
+  EXPECT_EQ(-1, mapped.datum().float_data(1));
+  EXPECT_EQ(2, mapped.datum().float_data(2));
+}
+
+TEST_F(MappedDatumTest, TestParseReuse) {
+  MappedDatum mapped;
+  ASSERT_TRUE(mapped.Parse(serialized_.data(), serialized_.size(), true));
+  Datum other;
+  other.set_channels(1);
+  other.set_height(1);
+  other.set_width(1);
+  other.set_label(3);
+  other.set_data(string(1, 9));
+  string serialized;
+  other.SerializeToString(&serialized);
+  ASSERT_TRUE(mapped.Parse(serialized.data(), serialized.size(), true));
+  EXPECT_EQ(1, mapped.datum().channels());
+  EXPECT_EQ(3, mapped.datum().label());
+  ASSERT_EQ(1, mapped.data_size());
+  EXPECT_EQ(9, mapped.data()[0]);
+}
+
+TEST_F(MappedDatumTest, TestSwap) {
+  MappedDatum mapped, copied;
+  ASSERT_TRUE(mapped.Parse(serialized_.data(), serialized_.size(), true));
+  ASSERT_TRUE(copied.Parse(serialized_.data(), serialized_.size(), false));
+  const char* data = mapped.data();
+  mapped.Swap(&copied);
+  EXPECT_FALSE(mapped.is_mapped());
+  EXPECT_TRUE(copied.is_mapped());
+  EXPECT_EQ(data, copied.data());
+  ExpectSameFields(mapped.datum());
+  ExpectSameFields(copied.datum());
+  EXPECT_EQ(datum_.data(), string(mapped.data(), mapped.data_size()));
+  EXPECT_EQ(datum_.data(), string(copied.data(), copied.data_size()));
+}
+
+TEST_F(MappedDatumTest, TestParseInvalid) {
+  MappedDatum mapped;
+  // Truncating the value cuts the data field short.
+  EXPECT_FALSE(mapped.Parse(serialized_.data(), serialized_.size() - 1,
+      true));
+  EXPECT_FALSE(mapped.is_mapped());
+  EXPECT_FALSE(mapped.Parse(serialized_.data(), serialized_.size() - 1,
+      false));
+}
+
+TEST_F(MappedDatumTest, TestTransformMapped) {
+  MappedDatum mapped;
+  ASSERT_TRUE(mapped.Parse(serialized_.data(), serialized_.size(), true));
+  TransformationParameter param;
+  param.set_scale(0.5);
+  param.add_mean_value(1);
+  DataTransformer<float> transformer(param, TEST);
+  transformer.InitRand();
+  vector<int> shape = transformer.InferBlobShape(mapped);
+  EXPECT_EQ(transformer.InferBlobShape(datum_), shape);
+  Blob<float> expected(shape);
+  Blob<float> actual(shape);
+  transformer.Transform(datum_, &expected);
+  transformer.Transform(mapped, &actual);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], actual.cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
@@ -771,6 +771,378 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitOptimizeMemoryNet(const bool optimize_memory) {
+    string proto =
+        "name: 'OptimizeMemoryNetwork' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { "
+        "  shape: { dim: 2 dim: 3 dim: 10 dim: 10 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'pool1' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv1' "
+        "  top: 'pool1' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv2a' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv2a' "
+        "  convolution_param { "
+        "    num_output: 6 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv2b' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv2b' "
+        "  convolution_param { "
+        "    num_output: 6 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'conv2a' "
+        "  bottom: 'conv2b' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'flat' "
+        "  type: 'Flatten' "
+        "  bottom: 'sum' "
+        "  top: 'flat' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'flat' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'prob' "
+        "  type: 'Softmax' "
+        "  bottom: 'ip' "
+        "  top: 'prob' "
+        "} ";
+    if (optimize_memory) {
+      proto += "optimize_memory: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitCheckpointNet(const bool checkpoint) {
+    string proto =
+        "name: 'CheckpointNetwork' "
+        "state { phase: TRAIN } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  top: 'label' "
+        "  input_param { "
+        "  shape: { dim: 2 dim: 3 dim: 10 dim: 10 } "
+        "  shape: { dim: 2 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'pool1' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv1' "
+        "  top: 'pool1' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv2a' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv2a' "
+        "  convolution_param { "
+        "    num_output: 6 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv2b' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv2b' "
+        "  convolution_param { "
+        "    num_output: 6 "
+        "    kernel_size: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'conv2a' "
+        "  bottom: 'conv2b' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'sum' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'ip' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    if (checkpoint) {
+      proto += "checkpoint_param { segment_size: 4 } ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitFusionNet(const bool fuse) {
+    string proto =
+        "name: 'FusionNetwork' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape: { dim: 2 dim: 3 dim: 8 dim: 8 } } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'bn1' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv1' "
+        "  top: 'bn1' "
+        "} "
+        "layer { "
+        "  name: 'scale1' "
+        "  type: 'Scale' "
+        "  bottom: 'bn1' "
+        "  top: 'bn1' "
+        "  scale_param { bias_term: true } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'bn1' "
+        "  top: 'bn1' "
+        "  relu_param { negative_slope: 0.1 } "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'bn1' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 5 "
+        "    kernel_size: 1 "
+        "    bias_term: false "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'bn2' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv2' "
+        "  top: 'conv2' "
+        "} "
+        "layer { "
+        "  name: 'conv3' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv2' "
+        "  top: 'conv3' "
+        "  convolution_param { "
+        "    num_output: 5 "
+        "    kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'bn3' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv3' "
+        "  top: 'bn3' "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'conv3' "
+        "  bottom: 'bn3' "
+        "  top: 'sum' "
+        "} ";
+    if (fuse) {
+      proto += "fuse_convolution: true ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
+  virtual void InitConvertInPlaceNet(const bool convert) {
+    string proto =
+        "name: 'ConvertInPlaceNetwork' "
+        "state { phase: TRAIN } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  top: 'target' "
+        "  input_param { "
+        "    shape: { dim: 4 dim: 6 } "
+        "    shape: { dim: 4 dim: 5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'ip1' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip1' "
+        "  inner_product_param { "
+        "    num_output: 8 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sigmoid1' "
+        "  type: 'Sigmoid' "
+        "  bottom: 'ip1' "
+        "  top: 'sigmoid1' "
+        "} "
+        "layer { "
+        "  name: 'ip2' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'sigmoid1' "
+        "  top: 'ip2' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.5 } "
+        "    bias_filler { type: 'gaussian' std: 0.5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'tanh2' "
+        "  type: 'TanH' "
+        "  bottom: 'ip2' "
+        "  top: 'tanh2' "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'tanh2' "
+        "  top: 'relu2' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'EuclideanLoss' "
+        "  bottom: 'relu2' "
+        "  bottom: 'target' "
+        "} ";
+    if (convert) {
+      proto += "graph_optimizer_param { convert_in_place: true } ";
+    }
+    InitNetFromProtoString(proto);
+  }
+
   int seed_;
   shared_ptr<Net<Dtype> > net_;
 };
@@ -2473,4 +2845,203 @@ TYPED_TEST(NetTest, TestForcePropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestOptimizeMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input1(2, 3, 10, 10);
+  Blob<Dtype> input2(3, 3, 10, 10);
+  filler.Fill(&input1);
+  filler.Fill(&input2);
+
+  this->InitOptimizeMemoryNet(false);
+  shared_ptr<Net<Dtype> > ref_net = this->net_;
+  this->InitOptimizeMemoryNet(true);
+  NetParameter weights;
+  ref_net->ToProto(&weights);
+  this->net_->CopyTrainedLayersFrom(weights);
+
+  // Blobs with disjoint lifetimes are placed in the same memory, while
+  // Flatten keeps sharing its bottom's memory.
+  EXPECT_TRUE(this->net_->blob_by_name("conv1")->data() ==
+              this->net_->blob_by_name("conv2a")->data());
+  EXPECT_TRUE(this->net_->blob_by_name("sum")->data() ==
+              this->net_->blob_by_name("flat")->data());
+  EXPECT_FALSE(this->net_->blob_by_name("conv2a")->data() ==
+               this->net_->blob_by_name("conv2b")->data());
+  EXPECT_FALSE(this->net_->blob_by_name("data")->data() ==
+               this->net_->blob_by_name("prob")->data());
+
+  Blob<Dtype>* inputs[] = { &input1, &input2 };
+  for (int i = 0; i < 2; ++i) {
+    Blob<Dtype>* input = inputs[i];
+    ref_net->input_blobs()[0]->ReshapeLike(*input);
+    ref_net->input_blobs()[0]->CopyFrom(*input);
+    ref_net->Reshape();
+    this->net_->input_blobs()[0]->ReshapeLike(*input);
+    this->net_->input_blobs()[0]->CopyFrom(*input);
+    this->net_->Reshape();
+    const Blob<Dtype>* ref_output = ref_net->Forward()[0];
+    const Blob<Dtype>* output = this->net_->Forward()[0];
+    ASSERT_EQ(ref_output->count(), output->count());
+    for (int j = 0; j < output->count(); ++j) {
+      EXPECT_NEAR(ref_output->cpu_data()[j], output->cpu_data()[j], 1e-6);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestCheckpoint) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitCheckpointNet(false);
+  shared_ptr<Net<Dtype> > ref_net = this->net_;
+  this->InitCheckpointNet(true);
+  NetParameter weights;
+  ref_net->ToProto(&weights);
+  this->net_->CopyTrainedLayersFrom(weights);
+  EXPECT_FALSE(ref_net->checkpointing());
+  EXPECT_TRUE(this->net_->checkpointing());
+  size_t full_bytes, peak_bytes;
+  this->net_->CheckpointMemory(&full_bytes, &peak_bytes);
+  EXPECT_LT(peak_bytes, full_bytes);
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int iter = 0; iter < 2; ++iter) {
+    filler.Fill(ref_net->blob_by_name("data").get());
+    Blob<Dtype>* label = ref_net->blob_by_name("label").get();
+    for (int i = 0; i < label->count(); ++i) {
+      label->mutable_cpu_data()[i] = (i + iter) % 5;
+    }
+    this->net_->blob_by_name("data")->CopyFrom(
+        *ref_net->blob_by_name("data"));
+    this->net_->blob_by_name("label")->CopyFrom(*label);
+    ref_net->ClearParamDiffs();
+    this->net_->ClearParamDiffs();
+    Dtype ref_loss, loss;
+    ref_net->Forward(&ref_loss);
+    this->net_->Forward(&loss);
+    EXPECT_NEAR(ref_loss, loss, 1e-6);
+    // conv1 is dropped after the first segment, while pool1 is kept as the
+    // input of the second one.
+    EXPECT_EQ(this->net_->blob_by_name("conv1")->data()->head(),
+              SyncedMemory::UNINITIALIZED);
+    EXPECT_NE(this->net_->blob_by_name("pool1")->data()->head(),
+              SyncedMemory::UNINITIALIZED);
+    ref_net->Backward();
+    this->net_->Backward();
+    const vector<Blob<Dtype>*>& ref_params = ref_net->learnable_params();
+    const vector<Blob<Dtype>*>& params = this->net_->learnable_params();
+    ASSERT_EQ(ref_params.size(), params.size());
+    for (int i = 0; i < params.size(); ++i) {
+      for (int j = 0; j < params[i]->count(); ++j) {
+        EXPECT_NEAR(ref_params[i]->cpu_diff()[j], params[i]->cpu_diff()[j],
+                    1e-6);
+      }
+    }
+  }
+  EXPECT_GE(this->net_->recompute_time(), 0);
+}
+
+TYPED_TEST(NetTest, TestFuseConvolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitFusionNet(false);
+  shared_ptr<Net<Dtype> > ref_net = this->net_;
+  EXPECT_EQ(0, ref_net->fused_convolutions().size());
+  // Give the BatchNorm and Scale layers statistics and parameters that are
+  // far from the identity.
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> gaussian_filler(filler_param);
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> uniform_filler(filler_param);
+  for (int i = 0; i < ref_net->layers().size(); ++i) {
+    Layer<Dtype>* layer = ref_net->layers()[i].get();
+    if (string(layer->type()) == "BatchNorm") {
+      gaussian_filler.Fill(layer->blobs()[0].get());
+      uniform_filler.Fill(layer->blobs()[1].get());
+      layer->blobs()[2]->mutable_cpu_data()[0] = 2;
+    } else if (string(layer->type()) == "Scale") {
+      uniform_filler.Fill(layer->blobs()[0].get());
+      gaussian_filler.Fill(layer->blobs()[1].get());
+    }
+  }
+  this->InitFusionNet(true);
+  NetParameter weights;
+  ref_net->ToProto(&weights);
+  this->net_->CopyTrainedLayersFrom(weights);
+
+  // conv1 -> bn1 -> scale1 -> relu1 and conv2 -> bn2 are fused, but not
+  // conv3 -> bn3 as conv3 is also read by the Eltwise layer.
+  const vector<vector<int> >& fused = this->net_->fused_convolutions();
+  ASSERT_EQ(2, fused.size());
+  ASSERT_EQ(4, fused[0].size());
+  EXPECT_EQ("conv1", this->net_->layer_names()[fused[0][0]]);
+  EXPECT_EQ("relu1", this->net_->layer_names()[fused[0][3]]);
+  ASSERT_EQ(2, fused[1].size());
+  EXPECT_EQ("conv2", this->net_->layer_names()[fused[1][0]]);
+  EXPECT_EQ("bn2", this->net_->layer_names()[fused[1][1]]);
+  EXPECT_FALSE(this->net_->has_blob("conv1"));
+
+  for (int iter = 0; iter < 2; ++iter) {
+    gaussian_filler.Fill(ref_net->input_blobs()[0]);
+    this->net_->input_blobs()[0]->CopyFrom(*ref_net->input_blobs()[0]);
+    const Blob<Dtype>* ref_output = ref_net->Forward()[0];
+    const Blob<Dtype>* output = this->net_->Forward()[0];
+    ASSERT_EQ(ref_output->count(), output->count());
+    for (int i = 0; i < output->count(); ++i) {
+      EXPECT_NEAR(ref_output->cpu_data()[i], output->cpu_data()[i], 1e-4);
+    }
+    // Changed parameters are folded again on the next Forward.
+    Blob<Dtype>* gamma = ref_net->layer_by_name("scale1")->blobs()[0].get();
+    uniform_filler.Fill(gamma);
+    this->net_->layer_by_name("scale1")->blobs()[0]->CopyFrom(*gamma);
+  }
+  // Starting inside a chain gives the same output as starting before it.
+  const Blob<Dtype>* ref_output = ref_net->Forward()[0];
+  this->net_->Forward();
+  this->net_->ForwardFrom(fused[0][2]);
+  const Blob<Dtype>* output = this->net_->output_blobs()[0];
+  for (int i = 0; i < output->count(); ++i) {
+    EXPECT_NEAR(ref_output->cpu_data()[i], output->cpu_data()[i], 1e-4);
+  }
+}
+
+TYPED_TEST(NetTest, TestConvertInPlaceGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitConvertInPlaceNet(false);
+  shared_ptr<Net<Dtype> > ref_net = this->net_;
+  this->InitConvertInPlaceNet(true);
+  NetParameter weights;
+  ref_net->ToProto(&weights);
+  this->net_->CopyTrainedLayersFrom(weights);
+  // The Sigmoid and the TanH compute in place on the InnerProducts' tops,
+  // but the ReLU not on the TanH's, which TanH reads in Backward.
+  EXPECT_FALSE(this->net_->has_blob("sigmoid1"));
+  EXPECT_FALSE(this->net_->has_blob("tanh2"));
+  EXPECT_TRUE(this->net_->has_blob("relu2"));
+
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < ref_net->input_blobs().size(); ++i) {
+    filler.Fill(ref_net->input_blobs()[i]);
+    this->net_->input_blobs()[i]->CopyFrom(*ref_net->input_blobs()[i]);
+  }
+  const Dtype ref_loss = ref_net->ForwardBackward();
+  const Dtype loss = this->net_->ForwardBackward();
+  EXPECT_NEAR(ref_loss, loss, 1e-5);
+  const vector<shared_ptr<Blob<Dtype> > >& ref_params = ref_net->params();
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  ASSERT_EQ(ref_params.size(), params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_NEAR(ref_params[i]->cpu_diff()[j], params[i]->cpu_diff()[j],
+          1e-5);
+    }
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,214 @@
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/packed_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/packed_tensor.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class PackedDataLayerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  PackedDataLayerTest()
+      : num_records_(5),
+        blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+    MakeTempFilename(&filename_);
+  }
+
+  virtual ~PackedDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // Write records whose data items, of shape 2 x 2 x 3, hold record * 12,
+  // record * 12 + 1, ... and whose label is the record.
+  void Write(PackedType data_type) {
+    vector<int> shape(3);
+    shape[0] = 2;
+    shape[1] = 2;
+    shape[2] = 3;
+    PackedTensorWriter writer;
+    writer.AddTensor("label", PACKED_FLOAT, vector<int>());
+    writer.AddTensor("data", data_type, shape);
+    writer.Open(filename_, num_records_);
+    for (int r = 0; r < num_records_; ++r) {
+      const float label = r;
+      writer.Write(0, r, &label);
+      for (int i = 0; i < 12; ++i) {
+        const double value = r * 12 + i;
+        switch (data_type) {
+        case PACKED_UINT8:
+          reinterpret_cast<uint8_t*>(writer.mutable_item(1, r))[i] = value;
+          break;
+        case PACKED_FLOAT:
+          reinterpret_cast<float*>(writer.mutable_item(1, r))[i] = value;
+          break;
+        case PACKED_DOUBLE:
+          reinterpret_cast<double*>(writer.mutable_item(1, r))[i] = value;
+          break;
+        }
+      }
+    }
+    writer.Close();
+  }
+
+  LayerParameter Param(int batch_size, bool shuffle) {
+    LayerParameter param;
+    param.add_top("data");
+    param.add_top("label");
+    PackedDataParameter* packed_data_param = param.mutable_packed_data_param();
+    packed_data_param->set_source(filename_);
+    packed_data_param->set_batch_size(batch_size);
+    packed_data_param->set_shuffle(shuffle);
+    return param;
+  }
+
+  // Check the records of the batch have the data they were written with, and
+  // return their labels.
+  vector<int> CheckBatch() {
+    vector<int> labels;
+    for (int n = 0; n < blob_top_label_->count(); ++n) {
+      const int r = blob_top_label_->cpu_data()[n];
+      labels.push_back(r);
+      for (int i = 0; i < 12; ++i) {
+        EXPECT_EQ(r * 12 + i, blob_top_data_->cpu_data()[n * 12 + i]);
+      }
+    }
+    return labels;
+  }
+
+  void TestRead(PackedType data_type) {
+    Write(data_type);
+    PackedDataLayer<Dtype> layer(Param(3, false));
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    EXPECT_EQ(3, blob_top_data_->num());
+    EXPECT_EQ(2, blob_top_data_->channels());
+    EXPECT_EQ(2, blob_top_data_->height());
+    EXPECT_EQ(3, blob_top_data_->width());
+    ASSERT_EQ(1, blob_top_label_->num_axes());
+    EXPECT_EQ(3, blob_top_label_->num());
+    // Batches wrap around the end of the file.
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      vector<int> labels = CheckBatch();
+      for (int n = 0; n < labels.size(); ++n) {
+        EXPECT_EQ((iter * 3 + n) % num_records_, labels[n]);
+      }
+    }
+  }
+
+  int num_records_;
+  string filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(PackedDataLayerTest, TestDtypesAndDevices);
+
+TYPED_TEST(PackedDataLayerTest, TestReadFloat) {
+  this->TestRead(PACKED_FLOAT);
+}
+
+TYPED_TEST(PackedDataLayerTest, TestReadDouble) {
+  this->TestRead(PACKED_DOUBLE);
+}
+
+TYPED_TEST(PackedDataLayerTest, TestReadUInt8) {
+  this->TestRead(PACKED_UINT8);
+}
+
+TYPED_TEST(PackedDataLayerTest, TestWriteInPlace) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Write(packed_type<Dtype>());
+  PackedDataLayer<Dtype> layer(this->Param(this->num_records_, false));
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The tops point into the file; what is written there is dropped by the
+  // next batch.
+  for (int iter = 0; iter < 3; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    this->CheckBatch();
+    caffe_set(this->blob_top_data_->count(), Dtype(-1),
+        this->blob_top_data_->mutable_cpu_data());
+    caffe_set(this->blob_top_label_->count(), Dtype(0),
+        this->blob_top_label_->mutable_cpu_data());
+  }
+  PackedTensorFile file;
+  file.Open(this->filename_);
+  float label;
+  file.Read(0, this->num_records_ - 1, &label);
+  EXPECT_EQ(this->num_records_ - 1, label);
+}
+
+TYPED_TEST(PackedDataLayerTest, TestShuffle) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Write(PACKED_FLOAT);
+  Caffe::set_random_seed(1701);
+  PackedDataLayer<Dtype> layer(this->Param(this->num_records_, true));
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  int num_in_order = 0;
+  const int num_epochs = 5;
+  for (int epoch = 0; epoch < num_epochs; ++epoch) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    vector<int> labels = this->CheckBatch();
+    vector<int> counts(this->num_records_, 0);
+    for (int n = 0; n < labels.size(); ++n) {
+      ++counts[labels[n]];
+      num_in_order += labels[n] == n;
+    }
+    for (int r = 0; r < this->num_records_; ++r) {
+      EXPECT_EQ(1, counts[r]);
+    }
+  }
+  EXPECT_LT(num_in_order, num_epochs * this->num_records_);
+}
+
+TYPED_TEST(PackedDataLayerTest, TestTransform) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->Write(PACKED_UINT8);
+  LayerParameter param = this->Param(2, false);
+  param.set_phase(TEST);
+  param.mutable_transform_param()->set_crop_size(2);
+  param.mutable_transform_param()->set_scale(0.5);
+  param.mutable_transform_param()->add_mean_value(1);
+  PackedDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(2, this->blob_top_data_->num());
+  EXPECT_EQ(2, this->blob_top_data_->channels());
+  EXPECT_EQ(2, this->blob_top_data_->height());
+  EXPECT_EQ(2, this->blob_top_data_->width());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The center crop of the 2 x 3 images is their first two columns.
+  for (int n = 0; n < 2; ++n) {
+    EXPECT_EQ(n, this->blob_top_label_->cpu_data()[n]);
+    for (int c = 0; c < 2; ++c) {
+      for (int h = 0; h < 2; ++h) {
+        for (int w = 0; w < 2; ++w) {
+          const Dtype value = n * 12 + c * 6 + h * 3 + w;
+          EXPECT_EQ((value - 1) * 0.5,
+              this->blob_top_data_->data_at(n, c, h, w));
+        }
+      }
+    }
+  }
+}
+
+}  // namespace caffe
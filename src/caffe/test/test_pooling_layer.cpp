@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cfloat>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +8,8 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -14,6 +18,9 @@
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
 
+using std::max;
+using std::min;
+
 namespace caffe {
 
 template <typename TypeParam>
@@ -609,6 +616,148 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+// Checks the CPU kernels, split across several threads, on planes large
+// enough for the unclipped windows to take the row kernels.
+template <typename Dtype>
+class PoolingLayerCPUTest : public CPUDeviceTest<Dtype> {
+ protected:
+  PoolingLayerCPUTest()
+      : blob_bottom_(new Blob<Dtype>(4, 8, 33, 35)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    ThreadPool::SetGlobalThreads(3);
+  }
+  virtual ~PoolingLayerCPUTest() {
+    ThreadPool::SetGlobalThreads(0);
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  LayerParameter Param(PoolingParameter_PoolMethod pool, int kernel,
+      int stride, int pad) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(kernel);
+    pooling_param->set_stride(stride);
+    pooling_param->set_pad(pad);
+    pooling_param->set_pool(pool);
+    return layer_param;
+  }
+
+  // Pool one output with clipped windows, as the layer is specified to.
+  Dtype ReferencePool(const LayerParameter& layer_param, int n, int c,
+      int ph, int pw) {
+    const PoolingParameter& pooling_param = layer_param.pooling_param();
+    const int kernel = pooling_param.kernel_size();
+    const int pad = pooling_param.pad();
+    int hstart = ph * pooling_param.stride() - pad;
+    int wstart = pw * pooling_param.stride() - pad;
+    int hend = min(hstart + kernel, blob_bottom_->height() + pad);
+    int wend = min(wstart + kernel, blob_bottom_->width() + pad);
+    const int pool_size = (hend - hstart) * (wend - wstart);
+    hstart = max(hstart, 0);
+    wstart = max(wstart, 0);
+    hend = min(hend, blob_bottom_->height());
+    wend = min(wend, blob_bottom_->width());
+    Dtype max_value = -FLT_MAX;
+    Dtype sum = 0;
+    for (int h = hstart; h < hend; ++h) {
+      for (int w = wstart; w < wend; ++w) {
+        max_value = max(max_value, blob_bottom_->data_at(n, c, h, w));
+        sum += blob_bottom_->data_at(n, c, h, w);
+      }
+    }
+    return pooling_param.pool() == PoolingParameter_PoolMethod_MAX ?
+        max_value : sum / pool_size;
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(PoolingLayerCPUTest, TestDtypes);
+
+TYPED_TEST(PoolingLayerCPUTest, TestForwardRowKernels) {
+  const int kernels[] = {2, 3, 3, 3, 4};
+  const int strides[] = {2, 2, 2, 1, 3};
+  const int pads[] = {0, 0, 1, 1, 2};
+  const PoolingParameter_PoolMethod pools[] = {
+      PoolingParameter_PoolMethod_MAX, PoolingParameter_PoolMethod_AVE};
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 2; ++j) {
+      LayerParameter layer_param =
+          this->Param(pools[j], kernels[i], strides[i], pads[i]);
+      PoolingLayer<TypeParam> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int n = 0; n < this->blob_top_->num(); ++n) {
+        for (int c = 0; c < this->blob_top_->channels(); ++c) {
+          for (int ph = 0; ph < this->blob_top_->height(); ++ph) {
+            for (int pw = 0; pw < this->blob_top_->width(); ++pw) {
+              EXPECT_NEAR(this->ReferencePool(layer_param, n, c, ph, pw),
+                  this->blob_top_->data_at(n, c, ph, pw), 1e-5);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerCPUTest, TestMaxTestPhase) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param =
+      this->Param(PoolingParameter_PoolMethod_MAX, 3, 2, 0);
+  PoolingLayer<Dtype> train_layer(layer_param);
+  train_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  train_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> train_top;
+  train_top.CopyFrom(*this->blob_top_, false, true);
+  Blob<Dtype> top_diff;
+  top_diff.ReshapeLike(*this->blob_top_);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&top_diff);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, true);
+  train_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  Blob<Dtype> train_bottom_diff;
+  train_bottom_diff.CopyFrom(*this->blob_bottom_, true, true);
+
+  // The TEST phase pools without the mask, and recomputes it for Backward
+  // without touching the output.
+  layer_param.set_phase(TEST);
+  PoolingLayer<Dtype> test_layer(layer_param);
+  test_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  test_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < train_top.count(); ++i) {
+    EXPECT_EQ(train_top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+  caffe_set(this->blob_top_->count(), Dtype(7),
+      this->blob_top_->mutable_cpu_data());
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  test_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(Dtype(7), this->blob_top_->cpu_data()[i]);
+  }
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(train_bottom_diff.cpu_diff()[i],
+        this->blob_bottom_->cpu_diff()[i]);
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
@@ -214,4 +214,92 @@ TYPED_TEST(RNNLayerTest, TestGradientNonZeroContBufferSize2WithStaticInput) {
       this->blob_top_vec_, 2);
 }
 
+TYPED_TEST(RNNLayerTest, TestFusedMatchesUnrolled) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ReshapeBlobs(3, 2);
+  FillerParameter filler_param;
+  filler_param.set_min(-1);
+  filler_param.set_max(1);
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->blob_bottom_static_);
+  this->blob_bottom_vec_.push_back(&this->blob_bottom_static_);
+  // The second stream starts a sequence at the second timestep.
+  for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+    this->blob_bottom_cont_.mutable_cpu_data()[i] = i != 3;
+  }
+  Blob<Dtype> top_diff;
+  Caffe::set_random_seed(1701);
+  RNNLayer<Dtype> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  this->layer_param_.mutable_recurrent_param()->set_engine(
+      RecurrentParameter_Engine_FUSED);
+  Caffe::set_random_seed(1701);
+  RNNLayer<Dtype> fused_layer(this->layer_param_);
+  Blob<Dtype> fused_top;
+  vector<Blob<Dtype>*> fused_top_vec(1, &fused_top);
+  fused_layer.SetUp(this->blob_bottom_vec_, fused_top_vec);
+  top_diff.ReshapeLike(this->blob_top_);
+  filler.Fill(&top_diff);
+  const Dtype kEpsilon = 1e-5;
+  // The state is carried over from the first call to the second.
+  for (int iter = 0; iter < 2; ++iter) {
+    filler.Fill(&this->blob_bottom_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    fused_layer.Forward(this->blob_bottom_vec_, fused_top_vec);
+    for (int i = 0; i < this->blob_top_.count(); ++i) {
+      EXPECT_NEAR(this->blob_top_.cpu_data()[i], fused_top.cpu_data()[i],
+          kEpsilon) << "iter = " << iter << "; i = " << i;
+    }
+  }
+  vector<bool> propagate_down(3, true);
+  propagate_down[1] = false;
+  Blob<Dtype> bottom_diff;
+  Blob<Dtype> static_diff;
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      this->blob_top_.mutable_cpu_diff());
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  bottom_diff.CopyFrom(this->blob_bottom_, true, true);
+  static_diff.CopyFrom(this->blob_bottom_static_, true, true);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      fused_top.mutable_cpu_diff());
+  fused_layer.Backward(fused_top_vec, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < bottom_diff.count(); ++i) {
+    EXPECT_NEAR(bottom_diff.cpu_diff()[i], this->blob_bottom_.cpu_diff()[i],
+        kEpsilon) << "i = " << i;
+  }
+  for (int i = 0; i < static_diff.count(); ++i) {
+    EXPECT_NEAR(static_diff.cpu_diff()[i],
+        this->blob_bottom_static_.cpu_diff()[i], kEpsilon) << "i = " << i;
+  }
+  ASSERT_EQ(layer.blobs().size(), fused_layer.blobs().size());
+  for (int j = 0; j < layer.blobs().size(); ++j) {
+    for (int i = 0; i < layer.blobs()[j]->count(); ++i) {
+      EXPECT_NEAR(layer.blobs()[j]->cpu_diff()[i],
+          fused_layer.blobs()[j]->cpu_diff()[i], kEpsilon)
+          << "param = " << j << "; i = " << i;
+    }
+  }
+}
+
+TYPED_TEST(RNNLayerTest, TestGradientFused) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ReshapeBlobs(2, 2);
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(&this->blob_bottom_);
+  filler.Fill(&this->blob_bottom_static_);
+  this->blob_bottom_vec_.push_back(&this->blob_bottom_static_);
+  this->layer_param_.mutable_recurrent_param()->set_engine(
+      RecurrentParameter_Engine_FUSED);
+  RNNLayer<Dtype> layer(this->layer_param_);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+    this->blob_bottom_cont_.mutable_cpu_data()[i] = i > 2;
+  }
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 0);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_, 2);
+}
+
 }  // namespace caffe
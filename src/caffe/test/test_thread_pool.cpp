@@ -0,0 +1,72 @@
+#include <boost/bind.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ public:
+  ThreadPoolTest() : pool_(4) {}
+
+  void Record(vector<int>* runs, vector<int>* slots, int i, int slot) {
+    (*runs)[i] += 1;
+    (*slots)[i] = slot;
+  }
+
+  void RunNested(vector<int>* sums, int i, int slot) {
+    vector<int> runs(10, 0);
+    vector<int> slots(10, -1);
+    pool_.Run(10, boost::bind(&ThreadPoolTest::Record, this, &runs, &slots,
+        _1, _2));
+    for (int j = 0; j < runs.size(); ++j) {
+      (*sums)[i] += runs[j];
+    }
+  }
+
+ protected:
+  ThreadPool pool_;
+};
+
+TEST_F(ThreadPoolTest, TestRunsEveryTaskOnce) {
+  EXPECT_EQ(pool_.num_threads(), 4);
+  for (int num_tasks = 0; num_tasks < 50; num_tasks += 7) {
+    vector<int> runs(num_tasks, 0);
+    vector<int> slots(num_tasks, -1);
+    pool_.Run(num_tasks, boost::bind(&ThreadPoolTest::Record, this, &runs,
+        &slots, _1, _2));
+    for (int i = 0; i < num_tasks; ++i) {
+      EXPECT_EQ(runs[i], 1);
+      EXPECT_GE(slots[i], 0);
+      EXPECT_LT(slots[i], pool_.num_threads());
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNestedRun) {
+  vector<int> sums(8, 0);
+  pool_.Run(sums.size(), boost::bind(&ThreadPoolTest::RunNested, this, &sums,
+      _1, _2));
+  for (int i = 0; i < sums.size(); ++i) {
+    EXPECT_EQ(sums[i], 10);
+  }
+}
+
+TEST_F(ThreadPoolTest, TestSingleThread) {
+  ThreadPool pool(1);
+  vector<int> runs(5, 0);
+  vector<int> slots(5, -1);
+  pool.Run(5, boost::bind(&ThreadPoolTest::Record, this, &runs, &slots,
+      _1, _2));
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(runs[i], 1);
+    EXPECT_EQ(slots[i], 0);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/tuning_cache.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class TuningCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    MakeTempFilename(&filename_);
+    TuningCache::set_file("");
+  }
+  virtual void TearDown() {
+    TuningCache::set_file("");
+    std::remove(filename_.c_str());
+  }
+
+  string filename_;
+};
+
+TEST_F(TuningCacheTest, TestInMemory) {
+  string value;
+  EXPECT_FALSE(TuningCache::Lookup("a", &value));
+  TuningCache::Insert("a", "1");
+  TuningCache::Insert("b", "2");
+  TuningCache::Insert("a", "3");
+  EXPECT_TRUE(TuningCache::Lookup("a", &value));
+  EXPECT_EQ("3", value);
+  EXPECT_TRUE(TuningCache::Lookup("b", &value));
+  EXPECT_EQ("2", value);
+  TuningCache::Clear();
+  EXPECT_FALSE(TuningCache::Lookup("a", &value));
+}
+
+TEST_F(TuningCacheTest, TestPersists) {
+  TuningCache::set_file(filename_);
+  EXPECT_EQ(filename_, TuningCache::file());
+  TuningCache::Insert("key with spaces", "1");
+  TuningCache::Insert("other", "2");
+  TuningCache::Insert("key with spaces", "3");
+  // Reloading from the file, the last entry for a key wins.
+  TuningCache::set_file(filename_);
+  string value;
+  EXPECT_TRUE(TuningCache::Lookup("key with spaces", &value));
+  EXPECT_EQ("3", value);
+  EXPECT_TRUE(TuningCache::Lookup("other", &value));
+  EXPECT_EQ("2", value);
+}
+
+TEST_F(TuningCacheTest, TestSkipsOtherCPUs) {
+  {
+    std::ofstream output(filename_.c_str());
+    output << "Some other CPU\tkey\t1\n";
+    output << "malformed line\n";
+    output << TuningCache::CPUModel() << "\tmine\t2\n";
+  }
+  TuningCache::set_file(filename_);
+  string value;
+  EXPECT_FALSE(TuningCache::Lookup("key", &value));
+  EXPECT_TRUE(TuningCache::Lookup("mine", &value));
+  EXPECT_EQ("2", value);
+}
+
+}  // namespace caffe
@@ -0,0 +1,67 @@
+#include <cstring>
+#include <vector>
+
+#include "caffe/util/blob_change_tracker.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+bool BlobChangeTracker<Dtype>::Changed(const vector<Blob<Dtype>*>& blobs) {
+  bool changed = !seen_ || memories_.size() != blobs.size();
+  seen_ = true;
+  memories_.resize(blobs.size());
+  versions_.resize(blobs.size());
+  values_.resize(blobs.size());
+  for (int i = 0; i < blobs.size(); ++i) {
+    changed |= Update(i, *blobs[i]);
+  }
+  return changed;
+}
+
+template <typename Dtype>
+bool BlobChangeTracker<Dtype>::Changed(const Blob<Dtype>& blob) {
+  bool changed = !seen_ || memories_.size() != 1;
+  seen_ = true;
+  memories_.resize(1);
+  versions_.resize(1);
+  values_.resize(1);
+  changed |= Update(0, blob);
+  return changed;
+}
+
+template <typename Dtype>
+void BlobChangeTracker<Dtype>::Reset() {
+  seen_ = false;
+  memories_.clear();
+  versions_.clear();
+  values_.clear();
+}
+
+template <typename Dtype>
+bool BlobChangeTracker<Dtype>::Update(int i, const Blob<Dtype>& blob) {
+  // An empty blob has no memory. A different or freed one, e.g. after a
+  // Reshape or ShareData, is a change whatever its version.
+  shared_ptr<SyncedMemory> memory;
+  if (blob.count() > 0) {
+    memory = blob.data();
+  }
+  const size_t version = memory ? memory->version() : 0;
+  const Dtype* data = memory ? blob.cpu_data() : NULL;
+  // Writes through a pointer obtained earlier leave the version as it was,
+  // so an unchanged version still needs the values compared. A Reshape may
+  // also keep the memory but change the count.
+  if (memories_[i].lock() == memory && versions_[i] == version &&
+      values_[i].size() == blob.count() &&
+      (!memory || memcmp(&values_[i][0], data,
+          blob.count() * sizeof(Dtype)) == 0)) {
+    return false;
+  }
+  memories_[i] = memory;
+  versions_[i] = version;
+  values_[i].assign(data, data + blob.count());
+  return true;
+}
+
+INSTANTIATE_CLASS(BlobChangeTracker);
+
+}  // namespace caffe
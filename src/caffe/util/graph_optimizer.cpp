@@ -0,0 +1,485 @@
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/util/graph_optimizer.hpp"
+
+namespace caffe {
+
+namespace {
+
+// A blob as written by one layer: the index of the layer, or -1 for a net
+// input, and the name of the top.
+typedef pair<int, string> BlobVersion;
+
+// Find the layer each bottom reads from, or -1 for a net input, and count the
+// bottoms reading each blob version.
+void FindSources(const NetParameter& net, vector<vector<int> >* sources,
+    map<BlobVersion, int>* num_readers) {
+  map<string, int> last_top;
+  for (int i = 0; i < net.input_size(); ++i) {
+    last_top[net.input(i)] = -1;
+  }
+  sources->assign(net.layer_size(), vector<int>());
+  num_readers->clear();
+  for (int i = 0; i < net.layer_size(); ++i) {
+    const LayerParameter& layer = net.layer(i);
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      map<string, int>::const_iterator it = last_top.find(layer.bottom(j));
+      const int source = it == last_top.end() ? -1 : it->second;
+      (*sources)[i].push_back(source);
+      ++(*num_readers)[make_pair(source, layer.bottom(j))];
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      last_top[layer.top(j)] = i;
+    }
+  }
+}
+
+bool IsLossLayer(const LayerParameter& layer) {
+  const string& type = layer.type();
+  return type.size() >= 4 && type.compare(type.size() - 4, 4, "Loss") == 0;
+}
+
+// Whether top j of a layer counts as a loss: it has a nonzero loss weight,
+// or is the first top of a loss layer, whose default loss weight is 1.
+bool IsLossTop(const LayerParameter& layer, int j) {
+  if (j < layer.loss_weight_size()) {
+    return layer.loss_weight(j) != 0;
+  }
+  return j == 0 && IsLossLayer(layer);
+}
+
+// Whether the tops of a layer share their data with its bottom, so that
+// computing in place on them would change the bottom too.
+bool IsSharedTop(const LayerParameter& layer) {
+  return layer.type() == "Split" || layer.type() == "Flatten" ||
+      layer.type() == "Reshape";
+}
+
+bool IsIdentityLayer(const LayerParameter& layer) {
+  if (layer.bottom_size() != 1) {
+    return false;
+  }
+  if (layer.type() == "Split") {
+    return true;
+  }
+  if (layer.type() == "Flatten") {
+    return layer.top_size() == 1 &&
+        layer.flatten_param().axis() == layer.flatten_param().end_axis();
+  }
+  if (layer.type() == "Reshape") {
+    // Copying each of the axes it replaces keeps the shape.
+    const ReshapeParameter& reshape_param = layer.reshape_param();
+    if (layer.top_size() != 1 ||
+        reshape_param.shape().dim_size() != reshape_param.num_axes()) {
+      return false;
+    }
+    for (int i = 0; i < reshape_param.shape().dim_size(); ++i) {
+      if (reshape_param.shape().dim(i) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+// Whether a layer's parameters, if any, stay as the NetParameter has them.
+bool HasFixedParams(const LayerParameter& layer, Phase phase) {
+  if (phase == TEST) {
+    return true;
+  }
+  if (layer.param_size() == 0) {
+    return false;
+  }
+  for (int i = 0; i < layer.param_size(); ++i) {
+    if (layer.param(i).lr_mult() != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+string FoldedLayerName(const string& layer_name, const string& blob_name) {
+  std::ostringstream folded_layer_name;
+  folded_layer_name << layer_name << "_" << blob_name << "_folded";
+  return folded_layer_name.str();
+}
+
+}  // namespace
+
+void EliminateDeadLayersPass::Run(const GraphOptimizerParameter& param,
+    NetParameter* net, vector<string>* removed) const {
+  vector<vector<int> > sources;
+  map<BlobVersion, int> num_readers;
+  FindSources(*net, &sources, &num_readers);
+  const bool all_outputs = param.output_size() == 0;
+  // Sweeping from the end, the blobs a kept layer reads before they are
+  // written again.
+  set<string> live(param.output().begin(), param.output().end());
+  vector<bool> keep(net->layer_size(), false);
+  for (int i = net->layer_size() - 1; i >= 0; --i) {
+    const LayerParameter& layer = net->layer(i);
+    if (layer.type() == "Silence") {
+      continue;
+    }
+    // A layer without tops is kept for its side effects.
+    bool needed = layer.top_size() == 0;
+    for (int j = 0; j < layer.top_size(); ++j) {
+      const string& top = layer.top(j);
+      needed = needed || live.count(top) || IsLossTop(layer, j) ||
+          (all_outputs && num_readers[make_pair(i, top)] == 0);
+    }
+    if (!needed) {
+      continue;
+    }
+    keep[i] = true;
+    for (int j = 0; j < layer.top_size(); ++j) {
+      live.erase(layer.top(j));
+    }
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      live.insert(layer.bottom(j));
+    }
+  }
+  // Silence layers keep the bottoms still computed, lest they become
+  // outputs.
+  for (int i = 0; i < net->layer_size(); ++i) {
+    LayerParameter* layer = net->mutable_layer(i);
+    if (layer->type() != "Silence") {
+      continue;
+    }
+    LayerParameter silence(*layer);
+    silence.clear_bottom();
+    for (int j = 0; j < layer->bottom_size(); ++j) {
+      if (sources[i][j] < 0 || keep[sources[i][j]]) {
+        silence.add_bottom(layer->bottom(j));
+      }
+    }
+    keep[i] = silence.bottom_size() > 0;
+    layer->CopyFrom(silence);
+  }
+  NetParameter kept(*net);
+  kept.clear_layer();
+  for (int i = 0; i < net->layer_size(); ++i) {
+    if (keep[i]) {
+      kept.add_layer()->CopyFrom(net->layer(i));
+    } else {
+      removed->push_back(net->layer(i).name());
+    }
+  }
+  net->Swap(&kept);
+}
+
+void ConvertInPlacePass::Run(const GraphOptimizerParameter& param,
+    NetParameter* net, vector<string>* removed) const {
+  static const char* const kInPlaceTypes[] = { "BatchNorm", "Bias", "Dropout",
+      "PReLU", "ReLU", "Scale", "Sigmoid", "TanH" };
+  const set<string> in_place_types(kInPlaceTypes, kInPlaceTypes +
+      sizeof(kInPlaceTypes) / sizeof(kInPlaceTypes[0]));
+  // Computing in place overwrites the top of the source layer, which the
+  // Backward of e.g. TanH, Sigmoid, Softmax, LRN, ELU, Exp and Eltwise PROD
+  // reads. In nets that run Backward, only these sources are safe.
+  static const char* const kTopFreeBackwardTypes[] = { "BatchNorm", "Bias",
+      "Convolution", "Deconvolution", "Dropout", "Embed", "InnerProduct",
+      "Pooling", "PReLU", "ReLU", "Scale" };
+  const set<string> top_free_backward_types(kTopFreeBackwardTypes,
+      kTopFreeBackwardTypes + sizeof(kTopFreeBackwardTypes) /
+      sizeof(kTopFreeBackwardTypes[0]));
+  const bool backward = net->state().phase() == TRAIN ||
+      net->force_backward();
+  const set<string> outputs(param.output().begin(), param.output().end());
+  vector<vector<int> > sources;
+  map<BlobVersion, int> num_readers;
+  FindSources(*net, &sources, &num_readers);
+  // The removed tops, and the blob now read in their place.
+  map<string, string> renamed;
+  for (int i = 0; i < net->layer_size(); ++i) {
+    // Blob versions are identified by the names the net had.
+    const LayerParameter original(net->layer(i));
+    LayerParameter* layer = net->mutable_layer(i);
+    for (int j = 0; j < layer->bottom_size(); ++j) {
+      map<string, string>::const_iterator it = renamed.find(layer->bottom(j));
+      if (it != renamed.end()) {
+        layer->set_bottom(j, it->second);
+      }
+    }
+    if (!in_place_types.count(layer->type()) || layer->bottom_size() != 1 ||
+        layer->top_size() != 1 || layer->loss_weight_size() > 0) {
+      continue;
+    }
+    // The bottom must be computed by a layer that does not share it with
+    // another blob nor, if the net runs Backward, read it there, and read by
+    // no other layer; the top must not be an output, as it loses its name.
+    const int source = sources[i][0];
+    const string& top = original.top(0);
+    if (top == original.bottom(0) || source < 0 ||
+        net->layer(source).bottom_size() == 0 ||
+        IsSharedTop(net->layer(source)) ||
+        (backward &&
+         !top_free_backward_types.count(net->layer(source).type())) ||
+        num_readers[make_pair(source, original.bottom(0))] != 1 ||
+        num_readers[make_pair(i, top)] == 0 ||
+        outputs.count(layer->bottom(0)) || outputs.count(top)) {
+      continue;
+    }
+    layer->set_top(0, layer->bottom(0));
+    renamed[top] = layer->bottom(0);
+    removed->push_back(top);
+  }
+}
+
+void RemoveIdentityLayersPass::Run(const GraphOptimizerParameter& param,
+    NetParameter* net, vector<string>* removed) const {
+  const set<string> outputs(param.output().begin(), param.output().end());
+  vector<vector<int> > sources;
+  map<BlobVersion, int> num_readers;
+  FindSources(*net, &sources, &num_readers);
+  map<string, string> renamed;
+  vector<bool> keep(net->layer_size(), true);
+  for (int i = 0; i < net->layer_size(); ++i) {
+    LayerParameter* layer = net->mutable_layer(i);
+    for (int j = 0; j < layer->bottom_size(); ++j) {
+      map<string, string>::const_iterator it = renamed.find(layer->bottom(j));
+      if (it != renamed.end()) {
+        layer->set_bottom(j, it->second);
+      }
+    }
+    if (!IsIdentityLayer(*layer) || layer->loss_weight_size() > 0) {
+      continue;
+    }
+    const string& bottom = layer->bottom(0);
+    if (layer->top_size() == 1 && layer->top(0) == bottom) {
+      keep[i] = false;
+      continue;
+    }
+    // The readers of the tops must read the same data from the bottom, so
+    // neither may be written by a later layer, and the tops must not be
+    // outputs, as they lose their names.
+    set<string> names(layer->top().begin(), layer->top().end());
+    bool removable = !outputs.count(bottom);
+    for (int j = 0; j < layer->top_size(); ++j) {
+      removable = removable && !outputs.count(layer->top(j)) &&
+          num_readers[make_pair(i, layer->top(j))] > 0;
+    }
+    names.insert(bottom);
+    for (int k = i + 1; k < net->layer_size() && removable; ++k) {
+      for (int j = 0; j < net->layer(k).top_size(); ++j) {
+        removable = removable && !names.count(net->layer(k).top(j));
+      }
+    }
+    if (!removable) {
+      continue;
+    }
+    for (int j = 0; j < layer->top_size(); ++j) {
+      renamed[layer->top(j)] = bottom;
+    }
+    keep[i] = false;
+  }
+  NetParameter kept(*net);
+  kept.clear_layer();
+  for (int i = 0; i < net->layer_size(); ++i) {
+    if (keep[i]) {
+      kept.add_layer()->CopyFrom(net->layer(i));
+    } else {
+      removed->push_back(net->layer(i).name());
+    }
+  }
+  net->Swap(&kept);
+}
+
+void FoldConstantsPass::Run(const GraphOptimizerParameter& param,
+    NetParameter* net, vector<string>* removed) const {
+  const Phase phase = net->state().phase();
+  vector<vector<int> > sources;
+  map<BlobVersion, int> num_readers;
+  FindSources(*net, &sources, &num_readers);
+  // The values of the constant blobs, by version and by name for the
+  // current versions. They are computed in double precision, which the
+  // Parameter layers replacing them store as is.
+  map<BlobVersion, shared_ptr<Blob<double> > > values;
+  map<string, shared_ptr<Blob<double> > > current;
+  // Whether each layer only computes constants, and whether it reads any.
+  vector<bool> constant(net->layer_size(), false);
+  vector<bool> folded(net->layer_size(), false);
+  for (int i = 0; i < net->layer_size(); ++i) {
+    LayerParameter layer_param(net->layer(i));
+    layer_param.set_phase(phase);
+    const string& type = layer_param.type();
+    bool computable = false;
+    if (type == "DummyData" || type == "Parameter") {
+      computable = type == "DummyData" || (layer_param.blobs_size() > 0 &&
+          HasFixedParams(layer_param, phase));
+    } else if (layer_param.bottom_size() > 0 && type != "Python" &&
+        !IsLossLayer(layer_param) && layer_param.loss_weight_size() == 0 &&
+        !(type == "Dropout" && phase == TRAIN)) {
+      computable = true;
+      for (int j = 0; j < layer_param.bottom_size(); ++j) {
+        computable = computable && current.count(layer_param.bottom(j));
+      }
+    }
+    vector<shared_ptr<Blob<double> > > tops;
+    if (computable) {
+      shared_ptr<Layer<double> > layer =
+          LayerRegistry<double>::CreateLayer(layer_param);
+      vector<Blob<double>*> bottom_vec, top_vec;
+      for (int j = 0; j < layer_param.bottom_size(); ++j) {
+        bottom_vec.push_back(current[layer_param.bottom(j)].get());
+      }
+      for (int j = 0; j < layer_param.top_size(); ++j) {
+        shared_ptr<Blob<double> > top(new Blob<double>());
+        // Computing in place on a copy keeps the version read intact.
+        for (int k = 0; k < layer_param.bottom_size(); ++k) {
+          if (layer_param.bottom(k) == layer_param.top(j)) {
+            top->CopyFrom(*bottom_vec[k], false, true);
+            bottom_vec[k] = top.get();
+          }
+        }
+        tops.push_back(top);
+        top_vec.push_back(top.get());
+      }
+      layer->SetUp(bottom_vec, top_vec);
+      // Parameters are only known when the NetParameter holds them.
+      computable = layer->blobs().empty() || (layer_param.blobs_size() > 0 &&
+          HasFixedParams(layer_param, phase));
+      if (computable) {
+        layer->Forward(bottom_vec, top_vec);
+      }
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      const string& top = layer_param.top(j);
+      bool constant_top = computable;
+      if (computable && type == "DummyData") {
+        const DummyDataParameter& dummy_param =
+            layer_param.dummy_data_param();
+        const int num_fillers = dummy_param.data_filler_size();
+        constant_top = num_fillers == 0 || dummy_param.data_filler(
+            num_fillers == 1 ? 0 : j).type() == "constant";
+      }
+      if (constant_top) {
+        // Parameter tops share the layer's blob; keep a copy of it.
+        shared_ptr<Blob<double> > value(new Blob<double>());
+        value->CopyFrom(*tops[j], false, true);
+        values[make_pair(i, top)] = value;
+        current[top] = value;
+      } else {
+        current.erase(top);
+      }
+    }
+    constant[i] = computable;
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      constant[i] = constant[i] && values.count(make_pair(i,
+          layer_param.top(j)));
+    }
+    folded[i] = constant[i] && layer_param.bottom_size() > 0;
+  }
+  // The constants read by layers left in the net, or that are outputs, must
+  // still be computed.
+  const set<string> outputs(param.output().begin(), param.output().end());
+  set<BlobVersion> needed;
+  for (int i = 0; i < net->layer_size(); ++i) {
+    const LayerParameter& layer = net->layer(i);
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      if (!folded[i]) {
+        needed.insert(make_pair(sources[i][j], layer.bottom(j)));
+      }
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      const BlobVersion version(i, layer.top(j));
+      if (num_readers[version] == 0 || outputs.count(layer.top(j))) {
+        needed.insert(version);
+      }
+    }
+  }
+  NetParameter kept(*net);
+  kept.clear_layer();
+  for (int i = 0; i < net->layer_size(); ++i) {
+    const LayerParameter& layer = net->layer(i);
+    bool needs_top = false;
+    for (int j = 0; j < layer.top_size(); ++j) {
+      needs_top = needs_top || needed.count(make_pair(i, layer.top(j)));
+    }
+    if (!constant[i] || (!folded[i] && needs_top)) {
+      kept.add_layer()->CopyFrom(layer);
+      continue;
+    }
+    removed->push_back(layer.name());
+    for (int j = 0; j < layer.top_size() && folded[i]; ++j) {
+      const BlobVersion version(i, layer.top(j));
+      if (!needed.count(version)) {
+        continue;
+      }
+      const Blob<double>& value = *values[version];
+      LayerParameter* folded_param = kept.add_layer();
+      folded_param->set_name(FoldedLayerName(layer.name(), layer.top(j)));
+      folded_param->set_type("Parameter");
+      folded_param->add_top(layer.top(j));
+      for (int k = 0; k < value.num_axes(); ++k) {
+        folded_param->mutable_parameter_param()->mutable_shape()->add_dim(
+            value.shape(k));
+      }
+      ParamSpec* param_spec = folded_param->add_param();
+      param_spec->set_lr_mult(0);
+      param_spec->set_decay_mult(0);
+      value.ToProto(folded_param->add_blobs());
+    }
+  }
+  net->Swap(&kept);
+}
+
+namespace {
+
+vector<shared_ptr<GraphPass> >& MutableGraphPasses() {
+  static vector<shared_ptr<GraphPass> >* passes = NULL;
+  if (!passes) {
+    passes = new vector<shared_ptr<GraphPass> >();
+    passes->push_back(shared_ptr<GraphPass>(new FoldConstantsPass()));
+    passes->push_back(shared_ptr<GraphPass>(new RemoveIdentityLayersPass()));
+    passes->push_back(shared_ptr<GraphPass>(new EliminateDeadLayersPass()));
+    passes->push_back(shared_ptr<GraphPass>(new ConvertInPlacePass()));
+  }
+  return *passes;
+}
+
+}  // namespace
+
+const vector<shared_ptr<GraphPass> >& GraphPasses() {
+  return MutableGraphPasses();
+}
+
+void RegisterGraphPass(shared_ptr<GraphPass> pass) {
+  CHECK(pass) << "Cannot register a NULL graph pass.";
+  MutableGraphPasses().push_back(pass);
+}
+
+void OptimizeGraph(const NetParameter& param, NetParameter* param_optimized,
+    vector<string>* report) {
+  param_optimized->CopyFrom(param);
+  const GraphOptimizerParameter& optimizer_param =
+      param.graph_optimizer_param();
+  const vector<shared_ptr<GraphPass> >& passes = GraphPasses();
+  for (int i = 0; i < passes.size(); ++i) {
+    if (!passes[i]->enabled(optimizer_param)) {
+      continue;
+    }
+    vector<string> removed;
+    passes[i]->Run(optimizer_param, param_optimized, &removed);
+    std::ostringstream line;
+    line << passes[i]->name() << " removed " << removed.size();
+    for (int j = 0; j < removed.size(); ++j) {
+      line << (j ? ", " : ": ") << removed[j];
+    }
+    LOG_IF(INFO, Caffe::root_solver()) << line.str();
+    if (report) {
+      report->push_back(line.str());
+    }
+  }
+}
+
+}  // namespace caffe
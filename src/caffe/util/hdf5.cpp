@@ -1,15 +1,24 @@
 #include "caffe/util/hdf5.hpp"
 
+#include <boost/thread.hpp>
 #include <string>
 #include <vector>
 
 namespace caffe {
 
-// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
-template <typename Dtype>
-void hdf5_load_nd_dataset_helper(
-    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
-    Blob<Dtype>* blob) {
+static boost::recursive_mutex hdf5_mutex;
+
+HDF5Lock::HDF5Lock() {
+  hdf5_mutex.lock();
+}
+
+HDF5Lock::~HDF5Lock() {
+  hdf5_mutex.unlock();
+}
+
+std::vector<hsize_t> hdf5_get_dataset_dims(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim) {
+  HDF5Lock lock;
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -55,7 +64,17 @@ void hdf5_load_nd_dataset_helper(
   default:
     LOG(FATAL) << "Datatype class unknown";
   }
+  return dims;
+}
 
+// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
+template <typename Dtype>
+void hdf5_load_nd_dataset_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob) {
+  HDF5Lock lock;
+  std::vector<hsize_t> dims = hdf5_get_dataset_dims(file_id, dataset_name_,
+      min_dim, max_dim);
   vector<int> blob_dims(dims.size());
   for (int i = 0; i < dims.size(); ++i) {
     blob_dims[i] = dims[i];
@@ -66,6 +85,7 @@ void hdf5_load_nd_dataset_helper(
 template <>
 void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<float>* blob) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_float(
     file_id, dataset_name_, blob->mutable_cpu_data());
@@ -75,16 +95,76 @@ void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<double>* blob) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_double(
     file_id, dataset_name_, blob->mutable_cpu_data());
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Reads a hyperslab of rows of the dataset into data, as mem_type.
+static void hdf5_read_rows(hid_t file_id, const char* dataset_name_,
+    hsize_t row, hsize_t num_rows, hid_t mem_type, void* data) {
+  hid_t dataset = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset);
+  const int ndims = H5Sget_simple_extent_ndims(file_space);
+  std::vector<hsize_t> count(ndims);
+  H5Sget_simple_extent_dims(file_space, count.data(), NULL);
+  CHECK_LE(row + num_rows, count[0]) << "Rows out of range for "
+      << dataset_name_;
+  std::vector<hsize_t> start(ndims, 0);
+  start[0] = row;
+  count[0] = num_rows;
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+      start.data(), NULL, count.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t mem_space = H5Screate_simple(ndims, count.data(), NULL);
+  status = H5Dread(dataset, mem_type, mem_space, file_space, H5P_DEFAULT,
+      data);
+  CHECK_GE(status, 0) << "Failed to read rows of " << dataset_name_;
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset);
+}
+
+template <typename Dtype>
+static void hdf5_reshape_rows(hid_t file_id, const char* dataset_name_,
+    hsize_t num_rows, Blob<Dtype>* blob) {
+  std::vector<hsize_t> dims = hdf5_get_dataset_dims(file_id, dataset_name_,
+      1, INT_MAX);
+  vector<int> blob_dims(dims.size());
+  blob_dims[0] = num_rows;
+  for (int i = 1; i < dims.size(); ++i) {
+    blob_dims[i] = dims[i];
+  }
+  blob->Reshape(blob_dims);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id, const char* dataset_name_,
+    hsize_t row, hsize_t num_rows, Blob<float>* blob) {
+  HDF5Lock lock;
+  hdf5_reshape_rows(file_id, dataset_name_, num_rows, blob);
+  hdf5_read_rows(file_id, dataset_name_, row, num_rows, H5T_NATIVE_FLOAT,
+      blob->mutable_cpu_data());
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, hsize_t row, hsize_t num_rows,
+    Blob<double>* blob) {
+  HDF5Lock lock;
+  hdf5_reshape_rows(file_id, dataset_name_, num_rows, blob);
+  hdf5_read_rows(file_id, dataset_name_, row, num_rows, H5T_NATIVE_DOUBLE,
+      blob->mutable_cpu_data());
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
     bool write_diff) {
+  HDF5Lock lock;
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -106,6 +186,7 @@ template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
     bool write_diff) {
+  HDF5Lock lock;
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -124,6 +205,7 @@ void hdf5_save_nd_dataset<double>(
 }
 
 string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
+  HDF5Lock lock;
   // Get size of dataset
   size_t size;
   H5T_class_t class_;
@@ -141,6 +223,7 @@ string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
 
 void hdf5_save_string(hid_t loc_id, const string& dataset_name,
                       const string& s) {
+  HDF5Lock lock;
   herr_t status = \
     H5LTmake_dataset_string(loc_id, dataset_name.c_str(), s.c_str());
   CHECK_GE(status, 0)
@@ -148,6 +231,7 @@ void hdf5_save_string(hid_t loc_id, const string& dataset_name,
 }
 
 int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
+  HDF5Lock lock;
   int val;
   herr_t status = H5LTread_dataset_int(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -156,6 +240,7 @@ int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
 }
 
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
+  HDF5Lock lock;
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_int(loc_id, dataset_name.c_str(), 1, &one, &i);
@@ -164,6 +249,7 @@ void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
 }
 
 int hdf5_get_num_links(hid_t loc_id) {
+  HDF5Lock lock;
   H5G_info_t info;
   herr_t status = H5Gget_info(loc_id, &info);
   CHECK_GE(status, 0) << "Error while counting HDF5 links.";
@@ -171,6 +257,7 @@ int hdf5_get_num_links(hid_t loc_id) {
 }
 
 string hdf5_get_name_by_idx(hid_t loc_id, int idx) {
+  HDF5Lock lock;
   ssize_t str_size = H5Lget_name_by_idx(
       loc_id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, idx, NULL, 0, H5P_DEFAULT);
   CHECK_GE(str_size, 0) << "Error retrieving HDF5 dataset at index " << idx;
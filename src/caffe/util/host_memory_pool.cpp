@@ -0,0 +1,201 @@
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "caffe/util/host_memory_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The smallest block the pool hands out; also the alignment of every block.
+const size_t kMinBlock = HostMemoryPool::kAlignment;
+
+struct PoolState {
+  PoolState() : enabled(false), num_live_blocks(0), max_cached_bytes(0) {
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.bytes_in_use = 0;
+    stats.bytes_cached = 0;
+    stats.peak_bytes_held = 0;
+  }
+
+  boost::mutex mutex;
+  // Read without the mutex on every host allocation and free.
+  boost::atomic<bool> enabled;
+  boost::atomic<size_t> num_live_blocks;
+  size_t max_cached_bytes;
+  HostMemoryPool::Stats stats;
+  // Free blocks, keyed by size class.
+  std::map<size_t, std::vector<void*> > free_lists;
+  // Size class of every block currently handed out.
+  std::map<void*, size_t> live_blocks;
+};
+
+// Never destroyed: blobs owned by static objects may be freed after the
+// pool would otherwise have been torn down at exit.
+PoolState& State() {
+  static PoolState* state = new PoolState();
+  return *state;
+}
+
+int FloorLog2(size_t x) {
+  int log = 0;
+  while (x >>= 1) {
+    ++log;
+  }
+  return log;
+}
+
+void* SystemAllocate(size_t size) {
+  void* ptr = NULL;
+  if (posix_memalign(&ptr, HostMemoryPool::kAlignment, size) != 0) {
+    return NULL;
+  }
+  return ptr;
+}
+
+void ReleaseCachedLocked(PoolState* state, size_t target_bytes) {
+  std::map<size_t, std::vector<void*> >::reverse_iterator it =
+      state->free_lists.rbegin();
+  // Release the largest blocks first to reach the target in fewest frees.
+  while (state->stats.bytes_cached > target_bytes &&
+         it != state->free_lists.rend()) {
+    std::vector<void*>& blocks = it->second;
+    while (!blocks.empty() && state->stats.bytes_cached > target_bytes) {
+      free(blocks.back());
+      blocks.pop_back();
+      state->stats.bytes_cached -= it->first;
+    }
+    ++it;
+  }
+}
+
+}  // namespace
+
+size_t HostMemoryPool::SizeClass(size_t size) {
+  if (size <= kMinBlock) {
+    return kMinBlock;
+  }
+  // Four classes per power of two bound the internal waste to 25%.
+  const size_t step = size_t(1) << (FloorLog2(size - 1) - 2);
+  return (size + step - 1) & ~(step - 1);
+}
+
+bool HostMemoryPool::enabled() {
+  return State().enabled.load(boost::memory_order_relaxed);
+}
+
+bool HostMemoryPool::has_live_blocks() {
+  return State().num_live_blocks.load(boost::memory_order_relaxed) > 0;
+}
+
+void HostMemoryPool::set_enabled(bool enabled) {
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  state.enabled = enabled;
+  if (!enabled) {
+    ReleaseCachedLocked(&state, 0);
+  }
+}
+
+size_t HostMemoryPool::max_cached_bytes() {
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  return state.max_cached_bytes;
+}
+
+void HostMemoryPool::set_max_cached_bytes(size_t bytes) {
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  state.max_cached_bytes = bytes;
+  if (bytes > 0) {
+    ReleaseCachedLocked(&state, bytes);
+  }
+}
+
+void* HostMemoryPool::Allocate(size_t size) {
+  const size_t block_size = SizeClass(size);
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  void* ptr = NULL;
+  std::vector<void*>& blocks = state.free_lists[block_size];
+  if (!blocks.empty()) {
+    ptr = blocks.back();
+    blocks.pop_back();
+    state.stats.bytes_cached -= block_size;
+    ++state.stats.hits;
+  } else {
+    ptr = SystemAllocate(block_size);
+    if (!ptr) {
+      // Give the cache back to the system and retry once before failing.
+      ReleaseCachedLocked(&state, 0);
+      ptr = SystemAllocate(block_size);
+    }
+    CHECK(ptr) << "host pool allocation of size " << block_size << " failed";
+    ++state.stats.misses;
+  }
+  state.live_blocks[ptr] = block_size;
+  ++state.num_live_blocks;
+  state.stats.bytes_in_use += block_size;
+  state.stats.peak_bytes_held = std::max(state.stats.peak_bytes_held,
+      state.stats.bytes_in_use + state.stats.bytes_cached);
+  return ptr;
+}
+
+bool HostMemoryPool::Free(void* ptr) {
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  std::map<void*, size_t>::iterator it = state.live_blocks.find(ptr);
+  if (it == state.live_blocks.end()) {
+    return false;
+  }
+  const size_t block_size = it->second;
+  state.live_blocks.erase(it);
+  --state.num_live_blocks;
+  state.stats.bytes_in_use -= block_size;
+  if (!state.enabled || (state.max_cached_bytes > 0 &&
+      state.stats.bytes_cached + block_size > state.max_cached_bytes)) {
+    free(ptr);
+  } else {
+    state.free_lists[block_size].push_back(ptr);
+    state.stats.bytes_cached += block_size;
+  }
+  return true;
+}
+
+void HostMemoryPool::Trim() {
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  ReleaseCachedLocked(&state, 0);
+}
+
+HostMemoryPool::Stats HostMemoryPool::stats() {
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  return state.stats;
+}
+
+void HostMemoryPool::ResetStats() {
+  PoolState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  state.stats.hits = 0;
+  state.stats.misses = 0;
+  state.stats.peak_bytes_held = state.stats.bytes_in_use +
+      state.stats.bytes_cached;
+}
+
+void HostMemoryPool::LogStats() {
+  const Stats s = stats();
+  LOG(INFO) << "Host memory pool: " << s.hits << " hits, " << s.misses
+            << " misses, " << s.bytes_in_use << " bytes in use, "
+            << s.bytes_cached << " bytes cached, " << s.peak_bytes_held
+            << " bytes peak";
+}
+
+}  // namespace caffe
@@ -7,11 +7,16 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/highgui/highgui_c.h>
 #include <opencv2/imgproc/imgproc.hpp>
+// Decoding JPEGs at a reduced scale came with OpenCV 3.1.
+#if CV_MAJOR_VERSION > 3 || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 1)
+#define CAFFE_REDUCED_DECODE
+#endif
 #endif  // USE_OPENCV
 #include <stdint.h>
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -88,6 +93,40 @@ cv::Mat ReadImageToCVMat(const string& filename,
   return cv_img;
 }
 
+cv::Mat ReadImageToCVMat(const string& filename,
+    const int height, const int width, const bool is_color,
+    const int min_height, const int min_width) {
+  if (min_height <= 0 && min_width <= 0) {
+    return ReadImageToCVMat(filename, height, width, is_color);
+  }
+  std::ifstream file(filename.c_str(), ios::in | ios::binary);
+  if (!file.is_open()) {
+    LOG(ERROR) << "Could not open or find file " << filename;
+    return cv::Mat();
+  }
+  const std::string buffer((std::istreambuf_iterator<char>(file)),
+      std::istreambuf_iterator<char>());
+  if (file.bad() || buffer.empty()) {
+    LOG(ERROR) << "Could not open or find file " << filename;
+    return cv::Mat();
+  }
+  cv::Mat cv_img;
+  int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
+    CV_LOAD_IMAGE_GRAYSCALE);
+  cv::Mat cv_img_origin = DecodeImageToCVMat(buffer.data(), buffer.size(),
+      cv_read_flag, min_height, min_width);
+  if (!cv_img_origin.data) {
+    LOG(ERROR) << "Could not open or find file " << filename;
+    return cv_img_origin;
+  }
+  if (height > 0 && width > 0) {
+    cv::resize(cv_img_origin, cv_img, cv::Size(width, height));
+  } else {
+    cv_img = cv_img_origin;
+  }
+  return cv_img;
+}
+
 cv::Mat ReadImageToCVMat(const string& filename,
     const int height, const int width) {
   return ReadImageToCVMat(filename, height, width, true);
@@ -163,25 +202,137 @@ bool ReadFileToDatum(const string& filename, const int label,
 }
 
 #ifdef USE_OPENCV
-cv::Mat DecodeDatumToCVMatNative(const Datum& datum) {
+#ifdef CAFFE_REDUCED_DECODE
+// Read the height, width and number of components of a JPEG from its frame
+// header. Returns false if the data is not a JPEG.
+static bool ReadJPEGHeader(const unsigned char* data, size_t size,
+    int* height, int* width, int* channels) {
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+  size_t i = 2;
+  while (i + 4 <= size && data[i] == 0xFF) {
+    const unsigned char marker = data[i + 1];
+    if (marker == 0xFF) {
+      // Fill byte.
+      ++i;
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+      // Markers without a segment.
+      i += 2;
+      continue;
+    }
+    if (marker == 0xD9 || marker == 0xDA) {
+      // The image ended or its data started before any frame header.
+      return false;
+    }
+    // Start of frame markers, but for DHT, JPG and DAC.
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+        marker != 0xC8 && marker != 0xCC) {
+      if (i + 10 > size) {
+        return false;
+      }
+      *height = (data[i + 5] << 8) | data[i + 6];
+      *width = (data[i + 7] << 8) | data[i + 8];
+      *channels = data[i + 9];
+      return true;
+    }
+    i += 2 + ((data[i + 2] << 8) | data[i + 3]);
+  }
+  return false;
+}
+#endif  // CAFFE_REDUCED_DECODE
+
+cv::Mat DecodeImageToCVMat(const char* data, size_t size, int cv_read_flag,
+    int min_height, int min_width) {
+  // imdecode only reads the buffer, so it can wrap the bytes as they are.
+  const cv::Mat buffer(1, size, CV_8UC1, const_cast<char*>(data));
+#ifdef CAFFE_REDUCED_DECODE
+  int height, width, channels;
+  if ((min_height > 0 || min_width > 0) &&
+      ReadJPEGHeader(reinterpret_cast<const unsigned char*>(data), size,
+          &height, &width, &channels)) {
+    int scale = 8;
+    while (scale > 1 &&
+        (height / scale < min_height || width / scale < min_width)) {
+      scale /= 2;
+    }
+    if (scale > 1) {
+      // A native decode keeps the channels of the JPEG.
+      const bool is_native = cv_read_flag < 0;
+      const bool is_color = is_native ? channels != 1 :
+          cv_read_flag != CV_LOAD_IMAGE_GRAYSCALE;
+      switch (scale) {
+      case 2:
+        cv_read_flag = is_color ? cv::IMREAD_REDUCED_COLOR_2 :
+            cv::IMREAD_REDUCED_GRAYSCALE_2;
+        break;
+      case 4:
+        cv_read_flag = is_color ? cv::IMREAD_REDUCED_COLOR_4 :
+            cv::IMREAD_REDUCED_GRAYSCALE_4;
+        break;
+      default:
+        cv_read_flag = is_color ? cv::IMREAD_REDUCED_COLOR_8 :
+            cv::IMREAD_REDUCED_GRAYSCALE_8;
+      }
+      // The reduced flags apply the EXIF orientation, like the colour and
+      // grey ones, but the native decode ignores it.
+      if (is_native) {
+        cv_read_flag |= cv::IMREAD_IGNORE_ORIENTATION;
+      }
+    }
+  }
+#endif  // CAFFE_REDUCED_DECODE
+  return cv::imdecode(buffer, cv_read_flag);
+}
+
+cv::Mat DecodeDatumToCVMatNative(const Datum& datum, int min_height,
+    int min_width) {
   cv::Mat cv_img;
   CHECK(datum.encoded()) << "Datum not encoded";
   const string& data = datum.data();
-  std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
-  cv_img = cv::imdecode(vec_data, -1);
+  cv_img = DecodeImageToCVMat(data.data(), data.size(), -1, min_height,
+      min_width);
   if (!cv_img.data) {
     LOG(ERROR) << "Could not decode datum ";
   }
   return cv_img;
 }
-cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color) {
+cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color,
+    int min_height, int min_width) {
   cv::Mat cv_img;
   CHECK(datum.encoded()) << "Datum not encoded";
   const string& data = datum.data();
-  std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
   int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
     CV_LOAD_IMAGE_GRAYSCALE);
-  cv_img = cv::imdecode(vec_data, cv_read_flag);
+  cv_img = DecodeImageToCVMat(data.data(), data.size(), cv_read_flag,
+      min_height, min_width);
+  if (!cv_img.data) {
+    LOG(ERROR) << "Could not decode datum ";
+  }
+  return cv_img;
+}
+
+cv::Mat DecodeDatumToCVMatNative(const MappedDatum& datum, int min_height,
+    int min_width) {
+  cv::Mat cv_img;
+  CHECK(datum.datum().encoded()) << "Datum not encoded";
+  cv_img = DecodeImageToCVMat(datum.data(), datum.data_size(), -1,
+      min_height, min_width);
+  if (!cv_img.data) {
+    LOG(ERROR) << "Could not decode datum ";
+  }
+  return cv_img;
+}
+cv::Mat DecodeDatumToCVMat(const MappedDatum& datum, bool is_color,
+    int min_height, int min_width) {
+  cv::Mat cv_img;
+  CHECK(datum.datum().encoded()) << "Datum not encoded";
+  int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
+    CV_LOAD_IMAGE_GRAYSCALE);
+  cv_img = DecodeImageToCVMat(datum.data(), datum.data_size(), cv_read_flag,
+      min_height, min_width);
   if (!cv_img.data) {
     LOG(ERROR) << "Could not decode datum ";
   }
@@ -0,0 +1,66 @@
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+
+#include "caffe/util/mapped_datum.hpp"
+
+namespace caffe {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+bool MappedDatum::Parse(const char* serialized, size_t size, bool map) {
+  data_ = NULL;
+  data_size_ = 0;
+  if (!map) {
+    return datum_.ParseFromArray(serialized, size);
+  }
+  // Split the wire format into the data field, which is referred to, and the
+  // other fields, which are parsed from a copy. The last data field wins, as
+  // it would when parsing the whole value.
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(serialized), size);
+  header_.clear();
+  const char* data = NULL;
+  uint32_t data_size = 0;
+  for (;;) {
+    const int start = input.CurrentPosition();
+    const uint32_t tag = input.ReadTag();
+    if (tag == 0) {
+      break;
+    }
+    if (WireFormatLite::GetTagFieldNumber(tag) == Datum::kDataFieldNumber &&
+        WireFormatLite::GetTagWireType(tag) ==
+        WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      if (!input.ReadVarint32(&data_size)) {
+        return false;
+      }
+      data = serialized + input.CurrentPosition();
+      if (!input.Skip(data_size)) {
+        return false;
+      }
+    } else {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        return false;
+      }
+      header_.append(serialized + start, input.CurrentPosition() - start);
+    }
+  }
+  if (!input.ConsumedEntireMessage() || !datum_.ParseFromString(header_)) {
+    return false;
+  }
+  data_ = data;
+  data_size_ = data_size;
+  return true;
+}
+
+void MappedDatum::Swap(MappedDatum* other) {
+  datum_.Swap(&other->datum_);
+  std::swap(data_, other->data_);
+  std::swap(data_size_, other->data_size_);
+  header_.swap(other->header_);
+}
+
+}  // namespace caffe
@@ -0,0 +1,237 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/packed_tensor.hpp"
+
+namespace caffe {
+
+size_t PackedTypeSize(PackedType type) {
+  switch (type) {
+  case PACKED_UINT8:
+    return sizeof(uint8_t);
+  case PACKED_FLOAT:
+    return sizeof(float);
+  case PACKED_DOUBLE:
+    return sizeof(double);
+  default:
+    LOG(FATAL) << "Unknown packed type " << type;
+  }
+  return 0;
+}
+
+static uint64_t Align(uint64_t offset) {
+  return (offset + kPackedAlignment - 1) / kPackedAlignment * kPackedAlignment;
+}
+
+// The size of the file, with the tensor items placed after the headers.
+static uint64_t Layout(uint64_t num_records, vector<PackedTensor>* tensors) {
+  uint64_t offset = sizeof(PackedFileHeader) +
+      tensors->size() * sizeof(PackedTensorHeader);
+  for (int i = 0; i < tensors->size(); ++i) {
+    PackedTensor& tensor = (*tensors)[i];
+    tensor.offset = Align(offset);
+    offset = tensor.offset + num_records * tensor.item_size;
+  }
+  return offset;
+}
+
+void PackedTensorWriter::AddTensor(const string& name, PackedType type,
+    const vector<int>& shape) {
+  CHECK(!map_) << "Tensors must be added before opening the file.";
+  CHECK_LT(name.size(), kPackedMaxName) << "Tensor name too long: " << name;
+  CHECK_LE(shape.size(), kPackedMaxAxes) << "Too many axes for " << name;
+  PackedTensor tensor;
+  tensor.name = name;
+  tensor.type = type;
+  tensor.shape = shape;
+  tensor.item_size = PackedTypeSize(type);
+  for (int i = 0; i < shape.size(); ++i) {
+    CHECK_GT(shape[i], 0) << "Empty axis for " << name;
+    tensor.item_size *= shape[i];
+  }
+  tensors_.push_back(tensor);
+}
+
+void PackedTensorWriter::Open(const string& filename, uint64_t num_records) {
+  CHECK(!map_) << "Already open.";
+  CHECK(!tensors_.empty()) << "No tensors to write.";
+  num_records_ = num_records;
+  map_size_ = Layout(num_records, &tensors_);
+  int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  CHECK_NE(fd, -1) << "Cannot create " << filename;
+  CHECK_EQ(ftruncate(fd, map_size_), 0) << "Cannot resize " << filename;
+  void* map = mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  CHECK(map != MAP_FAILED) << "Cannot map " << filename;
+  map_ = static_cast<char*>(map);
+
+  PackedFileHeader* header = reinterpret_cast<PackedFileHeader*>(map_);
+  // NOLINT_NEXT_LINE(caffe/alt_fn)
+  memcpy(header->magic, kPackedMagic, sizeof(kPackedMagic));
+  header->version = kPackedVersion;
+  header->num_tensors = tensors_.size();
+  header->num_records = num_records;
+  PackedTensorHeader* tensor_headers =
+      reinterpret_cast<PackedTensorHeader*>(header + 1);
+  for (int i = 0; i < tensors_.size(); ++i) {
+    const PackedTensor& tensor = tensors_[i];
+    PackedTensorHeader& tensor_header = tensor_headers[i];
+    strncpy(tensor_header.name, tensor.name.c_str(), kPackedMaxName);
+    tensor_header.type = tensor.type;
+    tensor_header.num_axes = tensor.shape.size();
+    for (int j = 0; j < tensor.shape.size(); ++j) {
+      tensor_header.shape[j] = tensor.shape[j];
+    }
+    tensor_header.offset = tensor.offset;
+  }
+}
+
+char* PackedTensorWriter::mutable_item(int tensor, uint64_t record) {
+  CHECK(map_) << "Not open.";
+  CHECK_LT(record, num_records_);
+  return map_ + tensors_[tensor].offset + record * tensors_[tensor].item_size;
+}
+
+void PackedTensorWriter::Write(int tensor, uint64_t record, const void* data) {
+  // NOLINT_NEXT_LINE(caffe/alt_fn)
+  memcpy(mutable_item(tensor, record), data, tensors_[tensor].item_size);
+}
+
+void PackedTensorWriter::Close() {
+  if (map_) {
+    CHECK_EQ(msync(map_, map_size_, MS_SYNC), 0) << "Failed to write out.";
+    munmap(map_, map_size_);
+    map_ = NULL;
+  }
+}
+
+void PackedTensorFile::Open(const string& filename) {
+  CHECK(!map_) << "Already open.";
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "Cannot open " << filename;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat " << filename;
+  map_size_ = st.st_size;
+  CHECK_GE(map_size_, sizeof(PackedFileHeader))
+      << filename << " is not a packed tensor file.";
+  // A private map, so that writes to the items stay in memory.
+  void* map = mmap(NULL, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+      0);
+  close(fd);
+  CHECK(map != MAP_FAILED) << "Cannot map " << filename;
+  map_ = static_cast<char*>(map);
+
+  const PackedFileHeader* header =
+      reinterpret_cast<const PackedFileHeader*>(map_);
+  CHECK_EQ(memcmp(header->magic, kPackedMagic, sizeof(kPackedMagic)), 0)
+      << filename << " is not a packed tensor file.";
+  CHECK_EQ(header->version, kPackedVersion)
+      << "Unsupported version of " << filename;
+  CHECK_LE(sizeof(PackedFileHeader) +
+      header->num_tensors * sizeof(PackedTensorHeader), map_size_)
+      << "Truncated header in " << filename;
+  num_records_ = header->num_records;
+  const PackedTensorHeader* tensor_headers =
+      reinterpret_cast<const PackedTensorHeader*>(header + 1);
+  tensors_.resize(header->num_tensors);
+  for (int i = 0; i < tensors_.size(); ++i) {
+    const PackedTensorHeader& tensor_header = tensor_headers[i];
+    PackedTensor& tensor = tensors_[i];
+    tensor.name = string(tensor_header.name,
+        strnlen(tensor_header.name, kPackedMaxName));
+    tensor.type = static_cast<PackedType>(tensor_header.type);
+    CHECK_LE(tensor_header.num_axes, kPackedMaxAxes)
+        << "Too many axes for " << tensor.name << " in " << filename;
+    tensor.shape.assign(tensor_header.shape,
+        tensor_header.shape + tensor_header.num_axes);
+    tensor.item_size = PackedTypeSize(tensor.type);
+    for (int j = 0; j < tensor.shape.size(); ++j) {
+      tensor.item_size *= tensor.shape[j];
+    }
+    tensor.offset = tensor_header.offset;
+    CHECK_LE(tensor.offset + num_records_ * tensor.item_size, map_size_)
+        << "Truncated tensor " << tensor.name << " in " << filename;
+  }
+}
+
+void PackedTensorFile::Close() {
+  if (map_) {
+    munmap(map_, map_size_);
+    map_ = NULL;
+  }
+  tensors_.clear();
+  num_records_ = 0;
+}
+
+int PackedTensorFile::FindTensor(const string& name) const {
+  for (int i = 0; i < tensors_.size(); ++i) {
+    if (tensors_[i].name == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+template <typename T, typename Dtype>
+static void Convert(const char* item, int count, Dtype* data) {
+  const T* values = reinterpret_cast<const T*>(item);
+  for (int i = 0; i < count; ++i) {
+    data[i] = static_cast<Dtype>(values[i]);
+  }
+}
+
+template <typename Dtype>
+void PackedTensorFile::Read(int tensor, uint64_t record, Dtype* data) const {
+  const PackedTensor& t = tensors_[tensor];
+  const char* src = item(tensor, record);
+  const int count = t.item_size / PackedTypeSize(t.type);
+  switch (t.type) {
+  case PACKED_UINT8:
+    Convert<uint8_t>(src, count, data);
+    break;
+  case PACKED_FLOAT:
+    Convert<float>(src, count, data);
+    break;
+  case PACKED_DOUBLE:
+    Convert<double>(src, count, data);
+    break;
+  default:
+    LOG(FATAL) << "Unknown packed type " << t.type;
+  }
+}
+
+template void PackedTensorFile::Read(int tensor, uint64_t record,
+    float* data) const;
+template void PackedTensorFile::Read(int tensor, uint64_t record,
+    double* data) const;
+
+void PackedTensorFile::Advise(int tensor, uint64_t record, uint64_t count,
+    int advice) const {
+  // madvise works on whole pages; those at the ends may hold items of other
+  // records, which is harmless for both advices.
+  const uintptr_t page = sysconf(_SC_PAGESIZE);
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(item(tensor, record));
+  const uintptr_t end = begin + count * tensors_[tensor].item_size;
+  const uintptr_t aligned = begin / page * page;
+  if (end > aligned) {
+    madvise(reinterpret_cast<void*>(aligned), end - aligned, advice);
+  }
+}
+
+void PackedTensorFile::WillNeed(int tensor, uint64_t record, uint64_t count)
+    const {
+  Advise(tensor, record, count, MADV_WILLNEED);
+}
+
+void PackedTensorFile::DontNeed(int tensor, uint64_t record, uint64_t count)
+    const {
+  Advise(tensor, record, count, MADV_DONTNEED);
+}
+
+}  // namespace caffe
@@ -0,0 +1,156 @@
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <deque>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// A call to Run(), shared by the threads working on it.
+struct Job {
+  const boost::function<void(int, int)>* task;
+  int num_tasks;
+  int next_task;
+  int tasks_done;
+  int num_slots;
+};
+
+int DefaultThreads() {
+  return std::max(1, static_cast<int>(boost::thread::hardware_concurrency()));
+}
+
+}  // namespace
+
+class ThreadPool::sync {
+ public:
+  boost::mutex mutex_;
+  boost::condition_variable work_available_;
+  boost::condition_variable job_done_;
+  std::deque<Job*> jobs_;
+  bool stop_;
+  boost::thread_group workers_;
+};
+
+// Claims and runs tasks of job until none is left to claim. Called with the
+// lock held, which is released while a task runs.
+static void WorkOn(Job* job, boost::mutex::scoped_lock* lock,
+    boost::condition_variable* job_done) {
+  const int slot = job->num_slots++;
+  while (job->next_task < job->num_tasks) {
+    const int i = job->next_task++;
+    lock->unlock();
+    (*job->task)(i, slot);
+    lock->lock();
+    if (++job->tasks_done == job->num_tasks) {
+      job_done->notify_all();
+    }
+  }
+}
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads_(num_threads > 0 ? num_threads : DefaultThreads()),
+      sync_(new sync()) {
+  sync_->stop_ = false;
+  for (int i = 1; i < num_threads_; ++i) {
+    sync_->workers_.create_thread(
+        boost::bind(&ThreadPool::WorkerEntry, this));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->work_available_.notify_all();
+  sync_->workers_.join_all();
+}
+
+void ThreadPool::WorkerEntry() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (true) {
+    while (sync_->jobs_.empty() && !sync_->stop_) {
+      sync_->work_available_.wait(lock);
+    }
+    if (sync_->stop_) {
+      return;
+    }
+    Job* job = sync_->jobs_.front();
+    if (job->next_task < job->num_tasks) {
+      WorkOn(job, &lock, &sync_->job_done_);
+    }
+    // Every task is claimed; the job leaves the queue for the next one.
+    if (!sync_->jobs_.empty() && sync_->jobs_.front() == job) {
+      sync_->jobs_.pop_front();
+    }
+  }
+}
+
+void ThreadPool::Run(int num_tasks,
+    const boost::function<void(int, int)>& task) {
+  if (num_tasks <= 0) {
+    return;
+  }
+  if (num_threads_ == 1 || num_tasks == 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i, 0);
+    }
+    return;
+  }
+  // The job lives on this stack, so an interrupted thread, such as a stopping
+  // prefetch thread, must still wait for the workers to be done with it.
+  boost::this_thread::disable_interruption no_interruption;
+  Job job;
+  job.task = &task;
+  job.num_tasks = num_tasks;
+  job.next_task = 0;
+  job.tasks_done = 0;
+  job.num_slots = 0;
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  sync_->jobs_.push_back(&job);
+  sync_->work_available_.notify_all();
+  WorkOn(&job, &lock, &sync_->job_done_);
+  while (job.tasks_done < job.num_tasks) {
+    sync_->job_done_.wait(lock);
+  }
+  std::deque<Job*>::iterator it =
+      std::find(sync_->jobs_.begin(), sync_->jobs_.end(), &job);
+  if (it != sync_->jobs_.end()) {
+    sync_->jobs_.erase(it);
+  }
+}
+
+static shared_ptr<ThreadPool>& GlobalPool() {
+  static shared_ptr<ThreadPool> pool;
+  return pool;
+}
+
+static boost::mutex global_pool_mutex;
+// The global pool's num_threads(), or 0 before it is created.
+static boost::atomic<int> global_threads(0);
+
+ThreadPool& ThreadPool::Global() {
+  boost::mutex::scoped_lock lock(global_pool_mutex);
+  if (!GlobalPool()) {
+    GlobalPool().reset(new ThreadPool(0));
+    global_threads = GlobalPool()->num_threads();
+  }
+  return *GlobalPool();
+}
+
+int ThreadPool::GlobalThreads() {
+  return global_threads.load(boost::memory_order_relaxed);
+}
+
+void ThreadPool::SetGlobalThreads(int num_threads) {
+  boost::mutex::scoped_lock lock(global_pool_mutex);
+  GlobalPool().reset(new ThreadPool(num_threads));
+  global_threads = GlobalPool()->num_threads();
+}
+
+}  // namespace caffe
@@ -0,0 +1,130 @@
+#include <boost/thread.hpp>
+#include <glog/logging.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <map>
+#include <string>
+
+#include "caffe/util/tuning_cache.hpp"
+
+namespace caffe {
+
+namespace {
+
+struct CacheState {
+  boost::mutex mutex;
+  string file;
+  std::map<string, string> entries;
+};
+
+CacheState& State() {
+  static CacheState* state = new CacheState();
+  return *state;
+}
+
+// Fields of a file line are tab separated: CPU model, key and value.
+const char kSeparator = '\t';
+
+bool IsValidField(const string& field) {
+  return field.find(kSeparator) == string::npos &&
+      field.find('\n') == string::npos;
+}
+
+string ReadCPUModel() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0) {
+      const size_t colon = line.find(':');
+      if (colon != string::npos) {
+        const size_t begin = line.find_first_not_of(" \t", colon + 1);
+        string model = begin == string::npos ? "" : line.substr(begin);
+        for (int i = 0; i < model.size(); ++i) {
+          if (model[i] == kSeparator) {
+            model[i] = ' ';
+          }
+        }
+        return model.empty() ? "unknown" : model;
+      }
+    }
+  }
+  return "unknown";
+}
+
+}  // namespace
+
+string TuningCache::CPUModel() {
+  static const string model = ReadCPUModel();
+  return model;
+}
+
+string TuningCache::file() {
+  CacheState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  return state.file;
+}
+
+void TuningCache::set_file(const string& path) {
+  const string cpu = CPUModel();
+  CacheState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  state.file = path;
+  state.entries.clear();
+  if (path.empty()) {
+    return;
+  }
+  std::ifstream input(path.c_str());
+  string line;
+  int loaded = 0;
+  while (std::getline(input, line)) {
+    const size_t first = line.find(kSeparator);
+    const size_t second = first == string::npos ? string::npos :
+        line.find(kSeparator, first + 1);
+    if (second == string::npos) {
+      LOG(WARNING) << "Ignoring malformed tuning cache line: " << line;
+      continue;
+    }
+    if (line.compare(0, first, cpu) == 0 && first == cpu.size()) {
+      // Later lines win, as Insert() appends replacements.
+      state.entries[line.substr(first + 1, second - first - 1)] =
+          line.substr(second + 1);
+      ++loaded;
+    }
+  }
+  LOG(INFO) << "Loaded " << loaded << " tuning cache entries from " << path;
+}
+
+bool TuningCache::Lookup(const string& key, string* value) {
+  CacheState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  std::map<string, string>::const_iterator it = state.entries.find(key);
+  if (it == state.entries.end()) {
+    return false;
+  }
+  *value = it->second;
+  return true;
+}
+
+void TuningCache::Insert(const string& key, const string& value) {
+  CHECK(IsValidField(key) && IsValidField(value))
+      << "Tuning cache keys and values cannot contain tabs or newlines.";
+  const string cpu = CPUModel();
+  CacheState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  state.entries[key] = value;
+  if (state.file.empty()) {
+    return;
+  }
+  std::ofstream output(state.file.c_str(), std::ios::app);
+  output << cpu << kSeparator << key << kSeparator << value << '\n';
+  LOG_IF(WARNING, !output) << "Could not write to tuning cache "
+      << state.file;
+}
+
+void TuningCache::Clear() {
+  CacheState& state = State();
+  boost::mutex::scoped_lock lock(state.mutex);
+  state.entries.clear();
+}
+
+}  // namespace caffe
@@ -0,0 +1,61 @@
+// This program lists the keys of a lmdb/leveldb, one per line, for a Data
+// layer to read the database in a new random order every epoch, given the
+// list as its data_param { key_index }.
+// Usage:
+//   build_key_index [FLAGS] DB_NAME KEY_INDEX
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/db.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_string(backend, "lmdb",
+        "The backend {lmdb, leveldb} containing the data");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("List the keys of a leveldb/lmdb to shuffle it\n"
+        "every epoch without rewriting it.\n"
+        "Usage:\n"
+        "    build_key_index [FLAGS] DB_NAME KEY_INDEX\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/build_key_index");
+    return 1;
+  }
+
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[1], db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  std::ofstream index(argv[2]);
+  CHECK(index) << "Cannot open " << argv[2];
+
+  int count = 0;
+  for (cursor->SeekToFirst(); cursor->valid(); cursor->Next()) {
+    const string key = cursor->key();
+    CHECK_EQ(key.find('\n'), string::npos)
+        << "Keys holding a newline cannot be listed.";
+    index << key << '\n';
+    if (++count % 100000 == 0) {
+      LOG(INFO) << "Listed " << count << " keys.";
+    }
+  }
+  CHECK(index) << "Failed to write " << argv[2];
+  LOG(INFO) << "Listed " << count << " keys.";
+  return 0;
+}
@@ -13,7 +13,11 @@ namespace bp = boost::python;
 
 #include "boost/algorithm/string.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/host_memory_pool.hpp"
 #include "caffe/util/signal_handler.h"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/tuning_cache.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
@@ -47,6 +51,15 @@ DEFINE_string(sigint_effect, "stop",
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_bool(host_pool, false,
+    "Optional; serve CPU blob memory from a caching pool so that repeated "
+    "net construction and reshaping reuse memory.");
+DEFINE_int32(cpu_threads, 0,
+    "Optional; the number of threads used by multithreaded CPU layers, "
+    "e.g. the THREADED convolution engine (default: one per core).");
+DEFINE_string(conv_tuning_cache, "",
+    "Optional; a file recording the engines picked by AUTOTUNE convolution "
+    "layers, so that later runs on the same CPU skip the timing.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -340,6 +353,15 @@ int time() {
   Timer timer;
   std::vector<double> forward_time_per_layer(layers.size(), 0.0);
   std::vector<double> backward_time_per_layer(layers.size(), 0.0);
+  // The time the prefetching data layers made Forward wait for their data.
+  std::vector<double> prefetch_wait_per_layer(layers.size(), 0.0);
+  for (int i = 0; i < layers.size(); ++i) {
+    const caffe::BasePrefetchingDataLayer<float>* data_layer =
+        dynamic_cast<caffe::BasePrefetchingDataLayer<float>*>(layers[i].get());
+    if (data_layer) {
+      prefetch_wait_per_layer[i] = -data_layer->prefetch_wait_time();
+    }
+  }
   double forward_time = 0.0;
   double backward_time = 0.0;
   for (int j = 0; j < FLAGS_iterations; ++j) {
@@ -372,6 +394,14 @@ int time() {
     LOG(INFO) << std::setfill(' ') << std::setw(10) << layername  <<
       "\tbackward: " << backward_time_per_layer[i] / 1000 /
       FLAGS_iterations << " ms.";
+    const caffe::BasePrefetchingDataLayer<float>* data_layer =
+        dynamic_cast<caffe::BasePrefetchingDataLayer<float>*>(layers[i].get());
+    if (data_layer) {
+      LOG(INFO) << std::setfill(' ') << std::setw(10) << layername <<
+        "\tprefetch wait: " << (prefetch_wait_per_layer[i] +
+        data_layer->prefetch_wait_time()) / FLAGS_iterations << " ms with " <<
+        data_layer->prefetch_count() << " batches prefetched.";
+    }
   }
   total_timer.Stop();
   LOG(INFO) << "Average Forward pass: " << forward_time / 1000 /
@@ -381,7 +411,28 @@ int time() {
   LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
+  if (caffe_net.checkpointing()) {
+    // The per-layer timings above run every layer once; time the whole net
+    // to include the activations recomputed in Backward.
+    size_t full_bytes, peak_bytes;
+    caffe_net.CheckpointMemory(&full_bytes, &peak_bytes);
+    const double recompute_start = caffe_net.recompute_time();
+    Timer net_timer;
+    net_timer.Start();
+    for (int j = 0; j < FLAGS_iterations; ++j) {
+      caffe_net.ForwardBackward();
+    }
+    LOG(INFO) << "Activation memory: " << full_bytes << " bytes, "
+      << peak_bytes << " bytes with recomputation.";
+    LOG(INFO) << "Average Net Forward-Backward: " << net_timer.MilliSeconds() /
+      FLAGS_iterations << " ms, of which recomputation: "
+      << (caffe_net.recompute_time() - recompute_start) / FLAGS_iterations
+      << " ms.";
+  }
   LOG(INFO) << "*** Benchmark ends ***";
+  if (caffe::HostMemoryPool::enabled()) {
+    caffe::HostMemoryPool::LogStats();
+  }
   return 0;
 }
 RegisterBrewFunction(time);
@@ -401,6 +452,11 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  caffe::HostMemoryPool::set_enabled(FLAGS_host_pool);
+  if (FLAGS_cpu_threads > 0) {
+    caffe::ThreadPool::SetGlobalThreads(FLAGS_cpu_threads);
+  }
+  caffe::TuningCache::set_file(FLAGS_conv_tuning_cache);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
@@ -0,0 +1,116 @@
+// This program converts a lmdb/leveldb of Datum proto buffers, as written by
+// convert_imageset, into a packed tensor file for the PackedData layer, with
+// a "data" tensor holding the pixels and a "label" tensor the labels. All the
+// datums must have the same shape; encoded ones are decoded.
+// Usage:
+//   convert_to_packed [FLAGS] DB_NAME PACKED_FILE
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "boost/scoped_ptr.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/db.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/packed_tensor.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::scoped_ptr;
+
+DEFINE_string(backend, "lmdb",
+        "The backend {lmdb, leveldb} containing the datums");
+
+// Parse and decode the datum at the cursor.
+static void ReadDatum(db::Cursor* cursor, Datum* datum) {
+  CHECK(datum->ParseFromString(cursor->value()))
+      << "Cannot parse the datum at " << cursor->key();
+  if (datum->encoded()) {
+#ifdef USE_OPENCV
+    DecodeDatumNative(datum);
+#else
+    LOG(FATAL) << "Decoding encoded datums requires OpenCV; compile with "
+        << "USE_OPENCV.";
+#endif  // USE_OPENCV
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Convert a leveldb/lmdb of datums to a packed\n"
+        "tensor file, which the PackedData layer maps into memory.\n"
+        "Usage:\n"
+        "    convert_to_packed [FLAGS] DB_NAME PACKED_FILE\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_to_packed");
+    return 1;
+  }
+
+  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[1], db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+
+  // The file is sized up front, which takes a pass to count the records.
+  uint64_t num_records = 0;
+  for (cursor->SeekToFirst(); cursor->valid(); cursor->Next()) {
+    ++num_records;
+  }
+  CHECK_GT(num_records, 0) << "No datums in " << argv[1];
+  LOG(INFO) << "Converting " << num_records << " datums.";
+
+  cursor->SeekToFirst();
+  Datum datum;
+  ReadDatum(cursor.get(), &datum);
+  vector<int> shape(3);
+  shape[0] = datum.channels();
+  shape[1] = datum.height();
+  shape[2] = datum.width();
+  const int count = shape[0] * shape[1] * shape[2];
+  // Pixels keep their bytes; float data stays float.
+  const bool bytes = datum.has_data();
+  PackedTensorWriter writer;
+  writer.AddTensor("data", bytes ? PACKED_UINT8 : PACKED_FLOAT, shape);
+  writer.AddTensor("label", PACKED_FLOAT, vector<int>());
+  writer.Open(argv[2], num_records);
+
+  uint64_t record = 0;
+  for (cursor->SeekToFirst(); cursor->valid(); cursor->Next(), ++record) {
+    ReadDatum(cursor.get(), &datum);
+    CHECK_EQ(datum.channels(), shape[0]) << "Different shape at "
+        << cursor->key();
+    CHECK_EQ(datum.height(), shape[1]) << "Different shape at "
+        << cursor->key();
+    CHECK_EQ(datum.width(), shape[2]) << "Different shape at "
+        << cursor->key();
+    if (bytes) {
+      CHECK_EQ(datum.data().size(), count) << "Incorrect data size at "
+          << cursor->key();
+      writer.Write(0, record, datum.data().data());
+    } else {
+      CHECK_EQ(datum.float_data_size(), count) << "Incorrect data size at "
+          << cursor->key();
+      writer.Write(0, record, datum.float_data().data());
+    }
+    const float label = datum.label();
+    writer.Write(1, record, &label);
+    if ((record + 1) % 1000 == 0) {
+      LOG(INFO) << "Processed " << record + 1 << " files.";
+    }
+  }
+  CHECK_EQ(record, num_records) << "The database changed while converting.";
+  writer.Close();
+  LOG(INFO) << "Processed " << record << " files.";
+  return 0;
+}